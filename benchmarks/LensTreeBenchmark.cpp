@@ -0,0 +1,112 @@
+// Scaling of LensTree against direct summation for 10^2 to 10^5 field lenses.
+//
+// Fills a resolution x resolution lens map the way
+// GravitationalLensing::add_field_deflection does, in 8x8 blocks of map points,
+// for uniform random lenses plus two strong ones near the center. The direct
+// map time is extrapolated from a sample of points, and the error is the mean
+// relative difference from the direct sum over that sample.
+//
+// Usage: lens_tree_benchmark [resolution] [opening_angle] [expansion_order] [leaf_size]
+
+#include "LensTree.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+const int kBlock = 8;            // Map points per block edge, as in GravitationalLensing
+const int kDirectSamples = 300;  // Points summed directly per lens count
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+int main(int argc, char** argv) {
+    const int resolution = argc > 1 ? std::atoi(argv[1]) : 512;
+    LensTreeSettings settings;
+    if (argc > 2) settings.opening_angle = std::atof(argv[2]);
+    if (argc > 3) settings.expansion_order = std::atoi(argv[3]);
+    if (argc > 4) settings.leaf_size = std::atoi(argv[4]);
+    if (resolution < kBlock) {
+        std::fprintf(stderr, "resolution must be at least %d\n", kBlock);
+        return 1;
+    }
+
+    std::printf("%dx%d map, opening angle %g, order %d, leaf %d\n", resolution, resolution,
+                settings.opening_angle, settings.expansion_order, settings.leaf_size);
+    std::printf("%8s %10s %10s %12s %16s %14s\n",
+                "lenses", "nodes", "build s", "tree map s", "direct map s", "mean rel err");
+
+    const std::size_t points = static_cast<std::size_t>(resolution) * resolution;
+    std::vector<double> deflection_x(points), deflection_y(points);
+    std::vector<double> x(kBlock * kBlock), y(kBlock * kBlock);
+    std::vector<double> block_x(kBlock * kBlock), block_y(kBlock * kBlock);
+
+    for (int lens_count : {100, 1000, 10000, 100000}) {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+        std::vector<ScreenLens> lenses;
+        lenses.reserve(lens_count + 2);
+        for (int i = 0; i < lens_count; ++i) {
+            Eigen::Vector2d position(uniform(rng), uniform(rng));
+            lenses.push_back({position, 1e-6 * (1.0 + 0.5 * uniform(rng))});
+        }
+        lenses.push_back({Eigen::Vector2d(0.05, 0.0), 1e-2});
+        lenses.push_back({Eigen::Vector2d(-0.05, 0.0), 1e-2});
+
+        LensTree tree;
+        auto start = std::chrono::steady_clock::now();
+        tree.build(lenses, settings);
+        const double build_time = seconds_since(start);
+
+        // Whole map in blocks of neighbouring points
+        start = std::chrono::steady_clock::now();
+        for (int i0 = 0; i0 < resolution; i0 += kBlock) {
+            for (int j0 = 0; j0 < resolution; j0 += kBlock) {
+                std::size_t count = 0;
+                for (int i = i0; i < std::min(i0 + kBlock, resolution); ++i) {
+                    for (int j = j0; j < std::min(j0 + kBlock, resolution); ++j) {
+                        x[count] = 2.0 * i / resolution - 1.0;
+                        y[count] = 2.0 * j / resolution - 1.0;
+                        ++count;
+                    }
+                }
+                tree.deflection(x.data(), y.data(), block_x.data(), block_y.data(), count);
+
+                count = 0;
+                for (int i = i0; i < std::min(i0 + kBlock, resolution); ++i) {
+                    for (int j = j0; j < std::min(j0 + kBlock, resolution); ++j) {
+                        deflection_x[static_cast<std::size_t>(i) * resolution + j] = block_x[count];
+                        deflection_y[static_cast<std::size_t>(i) * resolution + j] = block_y[count];
+                        ++count;
+                    }
+                }
+            }
+        }
+        const double tree_time = seconds_since(start);
+
+        // Direct sum over a sample of map points
+        std::mt19937 sample_rng(3);
+        std::uniform_int_distribution<std::size_t> pick(0, points - 1);
+        double error = 0.0;
+        double direct_time = 0.0;
+        for (int s = 0; s < kDirectSamples; ++s) {
+            const std::size_t k = pick(sample_rng);
+            Eigen::Vector2d screen_pos(2.0 * static_cast<double>(k / resolution) / resolution - 1.0,
+                                       2.0 * static_cast<double>(k % resolution) / resolution - 1.0);
+            start = std::chrono::steady_clock::now();
+            Eigen::Vector2d exact = tree.direct_deflection(screen_pos);
+            direct_time += seconds_since(start);
+            error += (Eigen::Vector2d(deflection_x[k], deflection_y[k]) - exact).norm() / exact.norm();
+        }
+
+        std::printf("%8d %10zu %10.3f %12.3f %16.2f %14.1e\n", lens_count, tree.get_node_count(), build_time,
+                    tree_time, direct_time / kDirectSamples * points, error / kDirectSamples);
+    }
+    return 0;
+}
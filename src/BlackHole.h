@@ -1,9 +1,13 @@
 #ifndef BLACKHOLE_H
 #define BLACKHOLE_H
 
+#include "GeodesicIntegrator.h"
 #include <Eigen/Dense>
 #include <vector>
 #include <memory>
+#include <string>
+
+class DeflectionTable;
 
 struct BlackHoleParameters {
     double mass;  // Solar masses
@@ -25,7 +29,8 @@ public:
     BlackHole();
     explicit BlackHole(const BlackHoleParameters& params);
     
-    // Gravitational lensing calculations
+    // Gravitational lensing calculations. With a deflection table attached the
+    // result is the final direction of the photon, or zero if it is captured.
     Eigen::Vector3d calculate_gravitational_lensing(const Eigen::Vector3d& ray_origin, 
                                                    const Eigen::Vector3d& ray_direction) const;
     
@@ -36,20 +41,38 @@ public:
     double get_photon_sphere_radius() const;
     double get_event_horizon_radius() const;
     
+    // Null geodesic tracing through the Kerr metric for a batch of rays. Holes with
+    // spin below SchwarzschildTracer::kSpinThreshold use the closed-form solution
+    // unless settings.use_closed_form is off.
+    void trace_geodesics(const GeodesicRay* rays, GeodesicResult* results, std::size_t count,
+                         const GeodesicSettings& settings = GeodesicSettings()) const;
+    void trace_geodesics(const std::vector<GeodesicRay>& rays, std::vector<GeodesicResult>& results,
+                         const GeodesicSettings& settings = GeodesicSettings()) const;
+    
     // Accretion disk sampling
     std::vector<Eigen::Vector3d> sample_accretion_disk(int num_samples) const;
     
+    // Precomputed photon deflection for this spin, shared between holes and lenses
+    bool load_deflection_table(const std::string& cache_directory = "cache");
+    void set_deflection_table(std::shared_ptr<const DeflectionTable> table);
+    std::shared_ptr<const DeflectionTable> get_deflection_table() const { return deflection_table_; }
+    
     const BlackHoleParameters& get_parameters() const { return parameters_; }
     
 private:
     BlackHoleParameters parameters_;
+    std::shared_ptr<const DeflectionTable> deflection_table_;
     
-    // Kerr metric calculations
+    // Kerr metric calculations (Boyer-Lindquist, geometric units)
+    // g_tt at position (t, r, theta, phi)
     double kerr_metric_component(const Eigen::Vector4d& position) const;
+    // dp/dlambda for covariant momentum (p_t, p_r, p_theta, p_phi)
     Eigen::Vector4d calculate_geodesic_derivative(const Eigen::Vector4d& position, 
                                                  const Eigen::Vector4d& momentum) const;
     
-    // Ray tracing through curved spacetime
+    bool uses_closed_form(const GeodesicSettings& settings) const;
+    
+    // Ray tracing through curved spacetime; step_size is the initial step in world units
     void trace_geodesic(Eigen::Vector3d& position, Eigen::Vector3d& direction, 
                        double step_size, int max_steps) const;
 };
@@ -0,0 +1,462 @@
+#include "DeflectionTable.h"
+#include "BlackHole.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DEFLECTION_TABLE_MMAP 1
+#endif
+
+namespace {
+
+const char kMagic[8] = {'B', 'H', 'D', 'E', 'F', 'L', 'T', '\0'};
+const std::uint32_t kEndianMarker = 0x01020304u;
+const std::uint32_t kKindSchwarzschild = 0;
+const std::uint32_t kKindKerr = 1;
+
+// World axes (x, y, z) map to Boyer-Lindquist Cartesian axes (z, x, y), spin along z
+inline Eigen::Vector3d world_to_bl(const Eigen::Vector3d& v) {
+    return Eigen::Vector3d(v.z(), v.x(), v.y());
+}
+
+inline Eigen::Vector3d bl_to_world(const Eigen::Vector3d& v) {
+    return Eigen::Vector3d(v.y(), v.z(), v.x());
+}
+
+// Polar samples are packed towards psi = 0, where the shadow edge sits for distant observers
+inline double polar_angle(int k, int count) {
+    double t = static_cast<double>(k) / (count - 1);
+    return M_PI * t * t;
+}
+
+inline double polar_coordinate(double psi, int count) {
+    return std::sqrt(std::clamp(psi / M_PI, 0.0, 1.0)) * (count - 1);
+}
+
+inline double radius_at(int i, int count, double min_radius, double max_radius) {
+    return min_radius * std::pow(max_radius / min_radius, static_cast<double>(i) / (count - 1));
+}
+
+// Split a grid coordinate into a cell index and fraction, clamped to the grid
+inline void cell(double x, int count, int& index, double& fraction) {
+    x = std::clamp(x, 0.0, static_cast<double>(count - 1));
+    index = std::min(static_cast<int>(x), std::max(count - 2, 0));
+    fraction = count > 1 ? x - index : 0.0;
+}
+
+}
+
+DeflectionTable::DeflectionTable()
+    : mapping_(nullptr), mapping_size_(0),
+      header_(nullptr), planes_(nullptr), terminations_(nullptr) {
+    static_assert(sizeof(Header) == 80, "DeflectionTable header layout changed");
+}
+
+DeflectionTable::~DeflectionTable() {
+    release();
+}
+
+void DeflectionTable::release() {
+#ifdef DEFLECTION_TABLE_MMAP
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    buffer_.clear();
+    header_ = nullptr;
+    planes_ = nullptr;
+    terminations_ = nullptr;
+}
+
+void DeflectionTable::attach(const unsigned char* data, std::size_t size) {
+    header_ = nullptr;
+    if (size < sizeof(Header)) return;
+
+    const Header* header = reinterpret_cast<const Header*>(data);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) return;
+    if (header->version != kVersion || header->endian_marker != kEndianMarker) return;
+    if (header->kind != kKindSchwarzschild && header->kind != kKindKerr) return;
+    if (!(header->min_radius > 0.0) || !(header->max_radius > header->min_radius) ||
+        !std::isfinite(header->max_radius)) return;
+
+    // Schwarzschild tables use r and psi only; every used axis needs a cell
+    const bool kerr = header->kind == kKindKerr;
+    std::uint64_t entries = 1;
+    for (int axis = 0; axis < 4; ++axis) {
+        const std::uint32_t dim = header->dims[axis];
+        if (kerr || axis == 0 || axis == 2) {
+            if (dim < 2 || dim > static_cast<std::uint32_t>(std::numeric_limits<int>::max())) return;
+        } else if (dim != 1) {
+            return;
+        }
+        if (entries > std::numeric_limits<std::uint64_t>::max() / dim) return;
+        entries *= dim;
+    }
+    if (entries != header->entry_count) return;
+
+    // Planes after the header and float aligned; checked by division so a
+    // corrupt header cannot overflow the bounds
+    std::uint64_t planes = kerr ? 3 : 1;
+    if (header->data_offset < sizeof(Header) || header->data_offset % sizeof(float) != 0) return;
+    if (header->data_offset > size) return;
+    if (header->entry_count > (size - header->data_offset) / (planes * sizeof(float) + 1)) return;
+
+    header_ = header;
+    planes_ = reinterpret_cast<const float*>(data + header->data_offset);
+    terminations_ = data + header->data_offset + header->entry_count * planes * sizeof(float);
+}
+
+bool DeflectionTable::is_schwarzschild() const {
+    return header_ && header_->kind == kKindSchwarzschild;
+}
+
+double DeflectionTable::get_spin() const {
+    return header_ ? header_->spin : 0.0;
+}
+
+std::string DeflectionTable::get_file_name(const BlackHoleParameters& params,
+                                           const DeflectionTableSettings& settings) {
+    char name[160];
+    if (std::abs(params.spin) < kSchwarzschildSpin) {
+        std::snprintf(name, sizeof(name), "deflection_v%u_schwarzschild_%dx%d_r%g-%g.bin",
+                      kVersion, settings.radius_samples, settings.polar_samples,
+                      settings.min_radius, settings.max_radius);
+    } else {
+        std::snprintf(name, sizeof(name), "deflection_v%u_a%+.4f_%dx%dx%dx%d_r%g-%g.bin",
+                      kVersion, params.spin, settings.radius_samples, settings.inclination_samples,
+                      settings.polar_samples, settings.azimuth_samples,
+                      settings.min_radius, settings.max_radius);
+    }
+    return name;
+}
+
+void DeflectionTable::build(const BlackHoleParameters& params, const DeflectionTableSettings& settings) {
+    release();
+
+    const bool schwarzschild = std::abs(params.spin) < kSchwarzschildSpin;
+    const int radii = std::max(2, settings.radius_samples);
+    const int inclinations = schwarzschild ? 1 : std::max(2, settings.inclination_samples);
+    const int polars = std::max(2, settings.polar_samples);
+    const int azimuths = schwarzschild ? 1 : std::max(2, settings.azimuth_samples);
+
+    const std::uint64_t entries = static_cast<std::uint64_t>(radii) * inclinations * polars * azimuths;
+    const std::uint64_t planes = schwarzschild ? 1 : 3;
+    const std::uint64_t data_offset = 128;
+
+    buffer_.assign(data_offset + entries * (planes * sizeof(float) + 1), 0);
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.endian_marker = kEndianMarker;
+    header.kind = schwarzschild ? kKindSchwarzschild : kKindKerr;
+    header.dims[0] = radii;
+    header.dims[1] = inclinations;
+    header.dims[2] = polars;
+    header.dims[3] = azimuths;
+    header.spin = schwarzschild ? 0.0 : params.spin;
+    header.min_radius = settings.min_radius;
+    header.max_radius = settings.max_radius;
+    header.entry_count = entries;
+    header.data_offset = data_offset;
+    std::memcpy(buffer_.data(), &header, sizeof(header));
+
+    float* planes_out = reinterpret_cast<float*>(buffer_.data() + data_offset);
+    std::uint8_t* terminations_out = buffer_.data() + data_offset + entries * planes * sizeof(float);
+
+    // Trace without the disk and around the origin; only directions are stored
+    BlackHoleParameters table_params = params;
+    table_params.spin = header.spin;
+    table_params.position = Eigen::Vector3d::Zero();
+    table_params.accretion_disk_inner_radius = 0.0;
+    table_params.accretion_disk_outer_radius = 0.0;
+
+    GeodesicSettings geodesic;
+    geodesic.escape_radius = std::max(geodesic.escape_radius, 2.0 * settings.max_radius);
+    GeodesicIntegrator integrator(table_params, geodesic);
+    const double rg = integrator.get_gravitational_radius();
+
+    const std::size_t slice = static_cast<std::size_t>(polars) * azimuths;
+
+    ThreadPool pool;
+    pool.parallel_for(static_cast<std::size_t>(radii) * inclinations, [&](std::size_t index, unsigned) {
+        int i = static_cast<int>(index / inclinations);
+        int j = static_cast<int>(index % inclinations);
+
+        double r = radius_at(i, radii, settings.min_radius, settings.max_radius);
+        // Schwarzschild tables are traced in the equatorial plane
+        double mu = schwarzschild ? 0.0 : static_cast<double>(j) / (inclinations - 1);
+        double sin_theta = std::sqrt(1.0 - mu * mu);
+
+        Eigen::Vector3d p(r * sin_theta, 0.0, r * mu);
+        Eigen::Vector3d e_r(sin_theta, 0.0, mu);
+        Eigen::Vector3d e_theta(mu, 0.0, -sin_theta);
+        Eigen::Vector3d e_phi(0.0, 1.0, 0.0);
+
+        std::vector<GeodesicRay> rays(slice);
+        for (int k = 0; k < polars; ++k) {
+            double psi = polar_angle(k, polars);
+            for (int l = 0; l < azimuths; ++l) {
+                double chi = 2.0 * M_PI * l / azimuths;
+                Eigen::Vector3d n = -std::cos(psi) * e_r +
+                                    std::sin(psi) * (std::cos(chi) * e_theta + std::sin(chi) * e_phi);
+                rays[static_cast<std::size_t>(k) * azimuths + l] =
+                    GeodesicRay{bl_to_world(p) * rg, bl_to_world(n)};
+            }
+        }
+
+        std::vector<GeodesicResult> results;
+        integrator.trace(rays, results);
+
+        std::size_t base = index * slice;
+        for (std::size_t s = 0; s < slice; ++s) {
+            const GeodesicResult& result = results[s];
+            Eigen::Vector3d d = world_to_bl(result.direction);
+            terminations_out[base + s] = static_cast<std::uint8_t>(result.termination);
+
+            if (schwarzschild) {
+                // Angle of the final direction from the inward radial, in the ray's plane
+                planes_out[base + s] = static_cast<float>(std::atan2(d.dot(e_theta), -d.dot(e_r)));
+            } else {
+                planes_out[base + s] = static_cast<float>(d.x());
+                planes_out[entries + base + s] = static_cast<float>(d.y());
+                planes_out[2 * entries + base + s] = static_cast<float>(d.z());
+            }
+        }
+    });
+
+    attach(buffer_.data(), buffer_.size());
+}
+
+bool DeflectionTable::save(const std::string& path) const {
+    if (!header_) return false;
+
+    std::size_t planes = header_->kind == kKindKerr ? 3 : 1;
+    std::size_t size = header_->data_offset + header_->entry_count * (planes * sizeof(float) + 1);
+
+    // Written aside and renamed over the target, so processes mapping the old
+    // file keep it and a crash never leaves a torn table
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(header_), static_cast<std::streamsize>(size));
+        if (!file) return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+bool DeflectionTable::load(const std::string& path) {
+    release();
+
+#ifdef DEFLECTION_TABLE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    mapping_ = mapping;
+    mapping_size_ = static_cast<std::size_t>(info.st_size);
+    attach(static_cast<const unsigned char*>(mapping_), mapping_size_);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    attach(buffer_.data(), buffer_.size());
+#endif
+
+    if (!header_) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+bool DeflectionTable::load_or_build(const BlackHoleParameters& params,
+                                    const std::string& cache_directory,
+                                    const DeflectionTableSettings& settings) {
+    std::string path = cache_directory + "/" + get_file_name(params, settings);
+
+    if (load(path)) {
+        return true;
+    }
+
+    std::cout << "Building photon deflection table " << path << "..." << std::endl;
+    build(params, settings);
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+    if (!save(path)) {
+        std::cerr << "Failed to save deflection table to " << path << std::endl;
+    }
+    return is_valid();
+}
+
+DeflectionSample DeflectionTable::lookup(const Eigen::Vector3d& observer_offset,
+                                         const Eigen::Vector3d& direction) const {
+    if (!header_) return DeflectionSample();
+
+    double r = observer_offset.norm();
+    if (r < header_->min_radius || r > header_->max_radius || direction.squaredNorm() == 0.0) {
+        return DeflectionSample();
+    }
+
+    if (header_->kind == kKindSchwarzschild) {
+        return lookup_schwarzschild(observer_offset, direction.normalized());
+    }
+    return lookup_kerr(world_to_bl(observer_offset), world_to_bl(direction).normalized());
+}
+
+DeflectionSample DeflectionTable::lookup_schwarzschild(const Eigen::Vector3d& p,
+                                                       const Eigen::Vector3d& n) const {
+    const int radii = static_cast<int>(header_->dims[0]);
+    const int polars = static_cast<int>(header_->dims[2]);
+
+    double r = p.norm();
+    Eigen::Vector3d u = -p / r;
+    double cos_psi = std::clamp(n.dot(u), -1.0, 1.0);
+    Eigen::Vector3d w = n - cos_psi * u;
+    double w_norm = w.norm();
+    w = w_norm > 1e-12 ? Eigen::Vector3d(w / w_norm) : Eigen::Vector3d::Zero();
+
+    int i, k;
+    double fi, fk;
+    cell(std::log(r / header_->min_radius) / std::log(header_->max_radius / header_->min_radius) * (radii - 1),
+         radii, i, fi);
+    cell(polar_coordinate(std::acos(cos_psi), polars), polars, k, fk);
+
+    std::size_t index[4];
+    double weight[4];
+    for (int c = 0; c < 4; ++c) {
+        int di = c >> 1, dk = c & 1;
+        index[c] = static_cast<std::size_t>(std::min(i + di, radii - 1)) * polars + std::min(k + dk, polars - 1);
+        weight[c] = (di ? fi : 1.0 - fi) * (dk ? fk : 1.0 - fk);
+    }
+
+    int nearest = static_cast<int>(std::max_element(weight, weight + 4) - weight);
+    std::uint8_t termination = terminations_[index[nearest]];
+    double reference = planes_[index[nearest]];
+
+    // Blend only corners with the same fate and no branch cut of the angle in between
+    double gamma = 0.0;
+    bool blend = true;
+    for (int c = 0; c < 4 && blend; ++c) {
+        if (weight[c] == 0.0) continue;
+        blend = terminations_[index[c]] == termination && std::abs(planes_[index[c]] - reference) < M_PI;
+        gamma += weight[c] * planes_[index[c]];
+    }
+    if (!blend) gamma = reference;
+
+    DeflectionSample sample;
+    sample.valid = true;
+    sample.termination = static_cast<GeodesicTermination>(termination);
+    sample.direction = (std::cos(gamma) * u + std::sin(gamma) * w).normalized();
+    return sample;
+}
+
+DeflectionSample DeflectionTable::lookup_kerr(const Eigen::Vector3d& p_in, const Eigen::Vector3d& n_in) const {
+    const int radii = static_cast<int>(header_->dims[0]);
+    const int inclinations = static_cast<int>(header_->dims[1]);
+    const int polars = static_cast<int>(header_->dims[2]);
+    const int azimuths = static_cast<int>(header_->dims[3]);
+
+    // Reflect into the northern hemisphere and rotate the observer to phi = 0
+    Eigen::Vector3d p = p_in, n = n_in;
+    bool mirrored = p.z() < 0.0;
+    if (mirrored) {
+        p.z() = -p.z();
+        n.z() = -n.z();
+    }
+    double phi = std::atan2(p.y(), p.x());
+    Eigen::AngleAxisd to_meridian(-phi, Eigen::Vector3d::UnitZ());
+    p = to_meridian * p;
+    n = to_meridian * n;
+
+    double r = p.norm();
+    double mu = std::clamp(p.z() / r, 0.0, 1.0);
+    double sin_theta = std::sqrt(1.0 - mu * mu);
+    Eigen::Vector3d e_r(sin_theta, 0.0, mu);
+    Eigen::Vector3d e_theta(mu, 0.0, -sin_theta);
+
+    double psi = std::acos(std::clamp(-n.dot(e_r), -1.0, 1.0));
+    double chi = std::atan2(n.y(), n.dot(e_theta));
+    if (chi < 0.0) chi += 2.0 * M_PI;
+
+    int i, j, k;
+    double fi, fj, fk;
+    cell(std::log(r / header_->min_radius) / std::log(header_->max_radius / header_->min_radius) * (radii - 1),
+         radii, i, fi);
+    cell(mu * (inclinations - 1), inclinations, j, fj);
+    cell(polar_coordinate(psi, polars), polars, k, fk);
+
+    // Azimuth is periodic
+    double x = chi / (2.0 * M_PI) * azimuths;
+    int l = static_cast<int>(x) % azimuths;
+    double fl = x - std::floor(x);
+
+    std::size_t index[16];
+    double weight[16];
+    for (int c = 0; c < 16; ++c) {
+        int di = (c >> 3) & 1, dj = (c >> 2) & 1, dk = (c >> 1) & 1, dl = c & 1;
+        std::size_t ii = std::min(i + di, radii - 1);
+        std::size_t jj = std::min(j + dj, inclinations - 1);
+        std::size_t kk = std::min(k + dk, polars - 1);
+        std::size_t ll = (l + dl) % azimuths;
+        index[c] = ((ii * inclinations + jj) * polars + kk) * azimuths + ll;
+        weight[c] = (di ? fi : 1.0 - fi) * (dj ? fj : 1.0 - fj) * (dk ? fk : 1.0 - fk) * (dl ? fl : 1.0 - fl);
+    }
+
+    const std::size_t entries = header_->entry_count;
+    int nearest = static_cast<int>(std::max_element(weight, weight + 16) - weight);
+    std::uint8_t termination = terminations_[index[nearest]];
+
+    Eigen::Vector3d d = Eigen::Vector3d::Zero();
+    bool blend = true;
+    for (int c = 0; c < 16; ++c) {
+        if (weight[c] == 0.0) continue;
+        if (terminations_[index[c]] != termination) {
+            blend = false;
+            break;
+        }
+        d += weight[c] * Eigen::Vector3d(planes_[index[c]], planes_[entries + index[c]],
+                                         planes_[2 * entries + index[c]]);
+    }
+    if (!blend || d.squaredNorm() < 1e-12) {
+        std::size_t s = index[nearest];
+        d = Eigen::Vector3d(planes_[s], planes_[entries + s], planes_[2 * entries + s]);
+    }
+
+    d = to_meridian.inverse() * d.normalized();
+    if (mirrored) d.z() = -d.z();
+
+    DeflectionSample sample;
+    sample.valid = true;
+    sample.termination = static_cast<GeodesicTermination>(termination);
+    sample.direction = bl_to_world(d);
+    return sample;
+}
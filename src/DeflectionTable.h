@@ -0,0 +1,121 @@
+#ifndef DEFLECTIONTABLE_H
+#define DEFLECTIONTABLE_H
+
+#include "GeodesicIntegrator.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BlackHoleParameters;
+
+struct DeflectionTableSettings {
+    int radius_samples;       // Log-spaced observer radii
+    int inclination_samples;  // |cos(theta)| of the observer, Kerr only
+    int polar_samples;        // Angle between the ray and the direction to the hole
+    int azimuth_samples;      // Angle around the direction to the hole, Kerr only
+    double min_radius;        // Gravitational radii
+    double max_radius;
+
+    DeflectionTableSettings() :
+        radius_samples(24),
+        inclination_samples(17),
+        polar_samples(96),
+        azimuth_samples(48),
+        min_radius(3.0),
+        max_radius(1000.0) {}
+};
+
+struct DeflectionSample {
+    bool valid;                      // False when the observer lies outside the table
+    GeodesicTermination termination; // Escaped or Horizon
+    Eigen::Vector3d direction;       // Final direction of escaped rays, world axes
+
+    DeflectionSample() :
+        valid(false),
+        termination(GeodesicTermination::Escaped),
+        direction(Eigen::Vector3d::Zero()) {}
+};
+
+// Precomputed photon deflection and capture for one black hole spin.
+//
+// A non-rotating hole is spherically symmetric, so the table is 2D: observer
+// radius and the angle between the ray and the hole. A Kerr hole is only
+// axisymmetric and reflection symmetric about the equator, which adds the
+// observer's |cos(theta)| and the ray's azimuth around the hole direction.
+// Entries are traced without the accretion disk, in gravitational radii, so one
+// table serves every mass. Lookups interpolate multilinearly between samples
+// that agree on the termination and fall back to the nearest one otherwise.
+//
+// Tables are saved as a versioned file in host byte order (header followed by
+// planar float and byte arrays) that is memory-mapped on load. An endian marker
+// in the header makes a file from a host of the other byte order load as
+// invalid, so load_or_build rebuilds it.
+class DeflectionTable {
+public:
+    static const std::uint32_t kVersion = 1;
+
+    // Spins below this are treated as Schwarzschild
+    static constexpr double kSchwarzschildSpin = 1e-3;
+
+    DeflectionTable();
+    ~DeflectionTable();
+
+    DeflectionTable(const DeflectionTable&) = delete;
+    DeflectionTable& operator=(const DeflectionTable&) = delete;
+
+    // Map the cached table for these parameters, building and saving it if needed
+    bool load_or_build(const BlackHoleParameters& params,
+                       const std::string& cache_directory = "cache",
+                       const DeflectionTableSettings& settings = DeflectionTableSettings());
+
+    void build(const BlackHoleParameters& params,
+               const DeflectionTableSettings& settings = DeflectionTableSettings());
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    // observer_offset: observer position relative to the hole in gravitational radii,
+    // world axes (spin along y). direction need not be normalized.
+    DeflectionSample lookup(const Eigen::Vector3d& observer_offset,
+                            const Eigen::Vector3d& direction) const;
+
+    bool is_valid() const { return header_ != nullptr; }
+    bool is_schwarzschild() const;
+    double get_spin() const;
+
+    static std::string get_file_name(const BlackHoleParameters& params,
+                                     const DeflectionTableSettings& settings);
+
+private:
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t endian_marker;
+        std::uint32_t kind;
+        std::uint32_t dims[4];       // r, |cos theta|, psi, chi
+        std::uint32_t reserved;
+        double spin;
+        double min_radius;
+        double max_radius;
+        std::uint64_t entry_count;
+        std::uint64_t data_offset;
+    };
+
+    // Either a private mapping of a file or an owned buffer with the same layout
+    void* mapping_;
+    std::size_t mapping_size_;
+    std::vector<unsigned char> buffer_;
+
+    const Header* header_;
+    const float* planes_;            // Schwarzschild: gamma; Kerr: x, y, z
+    const std::uint8_t* terminations_;
+
+    void attach(const unsigned char* data, std::size_t size);
+    void release();
+
+    DeflectionSample lookup_schwarzschild(const Eigen::Vector3d& p, const Eigen::Vector3d& n) const;
+    DeflectionSample lookup_kerr(const Eigen::Vector3d& p, const Eigen::Vector3d& n) const;
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "DiskEmission.h"
+#include "BlackHole.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Innermost stable circular orbit, prograde for positive spin
+double isco_radius(double a) {
+    double z1 = 1.0 + std::cbrt(1.0 - a * a) * (std::cbrt(1.0 + a) + std::cbrt(1.0 - a));
+    double z2 = std::sqrt(3.0 * a * a + z1 * z1);
+    double root = std::sqrt(std::max(0.0, (3.0 - z1) * (3.0 + z1 + 2.0 * z2)));
+    return 3.0 + z2 - (a < 0.0 ? -root : root);
+}
+
+// Energy at infinity per unit rest mass of a circular equatorial orbit
+double orbit_energy(double r, double a) {
+    double x = std::sqrt(r);
+    return (r * x - 2.0 * x + a) / (std::pow(r, 0.75) * std::sqrt(r * x - 3.0 * x + 2.0 * a));
+}
+
+// Page-Thorne flux in units of 3 Mdot / (8 pi M^2), x = sqrt(r / M), zero torque at x0
+double page_thorne_flux(double x, double a, double x0) {
+    if (x <= x0) return 0.0;
+
+    const double t = std::acos(std::clamp(a, -1.0, 1.0));
+    const double roots[3] = {2.0 * std::cos((t - M_PI) / 3.0),
+                             2.0 * std::cos((t + M_PI) / 3.0),
+                             -2.0 * std::cos(t / 3.0)};
+
+    double bracket = x - x0 - 1.5 * a * std::log(x / x0);
+    for (int i = 0; i < 3; ++i) {
+        double xi = roots[i];
+        double xj = roots[(i + 1) % 3];
+        double xk = roots[(i + 2) % 3];
+        // (x_i - a)^2 / x_i vanishes with x_i for a = 0
+        if (std::abs(xi) < 1e-12) continue;
+        bracket -= 3.0 * (xi - a) * (xi - a) / (xi * (xi - xj) * (xi - xk)) *
+                   std::log((x - xi) / (x0 - xi));
+    }
+
+    double x3 = x * x * x;
+    return std::max(0.0, bracket / (x3 * x * (x3 - 3.0 * x + 2.0 * a)));
+}
+
+// CIE 1931 2-degree matching functions, multi-lobe Gaussian fit (Wyman et al. 2013)
+double lobe(double lambda, double mu, double sigma_low, double sigma_high) {
+    double s = (lambda - mu) / (lambda < mu ? sigma_low : sigma_high);
+    return std::exp(-0.5 * s * s);
+}
+
+Eigen::Vector3d cie_xyz(double lambda) {
+    return Eigen::Vector3d(
+        1.056 * lobe(lambda, 599.8, 37.9, 31.0) + 0.362 * lobe(lambda, 442.0, 16.0, 26.7) -
+            0.065 * lobe(lambda, 501.1, 20.4, 26.2),
+        0.821 * lobe(lambda, 568.8, 46.9, 40.5) + 0.286 * lobe(lambda, 530.9, 16.3, 31.1),
+        1.217 * lobe(lambda, 437.0, 11.8, 36.0) + 0.681 * lobe(lambda, 459.0, 26.0, 13.8));
+}
+
+// Unscaled XYZ of a blackbody at temperature T (Kelvin)
+Eigen::Vector3d blackbody_xyz(double temperature) {
+    const double h = 6.62607015e-34;
+    const double c = 299792458.0;
+    const double k = 1.380649e-23;
+
+    Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+    for (double lambda = 380.0; lambda <= 780.0; lambda += 5.0) {
+        double l = lambda * 1e-9;
+        double exponent = h * c / (l * k * temperature);
+        if (exponent > 700.0) continue;
+        double radiance = 1.0 / (l * l * l * l * l * std::expm1(exponent));
+        xyz += cie_xyz(lambda) * radiance;
+    }
+    return xyz;
+}
+
+Eigen::Vector3d xyz_to_linear_srgb(const Eigen::Vector3d& xyz) {
+    Eigen::Vector3d rgb(
+        3.2406 * xyz.x() - 1.5372 * xyz.y() - 0.4986 * xyz.z(),
+        -0.9689 * xyz.x() + 1.8758 * xyz.y() + 0.0415 * xyz.z(),
+        0.0557 * xyz.x() - 0.2040 * xyz.y() + 1.0570 * xyz.z());
+    return rgb.cwiseMax(0.0);
+}
+
+// Linear interpolation in a table sampled at 0 .. n-1, clamped at the ends
+float sample_table(const std::vector<float>& table, int channels, int channel, double u) {
+    int n = static_cast<int>(table.size()) / channels;
+    u = std::clamp(u, 0.0, static_cast<double>(n - 1));
+    int i = std::min(static_cast<int>(u), n - 2);
+    float f = static_cast<float>(u - i);
+    return table[i * channels + channel] * (1.0f - f) + table[(i + 1) * channels + channel] * f;
+}
+
+}
+
+DiskEmission::DiskEmission()
+    : mass_(0.0), spin_(0.0), disk_inner_radius_(0.0), disk_outer_radius_(0.0),
+      inner_radius_(0.0), outer_radius_(0.0), peak_temperature_(0.0) {}
+
+DiskEmission::DiskEmission(const BlackHoleParameters& params, const DiskEmissionSettings& settings)
+    : DiskEmission() {
+    build(params, settings);
+}
+
+bool DiskEmission::matches(const BlackHoleParameters& params) const {
+    return is_valid() && params.mass == mass_ && params.spin == spin_ &&
+           params.accretion_disk_inner_radius == disk_inner_radius_ &&
+           params.accretion_disk_outer_radius == disk_outer_radius_;
+}
+
+void DiskEmission::build(const BlackHoleParameters& params, const DiskEmissionSettings& settings) {
+    const double G = 6.67430e-11;
+    const double c = 299792458.0;
+    const double solar_mass = 1.989e30;
+    const double stefan_boltzmann = 5.670374419e-8;
+    const double eddington_per_solar_mass = 1.26e31;  // W
+
+    settings_ = settings;
+    mass_ = params.mass;
+    spin_ = params.spin;
+    disk_inner_radius_ = params.accretion_disk_inner_radius;
+    disk_outer_radius_ = params.accretion_disk_outer_radius;
+
+    const double a = std::clamp(params.spin, -0.998, 0.998);
+    inner_radius_ = std::max(2.0 * params.accretion_disk_inner_radius, isco_radius(a));
+    outer_radius_ = std::max(2.0 * params.accretion_disk_outer_radius, inner_radius_ * 1.001);
+
+    const int radial = std::max(2, settings.radial_samples);
+    const double x0 = std::sqrt(inner_radius_);
+    const double log_span = std::log(outer_radius_ / inner_radius_);
+
+    std::vector<double> flux(radial);
+    double peak_flux = 0.0;
+    for (int i = 0; i < radial; ++i) {
+        double r = inner_radius_ * std::exp(log_span * i / (radial - 1));
+        flux[i] = page_thorne_flux(std::sqrt(r), a, x0);
+        peak_flux = std::max(peak_flux, flux[i]);
+    }
+
+    temperature_table_.resize(radial);
+    for (int i = 0; i < radial; ++i) {
+        temperature_table_[i] = peak_flux > 0.0 ? static_cast<float>(std::pow(flux[i] / peak_flux, 0.25)) : 0.0f;
+    }
+
+    if (settings.peak_temperature > 0.0) {
+        peak_temperature_ = settings.peak_temperature;
+    } else {
+        // Mdot from the luminosity and the radiative efficiency 1 - E at the inner edge
+        double M = params.mass * solar_mass;
+        double efficiency = 1.0 - orbit_energy(inner_radius_, a);
+        double accretion_rate = settings.eddington_ratio * eddington_per_solar_mass * params.mass /
+                                (efficiency * c * c);
+        double scale = 3.0 * accretion_rate * std::pow(c, 6) / (8.0 * M_PI * G * G * M * M);
+        peak_temperature_ = std::pow(scale * peak_flux / stefan_boltzmann, 0.25);
+    }
+
+    const int colors = std::max(2, settings.color_samples);
+    const double log_min = std::log(settings.min_temperature_ratio);
+    const double log_max = std::log(settings.max_temperature_ratio);
+    const double peak_luminance = blackbody_xyz(peak_temperature_).y();
+
+    color_table_.resize(static_cast<std::size_t>(colors) * 3);
+    for (int i = 0; i < colors; ++i) {
+        double ratio = std::exp(log_min + (log_max - log_min) * i / (colors - 1));
+        Eigen::Vector3d rgb = xyz_to_linear_srgb(blackbody_xyz(ratio * peak_temperature_)) / peak_luminance;
+        color_table_[i * 3 + 0] = static_cast<float>(rgb.x());
+        color_table_[i * 3 + 1] = static_cast<float>(rgb.y());
+        color_table_[i * 3 + 2] = static_cast<float>(rgb.z());
+    }
+}
+
+float DiskEmission::temperature_ratio(double radius) const {
+    if (!is_valid() || radius < inner_radius_ || radius > outer_radius_) return 0.0f;
+    double u = std::log(radius / inner_radius_) / std::log(outer_radius_ / inner_radius_);
+    return sample_table(temperature_table_, 1, 0, u * (temperature_table_.size() - 1));
+}
+
+double DiskEmission::redshift(double radius, double angular_momentum) const {
+    const double a = std::clamp(spin_, -0.998, 0.998);
+    double x = std::sqrt(radius);
+    double r32 = radius * x;
+    double denominator = r32 - 3.0 * x + 2.0 * a;
+    if (denominator <= 0.0) return 0.0;  // No circular orbit
+
+    double omega = 1.0 / (r32 + a);
+    double u_t = (r32 + a) / (std::pow(radius, 0.75) * std::sqrt(denominator));
+    // The emitted photon runs opposite to the traced ray, so its L/E is -angular_momentum
+    double g = 1.0 / (u_t * (1.0 + omega * angular_momentum));
+    return g > 0.0 ? g : 0.0;
+}
+
+Eigen::Vector3f DiskEmission::color(double ratio) const {
+    if (!is_valid() || ratio <= 0.0) return Eigen::Vector3f::Zero();
+    const int n = static_cast<int>(color_table_.size() / 3);
+    double log_min = std::log(settings_.min_temperature_ratio);
+    double log_max = std::log(settings_.max_temperature_ratio);
+    double u = (std::log(ratio) - log_min) / (log_max - log_min) * (n - 1);
+    return Eigen::Vector3f(sample_table(color_table_, 3, 0, u),
+                           sample_table(color_table_, 3, 1, u),
+                           sample_table(color_table_, 3, 2, u));
+}
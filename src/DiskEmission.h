@@ -0,0 +1,89 @@
+#ifndef DISKEMISSION_H
+#define DISKEMISSION_H
+
+#include <Eigen/Dense>
+#include <vector>
+
+struct BlackHoleParameters;
+
+struct DiskEmissionSettings {
+    double eddington_ratio;        // Disk luminosity over the Eddington luminosity
+    double peak_temperature;       // Kelvin; 0 derives it from mass and eddington_ratio
+    int radial_samples;            // Log-spaced between the inner and outer edge
+    int color_samples;             // Log-spaced in observed temperature
+    double min_temperature_ratio;  // Color table range, observed over peak temperature
+    double max_temperature_ratio;
+
+    DiskEmissionSettings() :
+        eddington_ratio(0.1),
+        peak_temperature(0.0),
+        radial_samples(256),
+        color_samples(256),
+        min_temperature_ratio(1.0 / 32.0),
+        max_temperature_ratio(8.0) {}
+};
+
+// Thin-disk emission for one set of black hole parameters, as lookup tables.
+//
+// The radial table holds the Novikov-Thorne (Page-Thorne) temperature profile
+// of a Kerr disk with zero torque at its inner edge, which is the larger of the
+// configured inner radius and the ISCO. The color table holds the linear sRGB
+// of a blackbody, integrated against the CIE 1931 matching functions. Since
+// I_nu / nu^3 is invariant along a ray, a disk element at temperature T seen
+// with redshift g looks exactly like a blackbody at g T, so the same 1D table
+// serves every redshift and includes the g^4 beaming. Colors are normalized to
+// luminance 1 at the peak disk temperature.
+//
+// Radii are in gravitational radii (GM/c^2). The tables are plain float arrays
+// laid out for upload as 1D textures; the CPU lookups interpolate them the same
+// way the GL sampler does.
+class DiskEmission {
+public:
+    DiskEmission();
+    explicit DiskEmission(const BlackHoleParameters& params,
+                          const DiskEmissionSettings& settings = DiskEmissionSettings());
+
+    void build(const BlackHoleParameters& params,
+               const DiskEmissionSettings& settings = DiskEmissionSettings());
+    bool is_valid() const { return !temperature_table_.empty(); }
+
+    // True when the tables were built for these mass, spin and disk radii
+    bool matches(const BlackHoleParameters& params) const;
+
+    // Emitted temperature over the peak temperature; 0 off the emitting disk
+    float temperature_ratio(double radius) const;
+
+    // Observed over emitted photon energy for a disk hit at radius, for a ray
+    // traced back from a distant observer with axial angular momentum L (E = 1)
+    double redshift(double radius, double angular_momentum) const;
+
+    // Linear sRGB of a blackbody at ratio times the peak temperature
+    Eigen::Vector3f color(double ratio) const;
+
+    Eigen::Vector3f emission(double radius, double redshift) const {
+        return color(redshift * temperature_ratio(radius));
+    }
+
+    const std::vector<float>& get_temperature_table() const { return temperature_table_; }
+    const std::vector<float>& get_color_table() const { return color_table_; }  // RGB triplets
+    double get_inner_radius() const { return inner_radius_; }
+    double get_outer_radius() const { return outer_radius_; }
+    double get_peak_temperature() const { return peak_temperature_; }
+    double get_spin() const { return spin_; }
+    const DiskEmissionSettings& get_settings() const { return settings_; }
+
+private:
+    DiskEmissionSettings settings_;
+    double mass_;               // Solar masses, as built
+    double spin_;
+    double disk_inner_radius_;  // Parameters as built, in Schwarzschild radii
+    double disk_outer_radius_;
+    double inner_radius_;       // Emitting disk, gravitational radii
+    double outer_radius_;
+    double peak_temperature_;   // Kelvin
+
+    std::vector<float> temperature_table_;
+    std::vector<float> color_table_;
+};
+
+#endif
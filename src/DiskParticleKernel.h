@@ -0,0 +1,30 @@
+#ifndef DISKPARTICLEKERNEL_H
+#define DISKPARTICLEKERNEL_H
+
+#include <cstddef>
+
+// Plain-data interface between DiskParticles and the per-ISA orbit kernels,
+// which are compiled with ISA-specific flags.
+
+// Structure-of-arrays particle state, one entry per particle
+struct DiskParticleView {
+    const float* radius;
+    const float* height;
+    const float* frequency;  // Orbits per unit time
+    float* phase;            // Orbits, kept in [0, 1)
+    float* positions;        // x, y, z per particle
+};
+
+// Advances the phase of particles [begin, end) by frequency * time_step and
+// writes their positions (r cos 2 pi phase, height, -r sin 2 pi phase), which
+// turn the same way as the disk shader's velocities
+void advance_disk_particles_scalar(const DiskParticleView& particles, std::size_t begin, std::size_t end,
+                                   float time_step);
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+// Particles from begin in groups of 8; returns the first particle not done
+std::size_t advance_disk_particles_avx2(const DiskParticleView& particles, std::size_t begin, std::size_t end,
+                                        float time_step);
+#endif
+
+#endif
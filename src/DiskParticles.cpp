@@ -0,0 +1,93 @@
+#include "DiskParticles.h"
+#include "DiskParticleKernel.h"
+#include "GeodesicPacket.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+// Particles per task; a few hundred KB of planes and output
+const std::size_t kParticleBlock = 16384;
+
+const float kTwoPi = 6.28318530718f;
+
+// sin and cos of 2 pi turns for |turns| <= 1/8, Taylor to the 7th and 8th order
+inline void sincos_eighth(float turns, float& s, float& c) {
+    float x = kTwoPi * turns;
+    float x2 = x * x;
+    s = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f))));
+    c = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f))));
+}
+
+}
+
+void advance_disk_particles_scalar(const DiskParticleView& particles, std::size_t begin, std::size_t end,
+                                   float time_step) {
+    for (std::size_t i = begin; i < end; ++i) {
+        float phase = particles.phase[i] + particles.frequency[i] * time_step;
+        phase -= std::floor(phase);
+        particles.phase[i] = phase;
+
+        // Quarter turns reduce the angle to |x| <= pi / 4
+        int quadrant = static_cast<int>(std::nearbyint(4.0f * phase));
+        float s, c;
+        sincos_eighth(phase - 0.25f * static_cast<float>(quadrant), s, c);
+        if (quadrant & 1) std::swap(s, c);
+        if (quadrant & 2) s = -s;
+        if ((quadrant + 1) & 2) c = -c;
+
+        float* out = particles.positions + 3 * i;
+        out[0] = particles.radius[i] * c;
+        out[1] = particles.height[i];
+        out[2] = -particles.radius[i] * s;
+    }
+}
+
+DiskParticles::DiskParticles(unsigned thread_count)
+    : pool_(std::make_unique<ThreadPool>(thread_count)) {}
+
+void DiskParticles::build(double inner_radius, double outer_radius, double spin,
+                          const DiskParticleSettings& settings) {
+    settings_ = settings;
+    const std::size_t count = settings.count;
+    radius_.resize(count);
+    height_.resize(count);
+    frequency_.resize(count);
+    phase_.resize(count);
+
+    std::mt19937 gen(settings.seed);
+    std::uniform_real_distribution<double> area(inner_radius * inner_radius, outer_radius * outer_radius);
+    std::uniform_real_distribution<float> turn(0.0f, 1.0f);
+    std::normal_distribution<double> thickness(0.0, settings.scale_height);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        double r = std::sqrt(area(gen));
+        radius_[i] = static_cast<float>(r);
+        height_[i] = static_cast<float>(r * thickness(gen));
+        frequency_[i] = static_cast<float>(1.0 / (2.0 * M_PI * (r * std::sqrt(r) + spin)));
+        phase_[i] = turn(gen);
+    }
+}
+
+void DiskParticles::advance(double time_step, float* positions) {
+    const std::size_t count = size();
+    const DiskParticleView view{radius_.data(), height_.data(), frequency_.data(), phase_.data(), positions};
+    const float step = static_cast<float>(time_step);
+#ifdef BLACKHOLE_SIMD_KERNELS
+    const SimdIsa isa = detect_simd_isa();
+#endif
+
+    const std::size_t blocks = (count + kParticleBlock - 1) / kParticleBlock;
+    pool_->parallel_for(blocks, [&](std::size_t block, unsigned) {
+        const std::size_t begin = block * kParticleBlock;
+        const std::size_t end = std::min(begin + kParticleBlock, count);
+        std::size_t done = begin;
+#ifdef BLACKHOLE_SIMD_KERNELS
+        if (isa == SimdIsa::Avx512 || isa == SimdIsa::Avx2) {
+            done = advance_disk_particles_avx2(view, done, end, step);
+        }
+#endif
+        advance_disk_particles_scalar(view, done, end, step);
+    });
+}
@@ -0,0 +1,57 @@
+#ifndef DISKPARTICLES_H
+#define DISKPARTICLES_H
+
+#include "ThreadPool.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct DiskParticleSettings {
+    std::size_t count;
+    double scale_height;  // Gaussian thickness over radius
+    double time_scale;    // GM/c^3 of orbit time per second of animation
+    unsigned seed;
+
+    DiskParticleSettings() :
+        count(1 << 20),
+        scale_height(0.01),
+        time_scale(10.0),
+        seed(1) {}
+};
+
+// Persistent accretion disk particles on circular equatorial orbits.
+//
+// Particles are seeded once, uniform in area between the disk edges, and keep
+// their radius, height and orbital frequency as float planes. The prograde
+// circular orbit of a Kerr hole has Omega = 1 / (r^3/2 + a) in gravitational
+// units, which is Keplerian for a = 0 and carries the frame dragging
+// otherwise, so particles move analytically with no force integration. Each
+// advance adds Omega dt to the phases, wrapped to one orbit so float precision
+// does not decay with time, and writes the positions in one parallel pass with
+// the widest kernel this CPU runs. The output can be a mapped GL buffer.
+//
+// Radii are in gravitational radii (GM/c^2) and times in GM/c^3.
+class DiskParticles {
+public:
+    // thread_count = 0 uses all hardware threads
+    explicit DiskParticles(unsigned thread_count = 0);
+
+    void build(double inner_radius, double outer_radius, double spin,
+               const DiskParticleSettings& settings = DiskParticleSettings());
+
+    // Moves every particle by time_step and writes x, y, z per particle to positions
+    void advance(double time_step, float* positions);
+
+    std::size_t size() const { return radius_.size(); }
+    const DiskParticleSettings& get_settings() const { return settings_; }
+
+private:
+    DiskParticleSettings settings_;
+    std::vector<float> radius_;
+    std::vector<float> height_;
+    std::vector<float> frequency_;
+    std::vector<float> phase_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "DiskParticleKernel.h"
+#include <immintrin.h>
+
+std::size_t advance_disk_particles_avx2(const DiskParticleView& particles, std::size_t begin, std::size_t end,
+                                        float time_step) {
+    const __m256 step = _mm256_set1_ps(time_step);
+    const __m256 two_pi = _mm256_set1_ps(6.28318530718f);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 phase = _mm256_fmadd_ps(_mm256_loadu_ps(particles.frequency + i), step,
+                                       _mm256_loadu_ps(particles.phase + i));
+        phase = _mm256_sub_ps(phase, _mm256_floor_ps(phase));
+        _mm256_storeu_ps(particles.phase + i, phase);
+
+        // Quarter turns reduce the angle to |x| <= pi / 4, as in the scalar kernel
+        __m256 quarters = _mm256_round_ps(_mm256_mul_ps(phase, _mm256_set1_ps(4.0f)),
+                                          _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256i quadrant = _mm256_cvtps_epi32(quarters);
+        __m256 x = _mm256_mul_ps(two_pi, _mm256_fnmadd_ps(quarters, _mm256_set1_ps(0.25f), phase));
+        __m256 x2 = _mm256_mul_ps(x, x);
+
+        __m256 s = _mm256_fmadd_ps(x2, _mm256_set1_ps(-1.0f / 5040.0f), _mm256_set1_ps(1.0f / 120.0f));
+        s = _mm256_fmadd_ps(x2, s, _mm256_set1_ps(-1.0f / 6.0f));
+        s = _mm256_fmadd_ps(x2, s, _mm256_set1_ps(1.0f));
+        s = _mm256_mul_ps(x, s);
+        __m256 c = _mm256_fmadd_ps(x2, _mm256_set1_ps(1.0f / 40320.0f), _mm256_set1_ps(-1.0f / 720.0f));
+        c = _mm256_fmadd_ps(x2, c, _mm256_set1_ps(1.0f / 24.0f));
+        c = _mm256_fmadd_ps(x2, c, _mm256_set1_ps(-0.5f));
+        c = _mm256_fmadd_ps(x2, c, _mm256_set1_ps(1.0f));
+
+        // Odd quadrants swap sin and cos; bit 1 of q flips sin, of q + 1 flips cos
+        __m256 odd = _mm256_castsi256_ps(_mm256_slli_epi32(quadrant, 31));
+        __m256 sin_phase = _mm256_blendv_ps(s, c, odd);
+        __m256 cos_phase = _mm256_blendv_ps(c, s, odd);
+        __m256 sin_sign = _mm256_castsi256_ps(_mm256_slli_epi32(quadrant, 30));
+        __m256 cos_sign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(quadrant, _mm256_set1_epi32(1)), 30));
+        sin_phase = _mm256_xor_ps(sin_phase, _mm256_and_ps(sin_sign, sign));
+        cos_phase = _mm256_xor_ps(cos_phase, _mm256_and_ps(cos_sign, sign));
+
+        __m256 radius = _mm256_loadu_ps(particles.radius + i);
+        __m256 px = _mm256_mul_ps(radius, cos_phase);
+        __m256 py = _mm256_loadu_ps(particles.height + i);
+        __m256 pz = _mm256_xor_ps(_mm256_mul_ps(radius, sin_phase), sign);
+
+        // Interleave to x, y, z per particle: 8 triples in three registers
+        // x0 y0 z0 x1 y1 z1 x2 y2 | z2 x3 y3 z3 x4 y4 z4 x5 | y5 z5 x6 y6 z6 x7 y7 z7
+        const __m256i ia = _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2);
+        const __m256i ib = _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5);
+        const __m256i ic = _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7);
+        __m256 first = _mm256_permutevar8x32_ps(px, ia);
+        first = _mm256_blend_ps(first, _mm256_permutevar8x32_ps(py, ia), 0x92);
+        first = _mm256_blend_ps(first, _mm256_permutevar8x32_ps(pz, ia), 0x24);
+        __m256 second = _mm256_permutevar8x32_ps(px, ib);
+        second = _mm256_blend_ps(second, _mm256_permutevar8x32_ps(py, ib), 0x24);
+        second = _mm256_blend_ps(second, _mm256_permutevar8x32_ps(pz, ib), 0x49);
+        __m256 third = _mm256_permutevar8x32_ps(px, ic);
+        third = _mm256_blend_ps(third, _mm256_permutevar8x32_ps(py, ic), 0x49);
+        third = _mm256_blend_ps(third, _mm256_permutevar8x32_ps(pz, ic), 0x92);
+        float* out = particles.positions + 3 * i;
+        _mm256_storeu_ps(out, first);
+        _mm256_storeu_ps(out + 8, second);
+        _mm256_storeu_ps(out + 16, third);
+    }
+    return i;
+}
+
+#endif
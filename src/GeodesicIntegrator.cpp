@@ -0,0 +1,384 @@
+#include "GeodesicIntegrator.h"
+#include "BlackHole.h"
+#include "GeodesicPacket.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double G = 6.67430e-11;
+const double c = 299792458.0;
+const double solar_mass = 1.989e30;
+
+using State = GeodesicIntegrator::State;
+
+// Dormand-Prince 5(4) tableau
+const double a21 = 1.0 / 5.0;
+const double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+const double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+const double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0, a53 = 64448.0 / 6561.0,
+             a54 = -212.0 / 729.0;
+const double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0,
+             a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+const double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0,
+             b5 = -2187.0 / 6784.0, b6 = 11.0 / 84.0;
+const double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0,
+             e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+// Dense output coefficients (Hairer's fourth-order continuous extension)
+const double d1 = -12715105075.0 / 11282082432.0, d3 = 87487479700.0 / 32700410799.0,
+             d4 = -10690763975.0 / 1880347072.0, d5 = 701980252875.0 / 199316789632.0,
+             d6 = -1453857185.0 / 822651844.0, d7 = 69997945.0 / 29380423.0;
+
+// Continuous extension of one accepted step, t in [0, 1]
+struct DenseStep {
+    State c1, c2, c3, c4, c5;
+    double h;
+
+    DenseStep(const State& y0, const State& y1, double step, const State& k1, const State& k3,
+              const State& k4, const State& k5, const State& k6, const State& k7)
+        : h(step) {
+        c1 = y0;
+        c2 = y1 - y0;
+        c3 = h * k1 - c2;
+        c4 = c2 - h * k7 - c3;
+        c5 = h * (d1 * k1 + d3 * k3 + d4 * k4 + d5 * k5 + d6 * k6 + d7 * k7);
+    }
+
+    State value(double t) const {
+        double s = 1.0 - t;
+        return c1 + t * (c2 + s * (c3 + t * (c4 + s * c5)));
+    }
+
+    double value(int i, double t) const {
+        double s = 1.0 - t;
+        return c1[i] + t * (c2[i] + s * (c3[i] + t * (c4[i] + s * c5[i])));
+    }
+};
+
+// Root of g on [0, 1] given end values of opposite sign (Illinois regula falsi)
+template <typename F>
+double locate_root(F g, double g0, double g1, double tolerance) {
+    if ((g0 > 0.0) == (g1 > 0.0)) return 1.0;
+
+    double a = 0.0, b = 1.0, ga = g0, gb = g1;
+    double t = -1.0;
+    int side = 0;
+    for (int i = 0; i < 64; ++i) {
+        double t_new = (a * gb - b * ga) / (gb - ga);
+        if (std::abs(t_new - t) < tolerance) return t_new;
+        t = t_new;
+
+        double gt = g(t);
+        if (gt == 0.0) return t;
+        if ((gt > 0.0) == (gb > 0.0)) {
+            b = t;
+            gb = gt;
+            if (side == -1) ga *= 0.5;
+            side = -1;
+        } else {
+            a = t;
+            ga = gt;
+            if (side == 1) gb *= 0.5;
+            side = 1;
+        }
+    }
+    return t;
+}
+
+// World axes (x, y, z) map to Boyer-Lindquist Cartesian axes (z, x, y) so that
+// the spin axis is the world y axis
+inline Eigen::Vector3d world_to_bl(const Eigen::Vector3d& v) {
+    return Eigen::Vector3d(v.z(), v.x(), v.y());
+}
+
+inline Eigen::Vector3d bl_to_world(const Eigen::Vector3d& v) {
+    return Eigen::Vector3d(v.y(), v.z(), v.x());
+}
+
+}
+
+GeodesicIntegrator::GeodesicIntegrator(const BlackHoleParameters& params,
+                                       const GeodesicSettings& settings)
+    : settings_(settings),
+      center_(params.position),
+      gravitational_radius_(G * params.mass * solar_mass / (c * c)),
+      spin_(std::clamp(params.spin, -0.9999, 0.9999)),
+      horizon_radius_(1.0 + std::sqrt(1.0 - spin_ * spin_)),
+      // Disk radii are given in Schwarzschild radii (2M)
+      disk_inner_radius_(2.0 * params.accretion_disk_inner_radius),
+      disk_outer_radius_(2.0 * params.accretion_disk_outer_radius) {}
+
+double GeodesicIntegrator::metric_tt(double r, double theta) const {
+    double cos_theta = std::cos(theta);
+    double sigma = r * r + spin_ * spin_ * cos_theta * cos_theta;
+    return -(1.0 - 2.0 * r / sigma);
+}
+
+Eigen::Vector4d GeodesicIntegrator::momentum_derivative(const Eigen::Vector4d& position,
+                                                        const Eigen::Vector4d& momentum) const {
+    const double a = spin_;
+    double r = position[1];
+    double theta = position[2];
+    double E = -momentum[0];
+    double p_r = momentum[1];
+    double p_theta = momentum[2];
+    double L = momentum[3];
+
+    double sin_theta = std::sin(theta);
+    double cos_theta = std::cos(theta);
+    double sin2 = std::max(sin_theta * sin_theta, 1e-12);
+    double Q = p_theta * p_theta + cos_theta * cos_theta * (L * L / sin2 - a * a * E * E);
+
+    double sigma = r * r + a * a * cos_theta * cos_theta;
+    double delta = r * r - 2.0 * r + a * a;
+    double delta_prime = 2.0 * r - 2.0;
+    double P = E * (r * r + a * a) - a * L;
+    double K = (L - a * E) * (L - a * E) + Q;
+    double R = P * P - delta * K;
+    double R_prime = 4.0 * r * E * P - delta_prime * K;
+
+    double dp_r = -(delta_prime * p_r * p_r - R_prime / delta + R * delta_prime / (delta * delta)) /
+                  (2.0 * sigma);
+    double dp_theta = cos_theta * sin_theta * (L * L / (sin2 * sin2) - a * a * E * E) / sigma;
+
+    return Eigen::Vector4d(0.0, dp_r, dp_theta, 0.0);
+}
+
+void GeodesicIntegrator::derivatives(const State& y, double L, double Q, State& dy) const {
+    const double a = spin_;
+    double r = y[0];
+    double sin_theta = std::sin(y[1]);
+    double cos_theta = std::cos(y[1]);
+    double sin2 = std::max(sin_theta * sin_theta, 1e-12);
+    double p_r = y[3];
+    double p_theta = y[4];
+
+    double sigma = r * r + a * a * cos_theta * cos_theta;
+    double inv_sigma = 1.0 / sigma;
+    double delta = r * r - 2.0 * r + a * a;
+    double delta_prime = 2.0 * r - 2.0;
+    double P = r * r + a * a - a * L;
+    double K = (L - a) * (L - a) + Q;
+    double R = P * P - delta * K;
+    double R_prime = 4.0 * r * P - delta_prime * K;
+
+    dy[0] = delta * p_r * inv_sigma;
+    dy[1] = p_theta * inv_sigma;
+    dy[2] = (a * P / delta + L / sin2 - a) * inv_sigma;
+    dy[3] = -0.5 * (delta_prime * p_r * p_r - R_prime / delta + R * delta_prime / (delta * delta)) *
+            inv_sigma;
+    dy[4] = cos_theta * sin_theta * (L * L / (sin2 * sin2) - a * a) * inv_sigma;
+}
+
+void GeodesicIntegrator::initial_state(const GeodesicRay& ray, State& y, double& L, double& Q) const {
+    const double a = spin_;
+    Eigen::Vector3d p = world_to_bl((ray.origin - center_) / gravitational_radius_);
+    Eigen::Vector3d n = world_to_bl(ray.direction).normalized();
+
+    // Oblate spheroidal inversion of x = sqrt(r^2 + a^2) sin(theta) cos(phi), z = r cos(theta)
+    double rho2 = p.squaredNorm() - a * a;
+    double r = std::sqrt(0.5 * (rho2 + std::sqrt(rho2 * rho2 + 4.0 * a * a * p.z() * p.z())));
+    double theta = std::acos(std::clamp(p.z() / r, -1.0, 1.0));
+    double phi = std::atan2(p.y(), p.x());
+
+    double sin_theta = std::sin(theta);
+    double cos_theta = std::cos(theta);
+    double sin_phi = std::sin(phi);
+    double cos_phi = std::cos(phi);
+
+    // Direction in the local orthonormal (r, theta, phi) frame, taken as the ZAMO frame
+    double n_r = n.dot(Eigen::Vector3d(sin_theta * cos_phi, sin_theta * sin_phi, cos_theta));
+    double n_theta = n.dot(Eigen::Vector3d(cos_theta * cos_phi, cos_theta * sin_phi, -sin_theta));
+    double n_phi = n.dot(Eigen::Vector3d(-sin_phi, cos_phi, 0.0));
+
+    double sin2 = std::max(sin_theta * sin_theta, 1e-12);
+    double sigma = r * r + a * a * cos_theta * cos_theta;
+    double delta = r * r - 2.0 * r + a * a;
+    double A = (r * r + a * a) * (r * r + a * a) - a * a * delta * sin2;
+    double lapse = std::sqrt(sigma * delta / A);
+    double omega = 2.0 * a * r / A;
+    double varpi = std::sqrt(A / sigma) * std::sqrt(sin2);
+
+    // Scale the local photon energy so that the conserved energy E = -p_t is 1
+    double local_energy = 1.0 / (lapse + omega * varpi * n_phi);
+
+    y[0] = r;
+    y[1] = theta;
+    y[2] = phi;
+    y[3] = local_energy * n_r * std::sqrt(sigma / delta);
+    y[4] = local_energy * n_theta * std::sqrt(sigma);
+
+    L = local_energy * n_phi * varpi;
+    Q = y[4] * y[4] + cos_theta * cos_theta * (L * L / sin2 - a * a);
+}
+
+Eigen::Vector3d GeodesicIntegrator::to_world_position(const State& y) const {
+    double rho = std::sqrt(y[0] * y[0] + spin_ * spin_);
+    double sin_theta = std::sin(y[1]);
+    Eigen::Vector3d p(rho * sin_theta * std::cos(y[2]),
+                      rho * sin_theta * std::sin(y[2]),
+                      y[0] * std::cos(y[1]));
+    return center_ + bl_to_world(p) * gravitational_radius_;
+}
+
+Eigen::Vector3d GeodesicIntegrator::to_world_direction(const State& y, const State& dy) const {
+    double r = y[0];
+    double rho = std::sqrt(r * r + spin_ * spin_);
+    double sin_theta = std::sin(y[1]);
+    double cos_theta = std::cos(y[1]);
+    double sin_phi = std::sin(y[2]);
+    double cos_phi = std::cos(y[2]);
+
+    double drho = r / rho * dy[0];
+    Eigen::Vector3d v(
+        drho * sin_theta * cos_phi + rho * cos_theta * cos_phi * dy[1] - rho * sin_theta * sin_phi * dy[2],
+        drho * sin_theta * sin_phi + rho * cos_theta * sin_phi * dy[1] + rho * sin_theta * cos_phi * dy[2],
+        dy[0] * cos_theta - r * sin_theta * dy[1]);
+    return bl_to_world(v).normalized();
+}
+
+GeodesicResult GeodesicIntegrator::trace(const GeodesicRay& ray) const {
+    GeodesicResult result;
+
+    State y, k1, k2, k3, k4, k5, k6, k7, y_new, error;
+    double L, Q;
+    initial_state(ray, y, L, Q);
+    result.angular_momentum = L;
+
+    const double escape_radius = std::max(settings_.escape_radius, 1.01 * y[0]);
+    const double horizon_stop = horizon_radius_ * (1.0 + settings_.horizon_epsilon);
+
+    if (y[0] <= horizon_stop) {
+        result.termination = GeodesicTermination::Horizon;
+        result.position = ray.origin;
+        result.direction = ray.direction.normalized();
+        return result;
+    }
+
+    derivatives(y, L, Q, k1);
+    double h = settings_.initial_step;
+
+    while (result.steps < settings_.max_steps) {
+        h = std::min(h, settings_.max_step_fraction * y[0]);
+        if (h < settings_.min_step) break;
+
+        State tmp;
+        tmp = y + h * a21 * k1;
+        derivatives(tmp, L, Q, k2);
+        tmp = y + h * (a31 * k1 + a32 * k2);
+        derivatives(tmp, L, Q, k3);
+        tmp = y + h * (a41 * k1 + a42 * k2 + a43 * k3);
+        derivatives(tmp, L, Q, k4);
+        tmp = y + h * (a51 * k1 + a52 * k2 + a53 * k3 + a54 * k4);
+        derivatives(tmp, L, Q, k5);
+        tmp = y + h * (a61 * k1 + a62 * k2 + a63 * k3 + a64 * k4 + a65 * k5);
+        derivatives(tmp, L, Q, k6);
+        y_new = y + h * (b1 * k1 + b3 * k3 + b4 * k4 + b5 * k5 + b6 * k6);
+        derivatives(y_new, L, Q, k7);
+        error = h * (e1 * k1 + e3 * k3 + e4 * k4 + e5 * k5 + e6 * k6 + e7 * k7);
+
+        // Scaled RMS error norm
+        double err = 0.0;
+        for (int i = 0; i < kStateSize; ++i) {
+            double scale = settings_.absolute_tolerance +
+                           settings_.relative_tolerance * std::max(std::abs(y[i]), std::abs(y_new[i]));
+            double e = error[i] / scale;
+            err += e * e;
+        }
+        err = std::sqrt(err / kStateSize);
+
+        if (!std::isfinite(err) || err > 1.0) {
+            ++result.rejected_steps;
+            double factor = std::isfinite(err) ? 0.9 * std::pow(err, -0.2) : 0.2;
+            h *= std::max(0.2, factor);
+            continue;
+        }
+
+        ++result.steps;
+
+        // Events: equatorial crossing (z = r cos(theta) changes sign), horizon and
+        // escape radius. Each is bracketed by the step and located on the dense
+        // output, so steps stay large while hits land on the event surface.
+        double z0 = y[0] * std::cos(y[1]);
+        double z1 = y_new[0] * std::cos(y_new[1]);
+        bool crossing = (z0 > 0.0) != (z1 > 0.0);
+        bool horizon = y_new[0] <= horizon_stop;
+        bool escape = y_new[0] >= escape_radius && k7[0] > 0.0;
+
+        if (crossing || horizon || escape) {
+            DenseStep dense(y, y_new, h, k1, k3, k4, k5, k6, k7);
+            const double tolerance = settings_.event_tolerance / h;
+            // Halvings a re-stepping search would need for the same precision
+            const int saved = std::max(0, static_cast<int>(std::ceil(std::log2(h / settings_.event_tolerance))));
+
+            double t_event = 2.0;
+            GeodesicTermination event = GeodesicTermination::MaxSteps;
+
+            if (horizon || escape) {
+                double target = horizon ? horizon_stop : escape_radius;
+                t_event = locate_root([&](double t) { return dense.value(0, t) - target; },
+                                      y[0] - target, y_new[0] - target, tolerance);
+                event = horizon ? GeodesicTermination::Horizon : GeodesicTermination::Escaped;
+                result.event_steps_saved += saved;
+            }
+
+            if (crossing) {
+                double t = locate_root([&](double t) { return dense.value(0, t) * std::cos(dense.value(1, t)); },
+                                       z0, z1, tolerance);
+                if (t <= t_event) {
+                    ++result.disk_crossings;
+                    result.event_steps_saved += saved;
+                    double r = dense.value(0, t);
+                    if (r >= disk_inner_radius_ && r <= disk_outer_radius_) {
+                        t_event = t;
+                        event = GeodesicTermination::Disk;
+                    }
+                }
+            }
+
+            if (t_event <= 1.0) {
+                State y_event = dense.value(t_event);
+                State dy_event;
+                derivatives(y_event, L, Q, dy_event);
+
+                result.termination = event;
+                if (event == GeodesicTermination::Disk) {
+                    result.disk_radius = y_event[0];
+                }
+                result.position = to_world_position(y_event);
+                result.direction = to_world_direction(y_event, dy_event);
+                return result;
+            }
+        }
+
+        y = y_new;
+        k1 = k7;
+
+        double factor = err > 0.0 ? 0.9 * std::pow(err, -0.2) : 5.0;
+        h *= std::clamp(factor, 0.2, 5.0);
+    }
+
+    result.termination = GeodesicTermination::MaxSteps;
+    result.position = to_world_position(y);
+    result.direction = to_world_direction(y, k1);
+    return result;
+}
+
+void GeodesicIntegrator::trace(const GeodesicRay* rays, GeodesicResult* results,
+                               std::size_t count) const {
+    if (settings_.use_simd_packets && detect_simd_isa() != SimdIsa::Scalar) {
+        GeodesicPacketTracer(*this).trace(rays, results, count);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        results[i] = trace(rays[i]);
+    }
+}
+
+void GeodesicIntegrator::trace(const std::vector<GeodesicRay>& rays,
+                               std::vector<GeodesicResult>& results) const {
+    results.resize(rays.size());
+    trace(rays.data(), results.data(), rays.size());
+}
@@ -0,0 +1,136 @@
+#ifndef GEODESICINTEGRATOR_H
+#define GEODESICINTEGRATOR_H
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <vector>
+
+struct BlackHoleParameters;
+
+// How a traced photon left the integration domain
+enum class GeodesicTermination {
+    Escaped,   // Reached the escape radius moving outward
+    Horizon,   // Fell through the outer event horizon
+    Disk,      // Hit the accretion disk in the equatorial plane
+    MaxSteps   // Ran out of steps (or the step size collapsed)
+};
+
+struct GeodesicRay {
+    Eigen::Vector3d origin;     // World space, same units as BlackHoleParameters::position
+    Eigen::Vector3d direction;  // World space, need not be normalized
+};
+
+struct GeodesicResult {
+    GeodesicTermination termination;
+    Eigen::Vector3d position;   // Final position in world space
+    Eigen::Vector3d direction;  // Final propagation direction in world space
+    double disk_radius;         // Boyer-Lindquist radius of the disk hit, in gravitational radii
+    int disk_crossings;         // Number of equatorial plane crossings along the path
+    int steps;                  // Accepted Runge-Kutta steps
+    int rejected_steps;         // Steps rejected by the error controller
+    double winding_number;      // Angle swept around the hole over 2 pi (closed-form tracer only)
+    int event_steps_saved;      // Steps a step-halving search would have spent locating the events
+    double angular_momentum;    // Conserved L about the spin axis, with E = 1
+
+    GeodesicResult() :
+        termination(GeodesicTermination::MaxSteps),
+        position(Eigen::Vector3d::Zero()),
+        direction(Eigen::Vector3d::Zero()),
+        disk_radius(0.0),
+        disk_crossings(0),
+        steps(0),
+        rejected_steps(0),
+        winding_number(0.0),
+        event_steps_saved(0),
+        angular_momentum(0.0) {}
+};
+
+struct GeodesicSettings {
+    double relative_tolerance;
+    double absolute_tolerance;
+    double initial_step;        // Affine parameter, gravitational radii
+    double min_step;            // Integration stops when the controller asks for less
+    double max_step_fraction;   // Upper bound on a step as a fraction of the current radius
+    double escape_radius;       // Gravitational radii
+    double horizon_epsilon;     // Stop at r_+ * (1 + horizon_epsilon)
+    double event_tolerance;     // Affine parameter precision of disk, horizon and escape hits
+    int max_steps;
+    bool use_simd_packets;      // Batches go through the widest available packet kernel
+    bool use_closed_form;       // BlackHole traces non-rotating holes with SchwarzschildTracer
+    bool mixed_precision;       // Packet kernels integrate in float outside promotion_radius
+    double promotion_radius;    // Gravitational radii; rays switch to double inside it
+    double float_tolerance;     // Relative and absolute tolerance of the float phase
+
+    GeodesicSettings() :
+        relative_tolerance(1e-6),
+        absolute_tolerance(1e-9),
+        initial_step(1.0),
+        min_step(1e-8),
+        max_step_fraction(0.5),
+        escape_radius(1000.0),
+        horizon_epsilon(1e-2),
+        event_tolerance(1e-10),
+        max_steps(20000),
+        use_simd_packets(true),
+        use_closed_form(true),
+        mixed_precision(false),
+        promotion_radius(12.0),
+        float_tolerance(1e-5) {}
+};
+
+// Null geodesic tracer for the Kerr metric in Boyer-Lindquist coordinates.
+//
+// Works in geometric units (G = c = M = 1) and integrates the Hamiltonian form
+// of the geodesic equations for the state (r, theta, phi, p_r, p_theta) with the
+// conserved energy E, axial angular momentum L and Carter constant Q. Steps are
+// taken with an embedded Dormand-Prince 5(4) pair and adaptive step control.
+// Disk-plane, horizon and escape crossings are located as roots of event
+// functions on the pair's dense output instead of by shrinking the step.
+// The spin axis is the world y axis, so the accretion disk lies in the y = 0 plane.
+class GeodesicIntegrator {
+public:
+    static constexpr int kStateSize = 5;
+    using State = Eigen::Matrix<double, kStateSize, 1>;
+
+    explicit GeodesicIntegrator(const BlackHoleParameters& params,
+                                const GeodesicSettings& settings = GeodesicSettings());
+
+    // Trace a batch of rays; results must have room for count entries
+    void trace(const GeodesicRay* rays, GeodesicResult* results, std::size_t count) const;
+    void trace(const std::vector<GeodesicRay>& rays, std::vector<GeodesicResult>& results) const;
+    GeodesicResult trace(const GeodesicRay& ray) const;
+
+    // Metric component g_tt at Boyer-Lindquist (r, theta)
+    double metric_tt(double r, double theta) const;
+
+    // Covariant momentum derivative dp/dlambda for position (t, r, theta, phi)
+    // and covariant momentum (p_t, p_r, p_theta, p_phi)
+    Eigen::Vector4d momentum_derivative(const Eigen::Vector4d& position,
+                                        const Eigen::Vector4d& momentum) const;
+
+    double get_spin() const { return spin_; }
+    double get_horizon_radius() const { return horizon_radius_; }
+    double get_disk_inner_radius() const { return disk_inner_radius_; }
+    double get_disk_outer_radius() const { return disk_outer_radius_; }
+    double get_gravitational_radius() const { return gravitational_radius_; }
+    const GeodesicSettings& get_settings() const { return settings_; }
+
+    // Conversion between world space and Boyer-Lindquist coordinates
+    void initial_state(const GeodesicRay& ray, State& y, double& L, double& Q) const;
+    Eigen::Vector3d to_world_position(const State& y) const;
+    Eigen::Vector3d to_world_direction(const State& y, const State& dy) const;
+
+private:
+    GeodesicSettings settings_;
+    Eigen::Vector3d center_;
+    double gravitational_radius_;  // GM/c^2 in world units
+    double spin_;                  // a/M
+    double horizon_radius_;        // r_+ in gravitational radii
+    double disk_inner_radius_;     // Gravitational radii
+    double disk_outer_radius_;
+
+    // Right-hand side of the geodesic equations for E = 1
+    void derivatives(const State& y, double L, double Q, State& dy) const;
+};
+
+#endif
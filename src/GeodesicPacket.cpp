@@ -0,0 +1,248 @@
+#include "GeodesicPacket.h"
+#include "GeodesicPacketKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Kernel termination code of a lane that crossed the promotion radius
+const int kPromotedTermination = 4;
+
+}
+
+SimdIsa detect_simd_isa() {
+#if defined(BLACKHOLE_SIMD_KERNELS) && (defined(__GNUC__) || defined(__clang__))
+    static const SimdIsa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) return SimdIsa::Avx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdIsa::Avx2;
+        if (__builtin_cpu_supports("sse2")) return SimdIsa::Sse2;
+        return SimdIsa::Scalar;
+    }();
+    return isa;
+#else
+    return SimdIsa::Scalar;
+#endif
+}
+
+const char* get_simd_isa_name(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::Sse2: return "SSE2";
+        case SimdIsa::Avx2: return "AVX2";
+        case SimdIsa::Avx512: return "AVX-512";
+        default: return "scalar";
+    }
+}
+
+int get_simd_packet_width(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::Sse2: return 4;
+        case SimdIsa::Avx2: return 8;
+        case SimdIsa::Avx512: return 16;
+        default: return 1;
+    }
+}
+
+GeodesicPacketTracer::GeodesicPacketTracer(const GeodesicIntegrator& integrator, SimdIsa isa)
+    : integrator_(integrator), isa_(isa) {
+    // Never run a kernel the CPU or the build cannot handle
+    if (static_cast<int>(isa_) > static_cast<int>(detect_simd_isa())) {
+        isa_ = detect_simd_isa();
+    }
+}
+
+void GeodesicPacketTracer::trace(const GeodesicRay* rays, GeodesicResult* results,
+                                 std::size_t count) const {
+    PacketKernelFunction kernel = nullptr;
+    PacketKernelFunction float_kernel = nullptr;
+#ifdef BLACKHOLE_SIMD_KERNELS
+    switch (isa_) {
+        case SimdIsa::Sse2:
+            kernel = trace_packets_sse2;
+            float_kernel = trace_packets_sse2_float;
+            break;
+        case SimdIsa::Avx2:
+            kernel = trace_packets_avx2;
+            float_kernel = trace_packets_avx2_float;
+            break;
+        case SimdIsa::Avx512:
+            kernel = trace_packets_avx512;
+            float_kernel = trace_packets_avx512_float;
+            break;
+        default: break;
+    }
+#endif
+    if (!kernel) {
+        for (std::size_t i = 0; i < count; ++i) {
+            results[i] = integrator_.trace(rays[i]);
+        }
+        return;
+    }
+
+    const GeodesicSettings& settings = integrator_.get_settings();
+
+    PacketKernelParams params;
+    params.spin = integrator_.get_spin();
+    params.horizon_stop = integrator_.get_horizon_radius() * (1.0 + settings.horizon_epsilon);
+    params.disk_inner_radius = integrator_.get_disk_inner_radius();
+    params.disk_outer_radius = integrator_.get_disk_outer_radius();
+    params.relative_tolerance = settings.relative_tolerance;
+    params.absolute_tolerance = settings.absolute_tolerance;
+    params.initial_step = settings.initial_step;
+    params.min_step = settings.min_step;
+    params.max_step_fraction = settings.max_step_fraction;
+    params.event_tolerance = settings.event_tolerance;
+    params.promotion_radius = 0.0;
+    params.max_steps = settings.max_steps;
+
+    const bool mixed = settings.mixed_precision && float_kernel;
+
+    // Structure-of-arrays scratch, one column per field
+    std::vector<double> columns(count * 15);
+    std::vector<int> counters(count * 5);
+    auto column = [&](int i) { return columns.data() + count * i; };
+    auto counter = [&](int i) { return counters.data() + count * i; };
+
+    PacketRayData data;
+    data.r = column(0);
+    data.sin_theta = column(1);
+    data.cos_theta = column(2);
+    data.phi = column(3);
+    data.p_r = column(4);
+    data.p_theta = column(5);
+    double* L = column(6);
+    double* Q = column(7);
+    double* escape_radius = column(8);
+    data.L = L;
+    data.Q = Q;
+    data.escape_radius = escape_radius;
+    data.d_r = column(9);
+    data.d_theta = column(10);
+    data.d_phi = column(11);
+    data.disk_radius = column(12);
+    data.termination = counter(0);
+    data.steps = counter(1);
+    data.rejected_steps = counter(2);
+    data.disk_crossings = counter(3);
+    data.event_steps_saved = counter(4);
+
+    // Rays that start inside the horizon never enter the kernel. In mixed
+    // precision, rays starting outside the promotion radius take the first slots.
+    std::vector<std::size_t> kernel_rays;
+    std::vector<std::size_t> near_rays;
+    std::vector<GeodesicIntegrator::State> states(count);
+    std::vector<double> constants(count * 2);
+    kernel_rays.reserve(count);
+    const double horizon_stop = params.horizon_stop;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        integrator_.initial_state(rays[i], states[i], constants[2 * i], constants[2 * i + 1]);
+
+        if (states[i][0] <= horizon_stop) {
+            results[i] = GeodesicResult();
+            results[i].termination = GeodesicTermination::Horizon;
+            results[i].position = rays[i].origin;
+            results[i].direction = rays[i].direction.normalized();
+            results[i].angular_momentum = constants[2 * i];
+        } else if (mixed && states[i][0] <= settings.promotion_radius) {
+            near_rays.push_back(i);
+        } else {
+            kernel_rays.push_back(i);
+        }
+    }
+    const std::size_t far_count = mixed ? kernel_rays.size() : 0;
+    kernel_rays.insert(kernel_rays.end(), near_rays.begin(), near_rays.end());
+
+    for (std::size_t k = 0; k < kernel_rays.size(); ++k) {
+        std::size_t i = kernel_rays[k];
+        const GeodesicIntegrator::State& y = states[i];
+        data.r[k] = y[0];
+        data.sin_theta[k] = std::sin(y[1]);
+        data.cos_theta[k] = std::cos(y[1]);
+        data.phi[k] = y[2];
+        data.p_r[k] = y[3];
+        data.p_theta[k] = y[4];
+        L[k] = constants[2 * i];
+        Q[k] = constants[2 * i + 1];
+        escape_radius[k] = std::max(settings.escape_radius, 1.01 * y[0]);
+    }
+
+    // Slots from first onwards go through the double-precision kernel
+    std::size_t first = 0;
+    std::vector<int> float_counters;
+
+    if (far_count > 0) {
+        PacketKernelParams float_params = params;
+        float_params.relative_tolerance = std::max(settings.relative_tolerance, settings.float_tolerance);
+        float_params.absolute_tolerance = std::max(settings.absolute_tolerance, settings.float_tolerance);
+        float_params.promotion_radius = settings.promotion_radius;
+        float_kernel(float_params, data, far_count);
+
+        // Gather promoted rays next to the near ones
+        auto swap_slots = [&](std::size_t a, std::size_t b) {
+            for (int c = 0; c < 15; ++c) std::swap(column(c)[a], column(c)[b]);
+            for (int c = 0; c < 5; ++c) std::swap(counter(c)[a], counter(c)[b]);
+            std::swap(kernel_rays[a], kernel_rays[b]);
+        };
+        first = far_count;
+        for (std::size_t k = far_count; k-- > 0;) {
+            if (data.termination[k] == kPromotedTermination) {
+                swap_slots(k, --first);
+            }
+        }
+
+        // The double pass restarts the counters; keep the float ones
+        float_counters.assign(counter(1) + first, counter(1) + far_count);
+        float_counters.insert(float_counters.end(), counter(2) + first, counter(2) + far_count);
+        float_counters.insert(float_counters.end(), counter(3) + first, counter(3) + far_count);
+        float_counters.insert(float_counters.end(), counter(4) + first, counter(4) + far_count);
+    }
+
+    PacketRayData rest = data;
+    rest.r += first;
+    rest.sin_theta += first;
+    rest.cos_theta += first;
+    rest.phi += first;
+    rest.p_r += first;
+    rest.p_theta += first;
+    rest.L += first;
+    rest.Q += first;
+    rest.escape_radius += first;
+    rest.d_r += first;
+    rest.d_theta += first;
+    rest.d_phi += first;
+    rest.disk_radius += first;
+    rest.termination += first;
+    rest.steps += first;
+    rest.rejected_steps += first;
+    rest.disk_crossings += first;
+    rest.event_steps_saved += first;
+    kernel(params, rest, kernel_rays.size() - first);
+
+    const std::size_t promoted = far_count > first ? far_count - first : 0;
+    for (std::size_t k = 0; k < promoted; ++k) {
+        data.steps[first + k] += float_counters[k];
+        data.rejected_steps[first + k] += float_counters[promoted + k];
+        data.disk_crossings[first + k] += float_counters[2 * promoted + k];
+        data.event_steps_saved[first + k] += float_counters[3 * promoted + k];
+    }
+
+    for (std::size_t k = 0; k < kernel_rays.size(); ++k) {
+        GeodesicIntegrator::State y, dy;
+        y << data.r[k], std::atan2(data.sin_theta[k], data.cos_theta[k]), data.phi[k],
+             data.p_r[k], data.p_theta[k];
+        dy << data.d_r[k], data.d_theta[k], data.d_phi[k], 0.0, 0.0;
+
+        GeodesicResult& result = results[kernel_rays[k]];
+        result.termination = static_cast<GeodesicTermination>(data.termination[k]);
+        result.position = integrator_.to_world_position(y);
+        result.direction = integrator_.to_world_direction(y, dy);
+        result.disk_radius = data.disk_radius[k];
+        result.disk_crossings = data.disk_crossings[k];
+        result.event_steps_saved = data.event_steps_saved[k];
+        result.angular_momentum = data.L[k];
+        result.steps = data.steps[k];
+        result.rejected_steps = data.rejected_steps[k];
+    }
+}
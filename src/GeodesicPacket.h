@@ -0,0 +1,40 @@
+#ifndef GEODESICPACKET_H
+#define GEODESICPACKET_H
+
+#include "GeodesicIntegrator.h"
+#include <cstddef>
+
+// Instruction sets with a compiled packet kernel, widest last
+enum class SimdIsa {
+    Scalar,   // No packet kernel, one ray at a time through GeodesicIntegrator
+    Sse2,     // 4 rays per lane group
+    Avx2,     // 8 rays per lane group
+    Avx512    // 16 rays per lane group
+};
+
+// Widest instruction set supported by both this CPU and this build
+SimdIsa detect_simd_isa();
+const char* get_simd_isa_name(SimdIsa isa);
+int get_simd_packet_width(SimdIsa isa);
+
+// Traces rays in SIMD packets with the same Dormand-Prince scheme as
+// GeodesicIntegrator. Lanes whose ray terminates are refilled from the
+// remaining rays straight away, so packets stay full until the batch runs dry.
+// With GeodesicSettings::mixed_precision, rays first run through a float kernel
+// with twice the lanes and are handed to the double kernel once they come
+// within promotion_radius of the hole.
+class GeodesicPacketTracer {
+public:
+    explicit GeodesicPacketTracer(const GeodesicIntegrator& integrator,
+                                  SimdIsa isa = detect_simd_isa());
+
+    void trace(const GeodesicRay* rays, GeodesicResult* results, std::size_t count) const;
+
+    SimdIsa get_isa() const { return isa_; }
+
+private:
+    const GeodesicIntegrator& integrator_;
+    SimdIsa isa_;
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include <immintrin.h>
+
+namespace {
+
+struct IsaAvx2 {
+    using Scalar = double;
+    using Reg = __m256d;
+    using Mask = __m256d;
+    static constexpr int kWidth = 4;
+
+    static Reg set1(double x) { return _mm256_set1_pd(x); }
+    static Reg load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, Reg a) { _mm256_storeu_pd(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm256_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm256_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm256_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm256_div_pd(a, b); }
+    static Reg sqrt(Reg a) { return _mm256_sqrt_pd(a); }
+    static Reg abs(Reg a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static Reg min(Reg a, Reg b) { return _mm256_min_pd(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm256_max_pd(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static Mask mask_and(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+    static Mask mask_or(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+    static Mask mask_xor(Mask a, Mask b) { return _mm256_xor_pd(a, b); }
+    static Mask mask_not(Mask a) { return _mm256_xor_pd(a, _mm256_castsi256_pd(_mm256_set1_epi64x(-1))); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm256_blendv_pd(b, a, m); }
+    static int bits(Mask m) { return _mm256_movemask_pd(m); }
+};
+
+struct IsaAvx2Float {
+    using Scalar = float;
+    using Reg = __m256;
+    using Mask = __m256;
+    static constexpr int kWidth = 8;
+
+    static Reg set1(float x) { return _mm256_set1_ps(x); }
+    static Reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Reg a) { _mm256_storeu_ps(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm256_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm256_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm256_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm256_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm256_sqrt_ps(a); }
+    static Reg abs(Reg a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Reg min(Reg a, Reg b) { return _mm256_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm256_max_ps(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static Mask mask_and(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Mask mask_or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+    static Mask mask_xor(Mask a, Mask b) { return _mm256_xor_ps(a, b); }
+    static Mask mask_not(Mask a) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm256_blendv_ps(b, a, m); }
+    static int bits(Mask m) { return _mm256_movemask_ps(m); }
+};
+
+}
+
+#include "GeodesicPacketKernelImpl.h"
+
+void trace_packets_avx2(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaAvx2>(params, data, count);
+}
+
+void trace_packets_avx2_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaAvx2Float>(params, data, count);
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include <immintrin.h>
+
+namespace {
+
+struct IsaAvx512 {
+    using Scalar = double;
+    using Reg = __m512d;
+    using Mask = __mmask8;
+    static constexpr int kWidth = 8;
+
+    static Reg set1(double x) { return _mm512_set1_pd(x); }
+    static Reg load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, Reg a) { _mm512_storeu_pd(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm512_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm512_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm512_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm512_div_pd(a, b); }
+    static Reg sqrt(Reg a) { return _mm512_sqrt_pd(a); }
+    static Reg abs(Reg a) { return _mm512_abs_pd(a); }
+    static Reg min(Reg a, Reg b) { return _mm512_min_pd(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm512_max_pd(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+    static Mask mask_and(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+    static Mask mask_or(Mask a, Mask b) { return static_cast<Mask>(a | b); }
+    static Mask mask_xor(Mask a, Mask b) { return static_cast<Mask>(a ^ b); }
+    static Mask mask_not(Mask a) { return static_cast<Mask>(~a); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_pd(m, b, a); }
+    static int bits(Mask m) { return static_cast<int>(m); }
+};
+
+struct IsaAvx512Float {
+    using Scalar = float;
+    using Reg = __m512;
+    using Mask = __mmask16;
+    static constexpr int kWidth = 16;
+
+    static Reg set1(float x) { return _mm512_set1_ps(x); }
+    static Reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Reg a) { _mm512_storeu_ps(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm512_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm512_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm512_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm512_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm512_sqrt_ps(a); }
+    static Reg abs(Reg a) { return _mm512_abs_ps(a); }
+    static Reg min(Reg a, Reg b) { return _mm512_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm512_max_ps(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static Mask le(Reg a, Reg b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static Mask mask_and(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+    static Mask mask_or(Mask a, Mask b) { return static_cast<Mask>(a | b); }
+    static Mask mask_xor(Mask a, Mask b) { return static_cast<Mask>(a ^ b); }
+    static Mask mask_not(Mask a) { return static_cast<Mask>(~a); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm512_mask_blend_ps(m, b, a); }
+    static int bits(Mask m) { return static_cast<int>(m); }
+};
+
+}
+
+#include "GeodesicPacketKernelImpl.h"
+
+void trace_packets_avx512(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaAvx512>(params, data, count);
+}
+
+void trace_packets_avx512_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaAvx512Float>(params, data, count);
+}
+
+#endif
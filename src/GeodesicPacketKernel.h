@@ -0,0 +1,64 @@
+#ifndef GEODESICPACKETKERNEL_H
+#define GEODESICPACKETKERNEL_H
+
+#include <cstddef>
+
+// Plain-data interface between GeodesicPacketTracer and the per-ISA packet
+// kernels. The kernels are compiled with ISA-specific flags, so nothing here
+// may pull in inline or template code that the rest of the program also uses.
+
+struct PacketKernelParams {
+    double spin;
+    double horizon_stop;        // Gravitational radii
+    double disk_inner_radius;
+    double disk_outer_radius;
+    double relative_tolerance;
+    double absolute_tolerance;
+    double initial_step;
+    double min_step;
+    double max_step_fraction;
+    double event_tolerance;     // Affine parameter
+    double promotion_radius;    // Lanes inside it retire for a double-precision pass; 0 disables
+    int max_steps;
+};
+
+// Structure-of-arrays ray data, one entry per ray.
+// The state (r, sin theta, cos theta, phi, p_r, p_theta) is read on entry and
+// overwritten with the final state; d_* receive the coordinate velocities there.
+struct PacketRayData {
+    double* r;
+    double* sin_theta;
+    double* cos_theta;
+    double* phi;
+    double* p_r;
+    double* p_theta;
+    const double* L;
+    const double* Q;
+    const double* escape_radius;
+
+    double* d_r;
+    double* d_theta;
+    double* d_phi;
+    double* disk_radius;
+    int* termination;           // GeodesicTermination value, or 4 when promoted
+    int* steps;
+    int* rejected_steps;
+    int* disk_crossings;
+    int* event_steps_saved;
+};
+
+using PacketKernelFunction = void (*)(const PacketKernelParams& params, PacketRayData& data,
+                                      std::size_t count);
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+void trace_packets_sse2(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+void trace_packets_avx2(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+void trace_packets_avx512(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+
+// Single-precision lanes, twice as many per register
+void trace_packets_sse2_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+void trace_packets_avx2_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+void trace_packets_avx512_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count);
+#endif
+
+#endif
@@ -0,0 +1,537 @@
+// Packet geodesic kernel shared by the per-ISA translation units.
+//
+// Include only from a GeodesicPacket<Isa>.cpp file, after defining the Isa
+// primitive structs. An Isa works on either double or float lanes
+// (Isa::Scalar); the lane mirrors follow it while the ray data stays double.
+// Everything lives in an anonymous namespace so that code compiled with wider
+// instruction sets can never be picked by the linker for callers built with
+// baseline flags. Do not use Eigen or other header-only templates in here for
+// the same reason.
+
+#include "GeodesicPacketKernel.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace {
+
+// Two registers per lane group: more independent work per step to hide the
+// latency of the divisions in the right-hand side
+template <typename Isa>
+struct Lanes {
+    using Reg = typename Isa::Reg;
+    using Scalar = typename Isa::Scalar;
+    static constexpr int kWidth = 2 * Isa::kWidth;
+
+    Reg lo, hi;
+
+    static Lanes set1(double x) {
+        Scalar v = static_cast<Scalar>(x);
+        return Lanes{Isa::set1(v), Isa::set1(v)};
+    }
+    static Lanes load(const Scalar* p) { return Lanes{Isa::load(p), Isa::load(p + Isa::kWidth)}; }
+    void store(Scalar* p) const {
+        Isa::store(p, lo);
+        Isa::store(p + Isa::kWidth, hi);
+    }
+};
+
+template <typename Isa>
+struct LaneMask {
+    typename Isa::Mask lo, hi;
+
+    unsigned bits() const {
+        return static_cast<unsigned>(Isa::bits(lo)) | (static_cast<unsigned>(Isa::bits(hi)) << Isa::kWidth);
+    }
+};
+
+template <typename I> inline Lanes<I> operator+(Lanes<I> a, Lanes<I> b) { return {I::add(a.lo, b.lo), I::add(a.hi, b.hi)}; }
+template <typename I> inline Lanes<I> operator-(Lanes<I> a, Lanes<I> b) { return {I::sub(a.lo, b.lo), I::sub(a.hi, b.hi)}; }
+template <typename I> inline Lanes<I> operator*(Lanes<I> a, Lanes<I> b) { return {I::mul(a.lo, b.lo), I::mul(a.hi, b.hi)}; }
+template <typename I> inline Lanes<I> operator/(Lanes<I> a, Lanes<I> b) { return {I::div(a.lo, b.lo), I::div(a.hi, b.hi)}; }
+template <typename I> inline Lanes<I> operator*(double a, Lanes<I> b) { return Lanes<I>::set1(a) * b; }
+template <typename I> inline Lanes<I> operator*(Lanes<I> a, double b) { return a * Lanes<I>::set1(b); }
+template <typename I> inline Lanes<I> operator+(Lanes<I> a, double b) { return a + Lanes<I>::set1(b); }
+template <typename I> inline Lanes<I> operator-(Lanes<I> a, double b) { return a - Lanes<I>::set1(b); }
+
+template <typename I> inline Lanes<I> lanes_sqrt(Lanes<I> a) { return {I::sqrt(a.lo), I::sqrt(a.hi)}; }
+template <typename I> inline Lanes<I> lanes_abs(Lanes<I> a) { return {I::abs(a.lo), I::abs(a.hi)}; }
+template <typename I> inline Lanes<I> lanes_min(Lanes<I> a, Lanes<I> b) { return {I::min(a.lo, b.lo), I::min(a.hi, b.hi)}; }
+template <typename I> inline Lanes<I> lanes_max(Lanes<I> a, Lanes<I> b) { return {I::max(a.lo, b.lo), I::max(a.hi, b.hi)}; }
+
+template <typename I> inline LaneMask<I> operator<(Lanes<I> a, Lanes<I> b) { return {I::lt(a.lo, b.lo), I::lt(a.hi, b.hi)}; }
+template <typename I> inline LaneMask<I> operator<=(Lanes<I> a, Lanes<I> b) { return {I::le(a.lo, b.lo), I::le(a.hi, b.hi)}; }
+template <typename I> inline LaneMask<I> operator>(Lanes<I> a, Lanes<I> b) { return b < a; }
+template <typename I> inline LaneMask<I> operator>=(Lanes<I> a, Lanes<I> b) { return b <= a; }
+template <typename I> inline LaneMask<I> operator&(LaneMask<I> a, LaneMask<I> b) { return {I::mask_and(a.lo, b.lo), I::mask_and(a.hi, b.hi)}; }
+template <typename I> inline LaneMask<I> operator|(LaneMask<I> a, LaneMask<I> b) { return {I::mask_or(a.lo, b.lo), I::mask_or(a.hi, b.hi)}; }
+template <typename I> inline LaneMask<I> operator^(LaneMask<I> a, LaneMask<I> b) { return {I::mask_xor(a.lo, b.lo), I::mask_xor(a.hi, b.hi)}; }
+template <typename I> inline LaneMask<I> operator~(LaneMask<I> a) { return {I::mask_not(a.lo), I::mask_not(a.hi)}; }
+
+// m ? a : b per lane
+template <typename I> inline Lanes<I> select(LaneMask<I> m, Lanes<I> a, Lanes<I> b) {
+    return {I::select(m.lo, a.lo, b.lo), I::select(m.hi, a.hi, b.hi)};
+}
+
+// Dormand-Prince 5(4) tableau
+const double a21 = 1.0 / 5.0;
+const double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+const double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+const double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0, a53 = 64448.0 / 6561.0,
+             a54 = -212.0 / 729.0;
+const double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0,
+             a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+const double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0,
+             b5 = -2187.0 / 6784.0, b6 = 11.0 / 84.0;
+const double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0,
+             e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+// Dense output coefficients (Hairer's fourth-order continuous extension)
+const double d1 = -12715105075.0 / 11282082432.0, d3 = 87487479700.0 / 32700410799.0,
+             d4 = -10690763975.0 / 1880347072.0, d5 = 701980252875.0 / 199316789632.0,
+             d6 = -1453857185.0 / 822651844.0, d7 = 69997945.0 / 29380423.0;
+
+// Termination codes, matching GeodesicTermination
+const int kEscaped = 0;
+const int kHorizon = 1;
+const int kDisk = 2;
+const int kMaxSteps = 3;
+const int kPromote = 4;     // Crossed PacketKernelParams::promotion_radius
+
+// State layout: r, sin(theta), cos(theta), phi, p_r, p_theta. Carrying sin and
+// cos of theta instead of theta keeps transcendental functions out of the
+// right-hand side, so every stage is plain vector arithmetic.
+const int kState = 6;
+
+// Continuous extension of one lane's accepted step, t in [0, 1]
+struct LaneDenseStep {
+    double c[5][kState];
+
+    double value(int i, double t) const {
+        double s = 1.0 - t;
+        return c[0][i] + t * (c[1][i] + s * (c[2][i] + t * (c[3][i] + s * c[4][i])));
+    }
+};
+
+// Root of g on [0, 1] given end values of opposite sign (Illinois regula falsi)
+template <typename F>
+double locate_root(F g, double g0, double g1, double tolerance) {
+    if ((g0 > 0.0) == (g1 > 0.0)) return 1.0;
+
+    double a = 0.0, b = 1.0, ga = g0, gb = g1;
+    double t = -1.0;
+    int side = 0;
+    for (int i = 0; i < 64; ++i) {
+        double t_new = (a * gb - b * ga) / (gb - ga);
+        if (t_new - t < tolerance && t - t_new < tolerance) return t_new;
+        t = t_new;
+
+        double gt = g(t);
+        if (gt == 0.0) return t;
+        if ((gt > 0.0) == (gb > 0.0)) {
+            b = t;
+            gb = gt;
+            if (side == -1) ga *= 0.5;
+            side = -1;
+        } else {
+            a = t;
+            ga = gt;
+            if (side == 1) gb *= 0.5;
+            side = 1;
+        }
+    }
+    return t;
+}
+
+// Halvings a re-stepping search needs to shrink h below the tolerance
+inline int halvings(double h, double tolerance) {
+    int n = 0;
+    while (h > tolerance && n < 64) {
+        h *= 0.5;
+        ++n;
+    }
+    return n;
+}
+
+template <typename Isa>
+class PacketKernel {
+public:
+    using V = Lanes<Isa>;
+    using M = LaneMask<Isa>;
+    using T = typename Isa::Scalar;
+    static constexpr int W = V::kWidth;
+
+    PacketKernel(const PacketKernelParams& params, PacketRayData& data, std::size_t count)
+        : p_(params), data_(data), count_(count), next_(0) {}
+
+    void run() {
+        for (int lane = 0; lane < W; ++lane) {
+            assign_lane(lane);
+        }
+        load_lanes();
+        derivatives(y_, L_, Q_, k1_);
+
+        V k2[kState], k3[kState], k4[kState], k5[kState], k6[kState], k7[kState];
+        V yn[kState], tmp[kState];
+
+        const V max_fraction = V::set1(p_.max_step_fraction);
+        const V atol = V::set1(p_.absolute_tolerance);
+        const V rtol = V::set1(p_.relative_tolerance);
+        const V one = V::set1(1.0);
+        const V zero = V::set1(0.0);
+        const V horizon_stop = V::set1(p_.horizon_stop);
+        const V max_steps = V::set1(static_cast<double>(p_.max_steps));
+        const V min_step = V::set1(p_.min_step);
+        const V promotion_radius = V::set1(p_.promotion_radius);
+        const V largest = V::set1(std::numeric_limits<T>::max());
+
+        while (true) {
+            M active = active_ > zero;
+            if (active.bits() == 0) break;
+
+            V h = lanes_min(h_, max_fraction * y_[0]);
+
+            for (int i = 0; i < kState; ++i) tmp[i] = y_[i] + (h * a21) * k1_[i];
+            derivatives(tmp, L_, Q_, k2);
+            for (int i = 0; i < kState; ++i) tmp[i] = y_[i] + h * (a31 * k1_[i] + a32 * k2[i]);
+            derivatives(tmp, L_, Q_, k3);
+            for (int i = 0; i < kState; ++i)
+                tmp[i] = y_[i] + h * (a41 * k1_[i] + a42 * k2[i] + a43 * k3[i]);
+            derivatives(tmp, L_, Q_, k4);
+            for (int i = 0; i < kState; ++i)
+                tmp[i] = y_[i] + h * (a51 * k1_[i] + a52 * k2[i] + a53 * k3[i] + a54 * k4[i]);
+            derivatives(tmp, L_, Q_, k5);
+            for (int i = 0; i < kState; ++i)
+                tmp[i] = y_[i] + h * (a61 * k1_[i] + a62 * k2[i] + a63 * k3[i] + a64 * k4[i] + a65 * k5[i]);
+            derivatives(tmp, L_, Q_, k6);
+            for (int i = 0; i < kState; ++i)
+                yn[i] = y_[i] + h * (b1 * k1_[i] + b3 * k3[i] + b4 * k4[i] + b5 * k5[i] + b6 * k6[i]);
+            derivatives(yn, L_, Q_, k7);
+
+            // Scaled RMS error norm
+            V err = V::set1(0.0);
+            for (int i = 0; i < kState; ++i) {
+                V e = h * (e1 * k1_[i] + e3 * k3[i] + e4 * k4[i] + e5 * k5[i] + e6 * k6[i] + e7 * k7[i]);
+                V scale = atol + rtol * lanes_max(lanes_abs(y_[i]), lanes_abs(yn[i]));
+                V q = e / scale;
+                err = err + q * q;
+            }
+            err = lanes_sqrt(err * (1.0 / kState));
+
+            M finite = (err <= largest);
+            M accept = active & (err <= one);
+            M reject = active & ~accept;
+
+            // Equatorial, horizon and escape crossings of accepted steps are rare;
+            // locate them per lane on the dense output of the step
+            V z0 = y_[0] * y_[2];
+            V z1 = yn[0] * yn[2];
+            M crossing = accept & ((z0 > zero) ^ (z1 > zero));
+            M horizon = accept & (yn[0] <= horizon_stop);
+            M escape = accept & (yn[0] >= escape_radius_) & (k7[0] > zero);
+            unsigned crossing_bits = crossing.bits();
+            unsigned horizon_bits = horizon.bits();
+            unsigned escape_bits = escape.bits();
+            unsigned hit_bits = 0;
+            if ((crossing_bits | horizon_bits | escape_bits) != 0) {
+                const V* k[] = {k1_, k3, k4, k5, k6, k7};
+                hit_bits = locate_events(crossing_bits, horizon_bits, escape_bits, h, yn, k);
+            }
+
+            for (int i = 0; i < kState; ++i) {
+                y_[i] = select(accept, yn[i], y_[i]);
+                k1_[i] = select(accept, k7[i], k1_[i]);
+            }
+            V norm = lanes_sqrt(y_[1] * y_[1] + y_[2] * y_[2]);
+            y_[1] = y_[1] / norm;
+            y_[2] = y_[2] / norm;
+
+            steps_ = steps_ + select(accept, one, zero);
+            rejected_ = rejected_ + select(reject, one, zero);
+
+            // Step factor 0.9 * err^(-3/16): close to the usual err^(-1/5) but only
+            // needs square roots, which keeps the controller in vector registers
+            V e = select(finite, lanes_max(err, V::set1(1e-10)), V::set1(1e10));
+            V s4 = lanes_sqrt(lanes_sqrt(e));
+            V s8 = lanes_sqrt(s4);
+            V s16 = lanes_sqrt(s8);
+            V factor = V::set1(0.9) / (s8 * s16);
+            factor = lanes_min(lanes_max(factor, V::set1(0.2)), V::set1(5.0));
+            h_ = h * factor;
+
+            M limit = active & ((steps_ >= max_steps) | (h_ < min_step));
+            M promote = active & (y_[0] <= promotion_radius);
+            unsigned promote_bits = promote.bits();
+            unsigned event_bits = limit.bits() | promote_bits | hit_bits;
+
+            if (event_bits != 0) {
+                finish_lanes(event_bits, hit_bits, promote_bits);
+            }
+        }
+    }
+
+private:
+    const PacketKernelParams& p_;
+    PacketRayData& data_;
+    std::size_t count_;
+    std::size_t next_;
+
+    V y_[kState], k1_[kState];
+    V L_, Q_, escape_radius_, h_, steps_, rejected_, active_;
+
+    // Per-lane mirrors used when lanes are retired and refilled
+    alignas(64) T lane_y_[kState][W];
+    alignas(64) T lane_k_[kState][W];
+    alignas(64) T lane_L_[W], lane_Q_[W], lane_escape_[W], lane_h_[W];
+    alignas(64) T lane_steps_[W], lane_rejected_[W], lane_active_[W], lane_fresh_[W];
+    std::size_t lane_ray_[W];
+    int lane_crossings_[W];
+    int lane_saved_[W];
+
+    // Events found this step: state and velocity on the event surface per lane
+    alignas(64) T hit_y_[kState][W];
+    alignas(64) T hit_k_[kState][W];
+    int hit_termination_[W];
+
+    void derivatives(const V* y, V L, V Q, V* dy) const {
+        const V a = V::set1(p_.spin);
+        const V a2 = V::set1(p_.spin * p_.spin);
+
+        V r = y[0];
+        V s = y[1];
+        V c = y[2];
+        V p_r = y[4];
+        V p_theta = y[5];
+
+        V sin2 = lanes_max(s * s, V::set1(1e-12));
+        V inv_sin2 = V::set1(1.0) / sin2;
+        V r2 = r * r;
+        V inv_sigma = V::set1(1.0) / (r2 + a2 * c * c);
+        V delta = r2 - 2.0 * r + a2;
+        V inv_delta = V::set1(1.0) / delta;
+        V delta_prime = 2.0 * r - 2.0;
+        V P = r2 + a2 - a * L;
+        V La = L - a;
+        V K = La * La + Q;
+        V R = P * P - delta * K;
+        V R_prime = 4.0 * r * P - delta_prime * K;
+
+        V theta_dot = p_theta * inv_sigma;
+        dy[0] = delta * p_r * inv_sigma;
+        dy[1] = c * theta_dot;
+        dy[2] = V::set1(0.0) - s * theta_dot;
+        dy[3] = (a * P * inv_delta + L * inv_sin2 - a) * inv_sigma;
+        dy[4] = (-0.5) * (delta_prime * p_r * p_r - R_prime * inv_delta +
+                          R * delta_prime * inv_delta * inv_delta) * inv_sigma;
+        dy[5] = c * s * (L * L * inv_sin2 * inv_sin2 - a2) * inv_sigma;
+    }
+
+    void assign_lane(int lane) {
+        lane_fresh_[lane] = 1.0;
+        if (next_ < count_) {
+            std::size_t i = next_++;
+            lane_ray_[lane] = i;
+            lane_y_[0][lane] = data_.r[i];
+            lane_y_[1][lane] = data_.sin_theta[i];
+            lane_y_[2][lane] = data_.cos_theta[i];
+            lane_y_[3][lane] = data_.phi[i];
+            lane_y_[4][lane] = data_.p_r[i];
+            lane_y_[5][lane] = data_.p_theta[i];
+            lane_L_[lane] = data_.L[i];
+            lane_Q_[lane] = data_.Q[i];
+            lane_escape_[lane] = data_.escape_radius[i];
+            lane_h_[lane] = p_.initial_step;
+            lane_active_[lane] = 1.0;
+        } else {
+            // Idle lane with a harmless state, masked out of every decision
+            lane_ray_[lane] = 0;
+            lane_y_[0][lane] = 1000.0;
+            lane_y_[1][lane] = 1.0;
+            lane_y_[2][lane] = 0.0;
+            lane_y_[3][lane] = 0.0;
+            lane_y_[4][lane] = 0.0;
+            lane_y_[5][lane] = 0.0;
+            lane_L_[lane] = 0.0;
+            lane_Q_[lane] = 0.0;
+            lane_escape_[lane] = 1e300;
+            lane_h_[lane] = 1.0;
+            lane_active_[lane] = 0.0;
+        }
+        lane_steps_[lane] = 0.0;
+        lane_rejected_[lane] = 0.0;
+        lane_crossings_[lane] = 0;
+        lane_saved_[lane] = 0;
+    }
+
+    void load_lanes() {
+        for (int i = 0; i < kState; ++i) y_[i] = V::load(lane_y_[i]);
+        L_ = V::load(lane_L_);
+        Q_ = V::load(lane_Q_);
+        escape_radius_ = V::load(lane_escape_);
+        h_ = V::load(lane_h_);
+        steps_ = V::load(lane_steps_);
+        rejected_ = V::load(lane_rejected_);
+        active_ = V::load(lane_active_);
+    }
+
+    void store_lanes() {
+        for (int i = 0; i < kState; ++i) {
+            y_[i].store(lane_y_[i]);
+            k1_[i].store(lane_k_[i]);
+        }
+        h_.store(lane_h_);
+        steps_.store(lane_steps_);
+        rejected_.store(lane_rejected_);
+    }
+
+    // Returns the lanes that terminate inside this step. k holds the stages
+    // k1, k3, k4, k5, k6 and k7 of the step.
+    unsigned locate_events(unsigned crossing_bits, unsigned horizon_bits, unsigned escape_bits, V h, const V* yn,
+                      const V* const* k) {
+        alignas(64) T y0[kState][W], y1[kState][W], kd[6][kState][W], step[W];
+        for (int i = 0; i < kState; ++i) {
+            y_[i].store(y0[i]);
+            yn[i].store(y1[i]);
+            for (int j = 0; j < 6; ++j) k[j][i].store(kd[j][i]);
+        }
+        h.store(step);
+
+        const double d[] = {d1, d3, d4, d5, d6, d7};
+        unsigned hit_bits = 0;
+        for (int lane = 0; lane < W; ++lane) {
+            unsigned bit = 1u << lane;
+            if (!((crossing_bits | horizon_bits | escape_bits) & bit)) {
+                // Keep idle hit slots finite for the vector derivative pass below
+                for (int i = 0; i < kState; ++i) hit_y_[i][lane] = y0[i][lane];
+                continue;
+            }
+
+            double hl = step[lane];
+            LaneDenseStep dense;
+            for (int i = 0; i < kState; ++i) {
+                double dy = y1[i][lane] - y0[i][lane];
+                double rest = 0.0;
+                for (int j = 0; j < 6; ++j) rest += d[j] * kd[j][i][lane];
+                dense.c[0][i] = y0[i][lane];
+                dense.c[1][i] = dy;
+                dense.c[2][i] = hl * kd[0][i][lane] - dy;
+                dense.c[3][i] = dy - hl * kd[5][i][lane] - dense.c[2][i];
+                dense.c[4][i] = hl * rest;
+            }
+
+            const double tolerance = p_.event_tolerance / hl;
+            const int saved = halvings(hl, p_.event_tolerance);
+            double t_event = 2.0;
+            int termination = kMaxSteps;
+
+            if ((horizon_bits | escape_bits) & bit) {
+                double target = (horizon_bits & bit) ? p_.horizon_stop : lane_escape_[lane];
+                t_event = locate_root([&](double t) { return dense.value(0, t) - target; },
+                                      y0[0][lane] - target, y1[0][lane] - target, tolerance);
+                termination = (horizon_bits & bit) ? kHorizon : kEscaped;
+                lane_saved_[lane] += saved;
+            }
+
+            if (crossing_bits & bit) {
+                double t = locate_root([&](double t) { return dense.value(0, t) * dense.value(2, t); },
+                                       y0[0][lane] * y0[2][lane], y1[0][lane] * y1[2][lane], tolerance);
+                if (t <= t_event) {
+                    ++lane_crossings_[lane];
+                    lane_saved_[lane] += saved;
+                    double r = dense.value(0, t);
+                    if (r >= p_.disk_inner_radius && r <= p_.disk_outer_radius) {
+                        t_event = t;
+                        termination = kDisk;
+                    }
+                }
+            }
+
+            if (t_event <= 1.0) {
+                hit_bits |= bit;
+                hit_termination_[lane] = termination;
+                double s = dense.value(1, t_event);
+                double c = dense.value(2, t_event);
+                double norm = std::sqrt(s * s + c * c);
+                for (int i = 0; i < kState; ++i) hit_y_[i][lane] = static_cast<T>(dense.value(i, t_event));
+                hit_y_[1][lane] = static_cast<T>(s / norm);
+                hit_y_[2][lane] = static_cast<T>(c / norm);
+            } else {
+                for (int i = 0; i < kState; ++i) hit_y_[i][lane] = y0[i][lane];
+            }
+        }
+
+        if (hit_bits != 0) {
+            V yh[kState], kh[kState];
+            for (int i = 0; i < kState; ++i) yh[i] = V::load(hit_y_[i]);
+            derivatives(yh, L_, Q_, kh);
+            for (int i = 0; i < kState; ++i) kh[i].store(hit_k_[i]);
+        }
+        return hit_bits;
+    }
+
+    void write_result(int lane, int termination, const T* y, const T* k) {
+        std::size_t i = lane_ray_[lane];
+        data_.r[i] = y[0];
+        data_.sin_theta[i] = y[1];
+        data_.cos_theta[i] = y[2];
+        data_.phi[i] = y[3];
+        data_.p_r[i] = y[4];
+        data_.p_theta[i] = y[5];
+        data_.d_r[i] = k[0];
+        data_.d_theta[i] = y[2] * k[1] - y[1] * k[2];
+        data_.d_phi[i] = k[3];
+        data_.disk_radius[i] = termination == kDisk ? y[0] : 0.0;
+        data_.termination[i] = termination;
+        data_.steps[i] = static_cast<int>(lane_steps_[lane]);
+        data_.rejected_steps[i] = static_cast<int>(lane_rejected_[lane]);
+        data_.disk_crossings[i] = lane_crossings_[lane];
+        data_.event_steps_saved[i] = lane_saved_[lane];
+    }
+
+    // Retire finished lanes and refill them from the ray stream, so the vector
+    // width stays busy until the stream runs dry
+    void finish_lanes(unsigned event_bits, unsigned hit_bits, unsigned promote_bits) {
+        store_lanes();
+
+        for (int lane = 0; lane < W; ++lane) {
+            lane_fresh_[lane] = 0.0;
+            if (!(event_bits & (1u << lane))) continue;
+
+            T y[kState], k[kState];
+            bool hit = hit_bits & (1u << lane);
+            for (int i = 0; i < kState; ++i) {
+                y[i] = hit ? hit_y_[i][lane] : lane_y_[i][lane];
+                k[i] = hit ? hit_k_[i][lane] : lane_k_[i][lane];
+            }
+
+            int termination = kMaxSteps;
+            if (hit) {
+                termination = hit_termination_[lane];
+            } else if (promote_bits & (1u << lane)) {
+                termination = kPromote;
+            }
+
+            write_result(lane, termination, y, k);
+            assign_lane(lane);
+        }
+
+        load_lanes();
+
+        // Fresh lanes need their first stage; keep the FSAL stage of the others
+        V fresh_flags = V::load(lane_fresh_);
+        M fresh = fresh_flags > V::set1(0.0);
+        V k_new[kState];
+        derivatives(y_, L_, Q_, k_new);
+        for (int i = 0; i < kState; ++i) {
+            k1_[i] = select(fresh, k_new[i], k1_[i]);
+        }
+    }
+};
+
+template <typename Isa>
+void trace_packets(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    PacketKernel<Isa> kernel(params, data, count);
+    kernel.run();
+}
+
+}
@@ -0,0 +1,77 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include <immintrin.h>
+
+namespace {
+
+struct IsaSse2 {
+    using Scalar = double;
+    using Reg = __m128d;
+    using Mask = __m128d;
+    static constexpr int kWidth = 2;
+
+    static Reg set1(double x) { return _mm_set1_pd(x); }
+    static Reg load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, Reg a) { _mm_storeu_pd(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm_add_pd(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm_sub_pd(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm_mul_pd(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm_div_pd(a, b); }
+    static Reg sqrt(Reg a) { return _mm_sqrt_pd(a); }
+    static Reg abs(Reg a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static Reg min(Reg a, Reg b) { return _mm_min_pd(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm_max_pd(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm_cmplt_pd(a, b); }
+    static Mask le(Reg a, Reg b) { return _mm_cmple_pd(a, b); }
+    static Mask mask_and(Mask a, Mask b) { return _mm_and_pd(a, b); }
+    static Mask mask_or(Mask a, Mask b) { return _mm_or_pd(a, b); }
+    static Mask mask_xor(Mask a, Mask b) { return _mm_xor_pd(a, b); }
+    static Mask mask_not(Mask a) { return _mm_xor_pd(a, _mm_castsi128_pd(_mm_set1_epi32(-1))); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    static int bits(Mask m) { return _mm_movemask_pd(m); }
+};
+
+struct IsaSse2Float {
+    using Scalar = float;
+    using Reg = __m128;
+    using Mask = __m128;
+    static constexpr int kWidth = 4;
+
+    static Reg set1(float x) { return _mm_set1_ps(x); }
+    static Reg load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Reg a) { _mm_storeu_ps(p, a); }
+
+    static Reg add(Reg a, Reg b) { return _mm_add_ps(a, b); }
+    static Reg sub(Reg a, Reg b) { return _mm_sub_ps(a, b); }
+    static Reg mul(Reg a, Reg b) { return _mm_mul_ps(a, b); }
+    static Reg div(Reg a, Reg b) { return _mm_div_ps(a, b); }
+    static Reg sqrt(Reg a) { return _mm_sqrt_ps(a); }
+    static Reg abs(Reg a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Reg min(Reg a, Reg b) { return _mm_min_ps(a, b); }
+    static Reg max(Reg a, Reg b) { return _mm_max_ps(a, b); }
+
+    static Mask lt(Reg a, Reg b) { return _mm_cmplt_ps(a, b); }
+    static Mask le(Reg a, Reg b) { return _mm_cmple_ps(a, b); }
+    static Mask mask_and(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Mask mask_or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+    static Mask mask_xor(Mask a, Mask b) { return _mm_xor_ps(a, b); }
+    static Mask mask_not(Mask a) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+    static Reg select(Mask m, Reg a, Reg b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+    static int bits(Mask m) { return _mm_movemask_ps(m); }
+};
+
+}
+
+#include "GeodesicPacketKernelImpl.h"
+
+void trace_packets_sse2(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaSse2>(params, data, count);
+}
+
+void trace_packets_sse2_float(const PacketKernelParams& params, PacketRayData& data, std::size_t count) {
+    trace_packets<IsaSse2Float>(params, data, count);
+}
+
+#endif
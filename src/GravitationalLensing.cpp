@@ -1,8 +1,289 @@
 #include "GravitationalLensing.h"
+#include "DeflectionTable.h"
 #include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <array>
+#include <unordered_map>
 
-GravitationalLensing::GravitationalLensing() : resolution_(512) {}
+namespace {
+
+// IEEE binary16 conversion, round to nearest even
+std::uint16_t float_to_half(float value) {
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+    std::uint32_t magnitude = bits & 0x7fffffffu;
+    
+    if (magnitude >= 0x7f800000u) {  // Inf and NaN
+        return sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u);
+    }
+    if (magnitude >= 0x477ff000u) return sign | 0x7c00u;  // Overflows to infinity
+    if (magnitude < 0x38800000u) {
+        // Subnormal half: add the float to 0.5 so the FPU rounds the mantissa
+        float f;
+        std::memcpy(&f, &magnitude, sizeof(f));
+        f += 0.5f;
+        std::uint32_t rounded;
+        std::memcpy(&rounded, &f, sizeof(rounded));
+        return sign | static_cast<std::uint16_t>(rounded - 0x3f000000u);
+    }
+    std::uint32_t odd = (magnitude >> 13) & 1u;
+    magnitude += 0xc8000fffu + odd;  // Rebias the exponent and round
+    return sign | static_cast<std::uint16_t>(magnitude >> 13);
+}
+
+float half_to_float(std::uint16_t half) {
+    std::uint32_t sign = static_cast<std::uint32_t>(half & 0x8000u) << 16;
+    std::uint32_t exponent = (half >> 10) & 0x1fu;
+    std::uint32_t mantissa = half & 0x3ffu;
+    
+    float magnitude;
+    if (exponent == 0) {
+        magnitude = std::ldexp(static_cast<float>(mantissa), -24);
+    } else if (exponent == 31) {
+        std::uint32_t bits = 0x7f800000u | (mantissa << 13);
+        std::memcpy(&magnitude, &bits, sizeof(magnitude));
+    } else {
+        std::uint32_t bits = ((exponent + 112) << 23) | (mantissa << 13);
+        std::memcpy(&magnitude, &bits, sizeof(magnitude));
+    }
+    std::uint32_t bits;
+    std::memcpy(&bits, &magnitude, sizeof(bits));
+    bits |= sign;
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline float plane_value(const LensMapView& map, const void* plane, std::size_t index) {
+    return map.half ? half_to_float(static_cast<const std::uint16_t*>(plane)[index])
+                    : static_cast<const float*>(plane)[index];
+}
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+bool has_avx2_gathers() {
+#if defined(__GNUC__) || defined(__clang__)
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+               __builtin_cpu_supports("f16c");
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+#endif
+
+// Magnification cap where the Jacobian determinant vanishes
+const float kMaxMagnification = 1e3f;
+
+// Map points per side of a field lens batch
+const int kFieldTile = 8;
+
+}
+
+void lens_jacobian_row_scalar(const LensJacobianRow& row, std::size_t begin, std::size_t count) {
+    auto point = [&](std::size_t j, std::size_t before, std::size_t after) {
+        float inv_along = row.inv_spacing / static_cast<float>(after - before);
+        float dxx = (row.x_next[j] - row.x_prev[j]) * row.inv_row_distance;
+        float dyx = (row.y_next[j] - row.y_prev[j]) * row.inv_row_distance;
+        float dxy = (row.x_row[after] - row.x_row[before]) * inv_along;
+        float dyy = (row.y_row[after] - row.y_row[before]) * inv_along;
+        row.determinant[j] = (1.0f + dxx) * (1.0f + dyy) - dxy * dyx;
+    };
+    
+    point(0, 0, 1);
+    for (std::size_t j = std::max<std::size_t>(begin, 1); j + 1 < count; ++j) {
+        point(j, j - 1, j + 1);
+    }
+    point(count - 1, count - 2, count - 1);
+}
+
+void lens_jacobian_row(const LensJacobianRow& row, std::size_t count) {
+    std::size_t begin = 1;
+#ifdef BLACKHOLE_SIMD_KERNELS
+    if (has_avx2_gathers()) {
+        begin = lens_jacobian_row_avx2(row, count);
+    }
+#endif
+    lens_jacobian_row_scalar(row, begin, count);
+}
+
+void lens_magnification_row(const float* determinant, float* magnification, std::size_t count) {
+    for (std::size_t j = 0; j < count; ++j) {
+        float det = determinant[j];
+        magnification[j] = std::abs(det) * kMaxMagnification > 1.0f
+                               ? 1.0f / det
+                               : (det < 0.0f ? -kMaxMagnification : kMaxMagnification);
+    }
+}
+
+void lookup_lens_map_scalar(const LensMapView& map, const LensLookupBatch& batch,
+                            std::size_t begin, std::size_t end) {
+    const int n = map.resolution;
+    const float half_n = 0.5f * n;
+    const float last = static_cast<float>(n - 1);
+    
+    for (std::size_t k = begin; k < end; ++k) {
+        float gx = std::clamp((batch.screen_x[k] + 1.0f) * half_n, 0.0f, last);
+        float gy = std::clamp((batch.screen_y[k] + 1.0f) * half_n, 0.0f, last);
+        int x0 = std::min(static_cast<int>(gx), n - 2);
+        int y0 = std::min(static_cast<int>(gy), n - 2);
+        float fx = gx - x0;
+        float fy = gy - y0;
+        std::size_t i00 = static_cast<std::size_t>(x0) * n + y0;
+        
+        auto bilinear = [&](const void* plane) {
+            float v00 = plane_value(map, plane, i00);
+            float v01 = plane_value(map, plane, i00 + 1);
+            float v10 = plane_value(map, plane, i00 + n);
+            float v11 = plane_value(map, plane, i00 + n + 1);
+            float v0 = v00 + fy * (v01 - v00);
+            float v1 = v10 + fy * (v11 - v10);
+            return v0 + fx * (v1 - v0);
+        };
+        
+        batch.deflection_x[k] = bilinear(map.deflection_x);
+        batch.deflection_y[k] = bilinear(map.deflection_y);
+        if (batch.magnification) batch.magnification[k] = bilinear(map.magnification);
+    }
+}
+
+LensMap::LensMap() : resolution_(0), precision_(LensMapPrecision::Float) {}
+
+void LensMap::resize(int resolution, LensMapPrecision precision) {
+    resolution_ = resolution;
+    precision_ = precision;
+    for (int p = 0; p < 3; ++p) {
+        if (precision == LensMapPrecision::Half) {
+            half_planes_[p].assign(size() + 1, 0);
+            planes_[p].clear();
+        } else {
+            planes_[p].assign(size(), 0.0f);
+            half_planes_[p].clear();
+        }
+    }
+}
+
+void LensMap::swap(LensMap& other) {
+    std::swap(resolution_, other.resolution_);
+    std::swap(precision_, other.precision_);
+    for (int p = 0; p < 3; ++p) {
+        planes_[p].swap(other.planes_[p]);
+        half_planes_[p].swap(other.half_planes_[p]);
+    }
+}
+
+void LensMap::set_deflection(std::size_t index, const Eigen::Vector2d& deflection) {
+    const float values[2] = {static_cast<float>(deflection.x()), static_cast<float>(deflection.y())};
+    for (int p = 0; p < 2; ++p) {
+        if (precision_ == LensMapPrecision::Half) {
+            half_planes_[p][index] = float_to_half(values[p]);
+        } else {
+            planes_[p][index] = values[p];
+        }
+    }
+}
+
+void LensMap::read_deflection_row(int i, float* x, float* y) const {
+    const std::size_t first = static_cast<std::size_t>(i) * resolution_;
+    if (precision_ == LensMapPrecision::Half) {
+        for (int j = 0; j < resolution_; ++j) {
+            x[j] = half_to_float(half_planes_[0][first + j]);
+            y[j] = half_to_float(half_planes_[1][first + j]);
+        }
+    } else {
+        std::copy_n(planes_[0].data() + first, resolution_, x);
+        std::copy_n(planes_[1].data() + first, resolution_, y);
+    }
+}
+
+void LensMap::write_magnification_row(int i, const float* magnification) {
+    const std::size_t first = static_cast<std::size_t>(i) * resolution_;
+    if (precision_ == LensMapPrecision::Half) {
+        for (int j = 0; j < resolution_; ++j) {
+            half_planes_[2][first + j] = float_to_half(magnification[j]);
+        }
+    } else {
+        std::copy_n(magnification, resolution_, planes_[2].data() + first);
+    }
+}
+
+Eigen::Vector2d LensMap::get_deflection(std::size_t index) const {
+    LensMapView map = view();
+    return Eigen::Vector2d(plane_value(map, map.deflection_x, index),
+                           plane_value(map, map.deflection_y, index));
+}
+
+double LensMap::get_magnification(std::size_t index) const {
+    LensMapView map = view();
+    return plane_value(map, map.magnification, index);
+}
+
+std::size_t LensMap::get_byte_size() const {
+    std::size_t bytes = 0;
+    for (int p = 0; p < 3; ++p) {
+        bytes += planes_[p].size() * sizeof(float) + half_planes_[p].size() * sizeof(std::uint16_t);
+    }
+    return bytes;
+}
+
+LensMapView LensMap::view() const {
+    LensMapView map;
+    map.resolution = resolution_;
+    map.half = precision_ == LensMapPrecision::Half;
+    if (map.half) {
+        map.deflection_x = half_planes_[0].data();
+        map.deflection_y = half_planes_[1].data();
+        map.magnification = half_planes_[2].data();
+    } else {
+        map.deflection_x = planes_[0].data();
+        map.deflection_y = planes_[1].data();
+        map.magnification = planes_[2].data();
+    }
+    return map;
+}
+
+GravitationalLensing::GravitationalLensing(unsigned thread_count)
+    : resolution_(512),
+      precision_(LensMapPrecision::Float),
+      pool_(std::make_unique<ThreadPool>(thread_count)),
+      previous_black_hole_pos_(Eigen::Vector3d::Zero()),
+      previous_camera_pos_(Eigen::Vector3d::Zero()),
+      previous_mass_(0.0),
+      history_valid_(false),
+      frame_index_(0),
+      traced_points_(0) {
+    worker_traced_.resize(pool_->get_thread_count());
+    worker_rows_.resize(pool_->get_thread_count());
+}
+
+void GravitationalLensing::set_deflection_table(std::shared_ptr<const DeflectionTable> table) {
+    deflection_table_ = table;
+    history_valid_ = false;
+}
+
+void GravitationalLensing::set_field_lenses(const std::vector<FieldLens>& lenses) {
+    field_lenses_ = lenses;
+    history_valid_ = false;
+}
+
+void GravitationalLensing::set_lens_tree_settings(const LensTreeSettings& settings) {
+    lens_tree_settings_ = settings;
+    history_valid_ = false;
+}
+
+void GravitationalLensing::set_precision(LensMapPrecision precision) {
+    precision_ = precision;
+    history_valid_ = false;
+}
+
+void GravitationalLensing::set_pyramid_settings(const LensPyramidSettings& settings) {
+    pyramid_settings_ = settings;
+    history_valid_ = false;
+}
 
 void GravitationalLensing::calculate_lensing_pattern(
     const Eigen::Vector3d& black_hole_pos,
@@ -10,34 +291,399 @@ void GravitationalLensing::calculate_lensing_pattern(
     const Eigen::Vector3d& camera_pos,
     int resolution) {
     
-    resolution_ = resolution;
-    lens_map_.clear();
-    lens_map_.reserve(resolution_ * resolution_);
+    if (inputs_unchanged(black_hole_pos, black_hole_mass, camera_pos, resolution)) {
+        traced_points_ = 0;
+        return;
+    }
     
-    double M = black_hole_mass * solar_mass;
-    double rs = 2.0 * G * M / (c * c);
+    build_lens_tree(camera_pos);
     
-    for (int i = 0; i < resolution_; ++i) {
-        for (int j = 0; j < resolution_; ++j) {
-            LensPoint point;
+    if (!reproject_lensing_pattern(black_hole_pos, black_hole_mass, camera_pos, resolution)) {
+        resolution_ = resolution;
+        lens_map_.resize(resolution_, precision_);
+        
+        // One map row per task
+        pool_->parallel_for(static_cast<std::size_t>(resolution_), [&](std::size_t row, unsigned) {
+            const int i = static_cast<int>(row);
+            for (int j = 0; j < resolution_; ++j) {
+                Eigen::Vector2d deflection = calculate_single_ray_deflection(
+                    lens_map_.screen_position(i, j), black_hole_pos, camera_pos, black_hole_mass);
+                lens_map_.set_deflection(row * resolution_ + j, deflection);
+            }
+        });
+        add_field_deflection();
+        traced_points_ = lens_map_.size();
+    }
+    
+    compute_magnification();
+    extract_critical_curves();
+    pyramid_.build(lens_map_, pyramid_settings_, *pool_,
+                   [&](const Eigen::Vector2d& screen_pos) {
+                       return calculate_deflection(screen_pos, black_hole_pos, camera_pos,
+                                                   black_hole_mass);
+                   });
+    
+    previous_black_hole_pos_ = black_hole_pos;
+    previous_camera_pos_ = camera_pos;
+    previous_mass_ = black_hole_mass;
+    history_valid_ = true;
+    ++frame_index_;
+}
+
+void GravitationalLensing::build_lens_tree(const Eigen::Vector3d& camera_pos) {
+    if (field_lenses_.empty()) {
+        lens_tree_.clear();
+        return;
+    }
+    
+    // Same weak-field scale as calculate_single_ray_deflection, whose impact
+    // parameter is the depth times the screen distance to the lens
+    std::vector<ScreenLens> lenses;
+    lenses.reserve(field_lenses_.size());
+    for (const FieldLens& lens : field_lenses_) {
+        Eigen::Vector3d offset = lens.position - camera_pos;
+        if (offset.z() >= 0.0) continue;  // Not in front of the screen
+        double depth = -offset.z();
+        double M = lens.mass * solar_mass;
+        lenses.push_back({offset.head<2>() / depth, 0.4 * G * M / (c * c * depth)});
+    }
+    lens_tree_.build(lenses, lens_tree_settings_);
+}
+
+void GravitationalLensing::add_field_deflection() {
+    if (lens_tree_.empty()) return;
+    const int n = lens_map_.get_resolution();
+    const int tiles = (n + kFieldTile - 1) / kFieldTile;
+    
+    // One block of map points per task shares the far field of the tree
+    pool_->parallel_for(static_cast<std::size_t>(tiles) * tiles, [&](std::size_t tile, unsigned) {
+        const int i0 = static_cast<int>(tile / tiles) * kFieldTile;
+        const int j0 = static_cast<int>(tile % tiles) * kFieldTile;
+        double x[kFieldTile * kFieldTile] = {}, y[kFieldTile * kFieldTile] = {};
+        double dx[kFieldTile * kFieldTile], dy[kFieldTile * kFieldTile];
+        std::size_t index[kFieldTile * kFieldTile];
+        std::size_t count = 0;
+        for (int i = i0; i < std::min(i0 + kFieldTile, n); ++i) {
+            for (int j = j0; j < std::min(j0 + kFieldTile, n); ++j) {
+                Eigen::Vector2d screen_pos = lens_map_.screen_position(i, j);
+                x[count] = screen_pos.x();
+                y[count] = screen_pos.y();
+                index[count++] = static_cast<std::size_t>(i) * n + j;
+            }
+        }
+        
+        lens_tree_.deflection(x, y, dx, dy, count);
+        for (std::size_t k = 0; k < count; ++k) {
+            lens_map_.set_deflection(index[k], lens_map_.get_deflection(index[k]) + Eigen::Vector2d(dx[k], dy[k]));
+        }
+    });
+}
+
+void GravitationalLensing::compute_magnification() {
+    const int n = lens_map_.get_resolution();
+    determinants_.resize(lens_map_.size());
+    if (n < 2) return;
+    const float spacing = 2.0f / n;
+    
+    // One map row per task, from the row and its two neighbours; half maps are
+    // converted to float rows first
+    const LensMapView map = lens_map_.view();
+    pool_->parallel_for(static_cast<std::size_t>(n), [&](std::size_t row, unsigned worker) {
+        std::vector<float>& scratch = worker_rows_[worker];
+        scratch.resize(static_cast<std::size_t>(n) * 7);
+        float* magnification = scratch.data() + 6 * n;
+        
+        const int i = static_cast<int>(row);
+        const int rows[3] = {std::max(i - 1, 0), i, std::min(i + 1, n - 1)};
+        const float* x[3];
+        const float* y[3];
+        for (int r = 0; r < 3; ++r) {
+            if (map.half) {
+                float* x_row = scratch.data() + r * n;
+                float* y_row = scratch.data() + (3 + r) * n;
+                lens_map_.read_deflection_row(rows[r], x_row, y_row);
+                x[r] = x_row;
+                y[r] = y_row;
+            } else {
+                x[r] = static_cast<const float*>(map.deflection_x) + static_cast<std::size_t>(rows[r]) * n;
+                y[r] = static_cast<const float*>(map.deflection_y) + static_cast<std::size_t>(rows[r]) * n;
+            }
+        }
+        const int prev = rows[0];
+        const int next = rows[2];
+        
+        float* determinant = determinants_.data() + row * n;
+        LensJacobianRow jacobian{x[0], x[1], x[2], y[0], y[1], y[2],
+                                 1.0f / (spacing * (next - prev)), 1.0f / spacing, determinant};
+        lens_jacobian_row(jacobian, n);
+        lens_magnification_row(determinant, magnification, n);
+        lens_map_.write_magnification_row(i, magnification);
+    });
+}
+
+void GravitationalLensing::extract_critical_curves() {
+    critical_curves_.clear();
+    const int n = lens_map_.get_resolution();
+    if (n < 2) return;
+    
+    // Grid edges are numbered 2 (i n + j) towards (i + 1, j) and 2 (i n + j) + 1
+    // towards (i, j + 1); a segment joins two edges the zero contour crosses
+    using Segment = std::pair<std::uint64_t, std::uint64_t>;
+    std::vector<std::vector<Segment>> row_segments(n - 1);
+    const float* det = determinants_.data();
+    
+    pool_->parallel_for(static_cast<std::size_t>(n - 1), [&](std::size_t row, unsigned) {
+        std::vector<Segment>& segments = row_segments[row];
+        const std::uint64_t i = row;
+        const std::uint64_t cells = n - 1;
+        const float* lower = det + i * n;
+        const float* upper = lower + n;
+        
+        // Most of the map has one sign; skip runs of cells whose range does not cross 0
+        const std::uint64_t kRun = 64;
+        for (std::uint64_t run = 0; run < cells; run += kRun) {
+            const std::uint64_t run_end = std::min(run + kRun, cells);
+            float low = lower[run], high = lower[run];
+            for (std::uint64_t j = run; j <= run_end; ++j) {
+                low = std::min(low, std::min(lower[j], upper[j]));
+                high = std::max(high, std::max(lower[j], upper[j]));
+            }
+            if (low > 0.0f || high <= 0.0f) continue;
+            
+            for (std::uint64_t j = run; j < run_end; ++j) {
+                std::uint64_t k = i * n + j;
+                bool s00 = det[k] > 0.0f, s10 = det[k + n] > 0.0f;
+                bool s01 = det[k + 1] > 0.0f, s11 = det[k + n + 1] > 0.0f;
+                if (s00 == s10 && s00 == s01 && s00 == s11) continue;
             
-            // Convert to normalized screen coordinates [-1, 1]
-            point.screen_pos = Eigen::Vector2d(
-                (2.0 * i / resolution_ - 1.0),
-                (2.0 * j / resolution_ - 1.0)
-            );
+                // Cell edges counter-clockwise from the one along i at j
+                const std::uint64_t edges[4] = {2 * k, 2 * (k + n) + 1, 2 * (k + 1), 2 * k + 1};
+                const bool crossed[4] = {s00 != s10, s10 != s11, s01 != s11, s00 != s01};
+                std::uint64_t ends[4];
+                int count = 0;
+                for (int e = 0; e < 4; ++e) {
+                    if (crossed[e]) ends[count++] = edges[e];
+                }
+                if (count == 2) {
+                    segments.emplace_back(ends[0], ends[1]);
+                } else {
+                    // Saddle: the cell center decides which diagonal is connected
+                    float center = det[k] + det[k + n] + det[k + 1] + det[k + n + 1];
+                    if ((center > 0.0f) == s00) {
+                        segments.emplace_back(edges[0], edges[1]);
+                        segments.emplace_back(edges[2], edges[3]);
+                    } else {
+                        segments.emplace_back(edges[0], edges[3]);
+                        segments.emplace_back(edges[1], edges[2]);
+                    }
+                }
+            }
+        }
+    });
+    
+    // Contour points on the crossed edges and their (at most two) neighbours
+    std::unordered_map<std::uint64_t, int> point_of_edge;
+    std::vector<Eigen::Vector2f> critical;
+    std::vector<Eigen::Vector2f> caustic;
+    std::vector<std::array<int, 2>> neighbours;
+    
+    auto point = [&](std::uint64_t edge) {
+        auto found = point_of_edge.find(edge);
+        if (found != point_of_edge.end()) return found->second;
+        
+        std::uint64_t k0 = edge >> 1;
+        std::uint64_t k1 = k0 + ((edge & 1) ? 1 : n);
+        int i0 = static_cast<int>(k0 / n), j0 = static_cast<int>(k0 % n);
+        int i1 = static_cast<int>(k1 / n), j1 = static_cast<int>(k1 % n);
+        double t = det[k0] != det[k1] ? det[k0] / (det[k0] - det[k1]) : 0.5;
+        
+        Eigen::Vector2d screen = (1.0 - t) * lens_map_.screen_position(i0, j0) + t * lens_map_.screen_position(i1, j1);
+        Eigen::Vector2d deflection = (1.0 - t) * lens_map_.get_deflection(k0) + t * lens_map_.get_deflection(k1);
+        critical.push_back(screen.cast<float>());
+        caustic.push_back((screen + deflection).cast<float>());
+        neighbours.push_back({-1, -1});
+        
+        int index = static_cast<int>(critical.size()) - 1;
+        point_of_edge.emplace(edge, index);
+        return index;
+    };
+    auto link = [&](int a, int b) {
+        (neighbours[a][0] < 0 ? neighbours[a][0] : neighbours[a][1]) = b;
+    };
+    
+    for (const std::vector<Segment>& segments : row_segments) {
+        for (const Segment& segment : segments) {
+            int a = point(segment.first);
+            int b = point(segment.second);
+            link(a, b);
+            link(b, a);
+        }
+    }
+    
+    // Open curves start at a map edge, where a point has one neighbour; loops anywhere
+    std::vector<bool> visited(critical.size(), false);
+    auto walk = [&](int start, bool closed) {
+        LensCriticalCurve curve;
+        curve.closed = closed;
+        int previous = -1;
+        int current = start;
+        while (current >= 0 && !visited[current]) {
+            visited[current] = true;
+            curve.critical.push_back(critical[current]);
+            curve.caustic.push_back(caustic[current]);
+            int next = neighbours[current][0] != previous ? neighbours[current][0] : neighbours[current][1];
+            previous = current;
+            current = next;
+        }
+        critical_curves_.push_back(std::move(curve));
+    };
+    for (std::size_t p = 0; p < critical.size(); ++p) {
+        if (!visited[p] && neighbours[p][1] < 0) walk(static_cast<int>(p), false);
+    }
+    for (std::size_t p = 0; p < critical.size(); ++p) {
+        if (!visited[p]) walk(static_cast<int>(p), true);
+    }
+}
+
+int GravitationalLensing::get_parity(const Eigen::Vector2d& screen_pos) const {
+    const int n = lens_map_.get_resolution();
+    if (n < 1 || determinants_.empty()) return 1;
+    int i = std::clamp(static_cast<int>(std::lround((screen_pos.x() + 1.0) * 0.5 * n)), 0, n - 1);
+    int j = std::clamp(static_cast<int>(std::lround((screen_pos.y() + 1.0) * 0.5 * n)), 0, n - 1);
+    return determinants_[static_cast<std::size_t>(i) * n + j] < 0.0f ? -1 : 1;
+}
+
+bool GravitationalLensing::inputs_unchanged(
+    const Eigen::Vector3d& black_hole_pos,
+    double black_hole_mass,
+    const Eigen::Vector3d& camera_pos,
+    int resolution) const {
+    
+    if (!history_valid_ || resolution != lens_map_.get_resolution() ||
+        lens_map_.get_precision() != precision_) {
+        return false;
+    }
+    
+    // Movements are measured against the camera's distance to the hole
+    double distance = (previous_black_hole_pos_ - previous_camera_pos_).norm();
+    double tolerance = temporal_.reuse_tolerance;
+    return (black_hole_pos - previous_black_hole_pos_).norm() <= tolerance * distance &&
+           (camera_pos - previous_camera_pos_).norm() <= tolerance * distance &&
+           std::abs(black_hole_mass - previous_mass_) <= tolerance * previous_mass_;
+}
+
+bool GravitationalLensing::reproject_lensing_pattern(
+    const Eigen::Vector3d& black_hole_pos,
+    double black_hole_mass,
+    const Eigen::Vector3d& camera_pos,
+    int resolution) {
+    
+    if (!temporal_.enabled || !history_valid_ || resolution != resolution_ || resolution < 2 ||
+        !field_lenses_.empty() ||
+        black_hole_pos != previous_black_hole_pos_ || black_hole_mass != previous_mass_ ||
+        lens_map_.get_resolution() != resolution || lens_map_.get_precision() != precision_) {
+        return false;
+    }
+    
+    // The screen looks down -z; the hole must stay in front of it
+    Eigen::Vector3d to_bh_old = previous_black_hole_pos_ - previous_camera_pos_;
+    Eigen::Vector3d to_bh = black_hole_pos - camera_pos;
+    if (to_bh_old.z() >= 0.0 || to_bh.z() >= 0.0) {
+        return false;
+    }
+    
+    double depth_old = -to_bh_old.z();
+    double depth = -to_bh.z();
+    double scale = depth / depth_old;
+    Eigen::Vector2d hole_old = to_bh_old.head<2>() / depth_old;
+    Eigen::Vector2d hole = to_bh.head<2>() / depth;
+    if (std::abs(scale - 1.0) > temporal_.max_depth_change ||
+        (hole - hole_old).norm() > temporal_.max_screen_shift) {
+        return false;
+    }
+    
+    previous_map_.swap(lens_map_);
+    lens_map_.resize(resolution_, precision_);
+    traced_points_ = 0;
+    
+    // Every period-th point is re-traced, on a different phase each frame
+    const std::size_t period = temporal_.refresh_fraction > 0.0
+        ? static_cast<std::size_t>(std::max(1.0, std::round(1.0 / temporal_.refresh_fraction)))
+        : 0;
+    const double half = 0.5 * resolution_;
+    const double last = resolution_ - 1;
+    std::fill(worker_traced_.begin(), worker_traced_.end(), 0);
+    
+    // One map row per task
+    pool_->parallel_for(static_cast<std::size_t>(resolution_), [&](std::size_t row, unsigned worker) {
+        const int i = static_cast<int>(row);
+        for (int j = 0; j < resolution_; ++j) {
+            std::size_t index = row * resolution_ + j;
+            Eigen::Vector2d screen_pos = lens_map_.screen_position(i, j);
+            Eigen::Vector2d deflection = Eigen::Vector2d::Zero();
             
-            point.deflection = calculate_single_ray_deflection(
-                point.screen_pos, black_hole_pos, camera_pos, black_hole_mass);
+            bool trace = period > 0 && (index + frame_index_) % period == 0;
             
-            // Calculate approximate magnification
-            double jacobian = std::abs((1.0 + point.deflection.x()) * (1.0 + point.deflection.y()) - 
-                              point.deflection.x() * point.deflection.y());
-            point.magnification = 1.0 / std::max(jacobian, 0.001);
+            if (!trace) {
+                // Same impact parameter in the previous frame
+                Eigen::Vector2d source = hole_old + (screen_pos - hole) * scale;
+                double gx = (source.x() + 1.0) * half;
+                double gy = (source.y() + 1.0) * half;
+                
+                if (gx < 0.0 || gy < 0.0 || gx > last || gy > last) {
+                    trace = true;  // Not on the previous map
+                } else {
+                    int x0 = std::min(static_cast<int>(gx), resolution_ - 2);
+                    int y0 = std::min(static_cast<int>(gy), resolution_ - 2);
+                    double fx = gx - x0;
+                    double fy = gy - y0;
+                    
+                    std::size_t i00 = static_cast<std::size_t>(x0) * resolution_ + y0;
+                    Eigen::Vector2d d00 = previous_map_.get_deflection(i00);
+                    Eigen::Vector2d d10 = previous_map_.get_deflection(i00 + resolution_);
+                    Eigen::Vector2d d01 = previous_map_.get_deflection(i00 + 1);
+                    Eigen::Vector2d d11 = previous_map_.get_deflection(i00 + resolution_ + 1);
+                    
+                    // Steep or discontinuous neighbourhoods (photon ring, shadow edge) and
+                    // rays bent by more than the half screen do not interpolate
+                    double spread = std::max({(d10 - d00).norm(), (d01 - d00).norm(), (d11 - d00).norm()});
+                    double magnitude = std::max({d00.norm(), d10.norm(), d01.norm(), d11.norm()});
+                    if (spread > temporal_.max_relative_spread * magnitude || magnitude > 1.0) {
+                        trace = true;
+                    } else {
+                        deflection = (1.0 - fx) * ((1.0 - fy) * d00 + fy * d01) +
+                                     fx * ((1.0 - fy) * d10 + fy * d11);
+                    }
+                }
+            }
             
-            lens_map_.push_back(point);
+            if (trace) {
+                deflection = calculate_single_ray_deflection(
+                    screen_pos, black_hole_pos, camera_pos, black_hole_mass);
+                ++worker_traced_[worker];
+            }
+            lens_map_.set_deflection(index, deflection);
         }
+    });
+    
+    for (std::size_t traced : worker_traced_) {
+        traced_points_ += traced;
+    }
+    return true;
+}
+
+Eigen::Vector2d GravitationalLensing::calculate_deflection(
+    const Eigen::Vector2d& screen_pos,
+    const Eigen::Vector3d& black_hole_pos,
+    const Eigen::Vector3d& camera_pos,
+    double black_hole_mass) const {
+    
+    Eigen::Vector2d deflection = calculate_single_ray_deflection(
+        screen_pos, black_hole_pos, camera_pos, black_hole_mass);
+    if (!lens_tree_.empty()) {
+        deflection += lens_tree_.deflection(screen_pos);
     }
+    return deflection;
 }
 
 Eigen::Vector2d GravitationalLensing::calculate_single_ray_deflection(
@@ -52,6 +698,21 @@ Eigen::Vector2d GravitationalLensing::calculate_single_ray_deflection(
     Eigen::Vector3d ray_dir = Eigen::Vector3d(screen_pos.x(), screen_pos.y(), -1.0).normalized();
     Eigen::Vector3d ray_origin = camera_pos;
     
+    if (deflection_table_) {
+        double rg = G * M / (c * c);
+        DeflectionSample sample = deflection_table_->lookup((camera_pos - black_hole_pos) / rg, ray_dir);
+        if (sample.valid) {
+            // Project the escaped direction back onto the screen plane; captured
+            // rays and rays bent behind the camera keep zero deflection
+            Eigen::Vector2d deflection = Eigen::Vector2d::Zero();
+            if (sample.termination == GeodesicTermination::Escaped && sample.direction.z() < -1e-6) {
+                Eigen::Vector2d projected = sample.direction.head<2>() / -sample.direction.z();
+                deflection = projected - screen_pos;
+            }
+            return deflection;
+        }
+    }
+    
     // Find closest approach to black hole
     Eigen::Vector3d to_bh = black_hole_pos - ray_origin;
     double t = to_bh.dot(ray_dir);
@@ -67,7 +728,7 @@ Eigen::Vector2d GravitationalLensing::calculate_single_ray_deflection(
     double deflection_angle = 4.0 * G * M / (c * c * impact_parameter);
     
     // Convert to screen deflection
-    Eigen::Vector2d deflection;
+    Eigen::Vector2d deflection = Eigen::Vector2d::Zero();
     if (impact_parameter > 0.0) {
         Eigen::Vector2d impact_dir(impact_vector.x(), impact_vector.y());
         impact_dir.normalize();
@@ -77,23 +738,54 @@ Eigen::Vector2d GravitationalLensing::calculate_single_ray_deflection(
     return deflection;
 }
 
-Eigen::Vector2d GravitationalLensing::get_deflection(const Eigen::Vector2d& screen_pos) const {
-    // Find closest point in lens map (simplified)
-    int i = static_cast<int>((screen_pos.x() + 1.0) * 0.5 * resolution_);
-    int j = static_cast<int>((screen_pos.y() + 1.0) * 0.5 * resolution_);
-    
-    i = std::clamp(i, 0, resolution_ - 1);
-    j = std::clamp(j, 0, resolution_ - 1);
-    
-    return lens_map_[i * resolution_ + j].deflection;
+Eigen::Vector2d GravitationalLensing::get_deflection(const Eigen::Vector2d& screen_pos,
+                                                     double footprint) const {
+    float x = static_cast<float>(screen_pos.x());
+    float y = static_cast<float>(screen_pos.y());
+    float dx = 0.0f, dy = 0.0f;
+    lookup(&x, &y, &dx, &dy, nullptr, 1, footprint);
+    return Eigen::Vector2d(dx, dy);
+}
+
+double GravitationalLensing::get_magnification(const Eigen::Vector2d& screen_pos,
+                                               double footprint) const {
+    float x = static_cast<float>(screen_pos.x());
+    float y = static_cast<float>(screen_pos.y());
+    float dx = 0.0f, dy = 0.0f, magnification = 1.0f;
+    lookup(&x, &y, &dx, &dy, &magnification, 1, footprint);
+    return magnification;
 }
 
-double GravitationalLensing::get_magnification(const Eigen::Vector2d& screen_pos) const {
-    int i = static_cast<int>((screen_pos.x() + 1.0) * 0.5 * resolution_);
-    int j = static_cast<int>((screen_pos.y() + 1.0) * 0.5 * resolution_);
+void GravitationalLensing::lookup(const float* screen_x, const float* screen_y,
+                                  float* deflection_x, float* deflection_y, float* magnification,
+                                  std::size_t count, double footprint) const {
+    if (lens_map_.get_resolution() < 2) {
+        std::fill(deflection_x, deflection_x + count, 0.0f);
+        std::fill(deflection_y, deflection_y + count, 0.0f);
+        if (magnification) std::fill(magnification, magnification + count, 1.0f);
+        return;
+    }
+    
+    LensMapView map = lens_map_.view();
+    LensLookupBatch batch{screen_x, screen_y, deflection_x, deflection_y, magnification};
     
-    i = std::clamp(i, 0, resolution_ - 1);
-    j = std::clamp(j, 0, resolution_ - 1);
+    std::size_t done = 0;
+#ifdef BLACKHOLE_SIMD_KERNELS
+    if (has_avx2_gathers()) {
+        done = lookup_lens_map_avx2(map, batch, count);
+    }
+#endif
+    lookup_lens_map_scalar(map, batch, done, count);
     
-    return lens_map_[i * resolution_ + j].magnification;
+    const int level = pyramid_.select_level(footprint);
+    if (level == 0) return;
+    for (std::size_t k = 0; k < count; ++k) {
+        Eigen::Vector2d deflection;
+        double refined_magnification;
+        if (pyramid_.lookup(screen_x[k], screen_y[k], level, deflection, refined_magnification)) {
+            deflection_x[k] = static_cast<float>(deflection.x());
+            deflection_y[k] = static_cast<float>(deflection.y());
+            if (magnification) magnification[k] = static_cast<float>(refined_magnification);
+        }
+    }
 }
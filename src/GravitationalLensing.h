@@ -2,33 +2,202 @@
 #define GRAVITATIONALLENSING_H
 
 #include <Eigen/Dense>
+#include "LensMapKernel.h"
+#include "LensPyramid.h"
+#include "LensTree.h"
+#include "ThreadPool.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
-struct LensPoint {
-    Eigen::Vector2d screen_pos;
-    Eigen::Vector2d deflection;
-    double magnification;
+class DeflectionTable;
+
+enum class LensMapPrecision {
+    Float,   // 12 bytes per point
+    Half     // 6 bytes per point, IEEE binary16
 };
 
+// Lens map stored as planar deflection x, deflection y and magnification arrays.
+// Entry i * resolution + j belongs to the grid point at screen position
+// (2i / resolution - 1, 2j / resolution - 1), so positions are not stored.
+// Half planes carry one padding entry so SIMD gathers may read 32 bits at the
+// last point.
+class LensMap {
+public:
+    LensMap();
+
+    void resize(int resolution, LensMapPrecision precision);
+    void swap(LensMap& other);
+
+    void set_deflection(std::size_t index, const Eigen::Vector2d& deflection);
+    Eigen::Vector2d get_deflection(std::size_t index) const;
+    double get_magnification(std::size_t index) const;
+
+    int get_resolution() const { return resolution_; }
+    LensMapPrecision get_precision() const { return precision_; }
+    std::size_t size() const { return static_cast<std::size_t>(resolution_) * resolution_; }
+    std::size_t get_byte_size() const;
+    bool empty() const { return resolution_ == 0; }
+
+    Eigen::Vector2d screen_position(int i, int j) const {
+        return Eigen::Vector2d(2.0 * i / resolution_ - 1.0, 2.0 * j / resolution_ - 1.0);
+    }
+
+    // Row i (points i * resolution ..) as float; used by the Jacobian pass
+    void read_deflection_row(int i, float* x, float* y) const;
+    void write_magnification_row(int i, const float* magnification);
+
+    LensMapView view() const;
+
+private:
+    int resolution_;
+    LensMapPrecision precision_;
+    std::vector<float> planes_[3];
+    std::vector<std::uint16_t> half_planes_[3];
+};
+
+// Zero contour of the lens Jacobian determinant, as a polyline. The critical
+// curve lies on the screen; the caustic is its image in the source plane,
+// screen position plus deflection.
+struct LensCriticalCurve {
+    std::vector<Eigen::Vector2f> critical;
+    std::vector<Eigen::Vector2f> caustic;
+    bool closed;
+
+    LensCriticalCurve() : closed(false) {}
+};
+
+// Additional point mass in the scene, such as a binary companion or a star,
+// lensing in the weak-field thin-lens limit
+struct FieldLens {
+    Eigen::Vector3d position;
+    double mass;  // Solar masses
+};
+
+// Reuse of the previous lens map while the camera moves smoothly. The camera only
+// translates, so the deflection around the hole is carried over by shifting and
+// scaling the old map about the hole's screen position by the change in depth.
+struct LensingTemporalSettings {
+    bool enabled;
+    double refresh_fraction;     // Share of points re-traced every frame anyway, bounds drift
+    double max_relative_spread;  // Neighbour disagreement above which a point is re-traced
+    double max_depth_change;     // Relative change of the hole's depth that forces a rebuild
+    double max_screen_shift;     // Movement of the hole on screen that forces a rebuild
+    double reuse_tolerance;      // Input change, relative to the camera distance and the mass,
+                                 // below which the map is kept without any work
+
+    LensingTemporalSettings() :
+        enabled(true),
+        refresh_fraction(1.0 / 16.0),
+        max_relative_spread(0.05),
+        max_depth_change(0.1),
+        max_screen_shift(0.25),
+        reuse_tolerance(1e-6) {}
+};
+
+// Screen-space lens map around a black hole. Map rows are computed in parallel
+// on an owned thread pool, and a call whose inputs match the current map within
+// reuse_tolerance returns straight away.
+//
+// A deflection d maps screen position x to the source position x + d(x). Once
+// the deflection field is complete, one pass takes the Jacobian of that mapping
+// by finite differences; the map stores the signed magnification 1 / det, whose
+// sign is the image parity, and the zero contour of det is extracted by
+// marching squares as critical curves with their caustics.
+//
+// Field lenses add their deflection on top of the hole's. They are projected
+// onto the screen every frame and summed through a LensTree over 8x8 blocks of
+// map points, so thousands of stars cost about as much as a few; reprojection
+// only models the hole and is skipped while field lenses are set.
 class GravitationalLensing {
 public:
-    GravitationalLensing();
+    // thread_count = 0 uses all hardware threads
+    explicit GravitationalLensing(unsigned thread_count = 0);
     
     void calculate_lensing_pattern(const Eigen::Vector3d& black_hole_pos,
                                  double black_hole_mass,
                                  const Eigen::Vector3d& camera_pos,
                                  int resolution = 512);
     
-    Eigen::Vector2d get_deflection(const Eigen::Vector2d& screen_pos) const;
-    double get_magnification(const Eigen::Vector2d& screen_pos) const;
+    // Bilinear in the lens map, clamped to its edge. footprint is the screen extent
+    // of the query and picks the pyramid level, see LensPyramid; 0 is the finest.
+    Eigen::Vector2d get_deflection(const Eigen::Vector2d& screen_pos, double footprint = 0.0) const;
+    double get_magnification(const Eigen::Vector2d& screen_pos, double footprint = 0.0) const;
+    
+    // Bilinear lookup of count screen positions, planar in and out; magnification
+    // may be null. The base map is read with AVX2 gathers when the CPU has them,
+    // refined pyramid tiles one point at a time.
+    void lookup(const float* screen_x, const float* screen_y,
+                float* deflection_x, float* deflection_y, float* magnification,
+                std::size_t count, double footprint = 0.0) const;
+    
+    const LensMap& get_lens_map() const { return lens_map_; }
+    const LensPyramid& get_pyramid() const { return pyramid_; }
+    
+    // Image parity at the nearest map point: 1, or -1 for mirrored images
+    int get_parity(const Eigen::Vector2d& screen_pos) const;
     
-    const std::vector<LensPoint>& get_lens_map() const { return lens_map_; }
+    // Jacobian determinants, laid out like the lens map
+    const std::vector<float>& get_jacobian_determinants() const { return determinants_; }
+    const std::vector<LensCriticalCurve>& get_critical_curves() const { return critical_curves_; }
+    
+    // Refinement above the resolution given to calculate_lensing_pattern
+    void set_pyramid_settings(const LensPyramidSettings& settings);
+    const LensPyramidSettings& get_pyramid_settings() const { return pyramid_settings_; }
     
     void set_resolution(int resolution) { resolution_ = resolution; }
     
+    // Storage of the lens map from the next calculate_lensing_pattern on
+    void set_precision(LensMapPrecision precision);
+    LensMapPrecision get_precision() const { return precision_; }
+    
+    // Point masses lensing alongside the hole, from the next calculate_lensing_pattern on
+    void set_field_lenses(const std::vector<FieldLens>& lenses);
+    const std::vector<FieldLens>& get_field_lenses() const { return field_lenses_; }
+    
+    void set_lens_tree_settings(const LensTreeSettings& settings);
+    const LensTreeSettings& get_lens_tree_settings() const { return lens_tree_settings_; }
+    const LensTree& get_lens_tree() const { return lens_tree_; }
+    
+    // Use precomputed strong-field deflection instead of the weak-field point lens
+    void set_deflection_table(std::shared_ptr<const DeflectionTable> table);
+    
+    void set_temporal_settings(const LensingTemporalSettings& settings) { temporal_ = settings; }
+    const LensingTemporalSettings& get_temporal_settings() const { return temporal_; }
+    
+    // Force the next calculate_lensing_pattern to trace every point
+    void invalidate_history() { history_valid_ = false; }
+    
+    // Points traced by the last calculate_lensing_pattern, the rest were reprojected
+    // or, when it is 0, the map was reused as is
+    std::size_t get_traced_point_count() const { return traced_points_; }
+    
 private:
-    std::vector<LensPoint> lens_map_;
+    LensMap lens_map_;
+    LensPyramid pyramid_;
+    LensPyramidSettings pyramid_settings_;
     int resolution_;
+    LensMapPrecision precision_;
+    std::unique_ptr<ThreadPool> pool_;
+    std::vector<std::size_t> worker_traced_;
+    std::vector<std::vector<float>> worker_rows_;
+    std::vector<float> determinants_;
+    std::vector<LensCriticalCurve> critical_curves_;
+    std::shared_ptr<const DeflectionTable> deflection_table_;
+    std::vector<FieldLens> field_lenses_;
+    LensTreeSettings lens_tree_settings_;
+    LensTree lens_tree_;
+    
+    // Previous frame for temporal reprojection
+    LensingTemporalSettings temporal_;
+    LensMap previous_map_;
+    Eigen::Vector3d previous_black_hole_pos_;
+    Eigen::Vector3d previous_camera_pos_;
+    double previous_mass_;
+    bool history_valid_;
+    std::size_t frame_index_;
+    std::size_t traced_points_;
     
     const double G = 6.67430e-11;
     const double c = 299792458.0;
@@ -38,6 +207,27 @@ private:
                                                   const Eigen::Vector3d& black_hole_pos,
                                                   const Eigen::Vector3d& camera_pos,
                                                   double black_hole_mass) const;
+    
+    // Hole plus field lenses
+    Eigen::Vector2d calculate_deflection(const Eigen::Vector2d& screen_pos,
+                                         const Eigen::Vector3d& black_hole_pos,
+                                         const Eigen::Vector3d& camera_pos,
+                                         double black_hole_mass) const;
+    
+    void build_lens_tree(const Eigen::Vector3d& camera_pos);
+    void add_field_deflection();
+    void compute_magnification();
+    void extract_critical_curves();
+    
+    bool inputs_unchanged(const Eigen::Vector3d& black_hole_pos,
+                          double black_hole_mass,
+                          const Eigen::Vector3d& camera_pos,
+                          int resolution) const;
+    
+    bool reproject_lensing_pattern(const Eigen::Vector3d& black_hole_pos,
+                                   double black_hole_mass,
+                                   const Eigen::Vector3d& camera_pos,
+                                   int resolution);
 };
 
 #endif
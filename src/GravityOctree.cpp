@@ -0,0 +1,252 @@
+#include "GravityOctree.h"
+#include "NBodyKernel.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace {
+
+// Spreads the low 21 bits of v so two zero bits follow each one
+std::uint64_t spread_bits(std::uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffull;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+    v = (v | (v << 8)) & 0x100f00f00f00f00full;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+    v = (v | (v << 2)) & 0x1249249249249249ull;
+    return v;
+}
+
+}
+
+GravityOctree::GravityOctree() : leaf_size_(16) {}
+
+void GravityOctree::build(const double* x, const double* y, const double* z, const double* mass,
+                          std::size_t count, int leaf_size) {
+    nodes_.clear();
+    leaves_.clear();
+    leaf_size_ = std::max(leaf_size, 1);
+    if (count == 0) {
+        mass_.clear();
+        return;
+    }
+
+    // Morton keys in the bounding cube
+    double low[3] = {x[0], y[0], z[0]};
+    double high[3] = {x[0], y[0], z[0]};
+    for (std::size_t i = 1; i < count; ++i) {
+        low[0] = std::min(low[0], x[i]);
+        low[1] = std::min(low[1], y[i]);
+        low[2] = std::min(low[2], z[i]);
+        high[0] = std::max(high[0], x[i]);
+        high[1] = std::max(high[1], y[i]);
+        high[2] = std::max(high[2], z[i]);
+    }
+    double side = std::max({high[0] - low[0], high[1] - low[1], high[2] - low[2]});
+    double scale = side > 0.0 ? static_cast<double>((1u << kMaxDepth) - 1) / side : 0.0;
+
+    std::vector<std::uint64_t> unsorted(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        unsorted[i] = (spread_bits(static_cast<std::uint64_t>((x[i] - low[0]) * scale)) << 2) |
+                      (spread_bits(static_cast<std::uint64_t>((y[i] - low[1]) * scale)) << 1) |
+                      spread_bits(static_cast<std::uint64_t>((z[i] - low[2]) * scale));
+    }
+
+    // Ties keep input order, so the layout only depends on the bodies
+    order_.resize(count);
+    std::iota(order_.begin(), order_.end(), 0u);
+    std::sort(order_.begin(), order_.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return unsorted[a] != unsorted[b] ? unsorted[a] < unsorted[b] : a < b;
+    });
+
+    keys_.resize(count);
+    x_.resize(count);
+    y_.resize(count);
+    z_.resize(count);
+    mass_.resize(count);
+    for (std::size_t k = 0; k < count; ++k) {
+        std::uint32_t i = order_[k];
+        keys_[k] = unsorted[i];
+        x_[k] = x[i];
+        y_[k] = y[i];
+        z_[k] = z[i];
+        mass_[k] = mass[i];
+    }
+
+    nodes_.push_back(Node());
+    nodes_[0].first = 0;
+    nodes_[0].count = static_cast<int>(count);
+    split(0, 0);
+
+    for (Node& node : nodes_) {
+        compute_moments(node);
+    }
+}
+
+void GravityOctree::split(int node, int level) {
+    const int first = nodes_[node].first;
+    const int count = nodes_[node].count;
+    nodes_[node].child = -1;
+    nodes_[node].child_count = 0;
+    if (count <= leaf_size_ || level >= kMaxDepth) {
+        leaves_.push_back(node);
+        return;
+    }
+
+    // Bodies are sorted, so each 3-bit digit at this level is one run
+    const int shift = 3 * (kMaxDepth - 1 - level);
+    int bounds[9];
+    int children = 0;
+    for (int k = first; k < first + count; ++k) {
+        if (k == first || ((keys_[k] ^ keys_[k - 1]) >> shift) != 0) {
+            bounds[children++] = k;
+        }
+    }
+    bounds[children] = first + count;
+
+    const int child = static_cast<int>(nodes_.size());
+    nodes_.resize(nodes_.size() + children);
+    nodes_[node].child = child;
+    nodes_[node].child_count = children;
+    for (int c = 0; c < children; ++c) {
+        nodes_[child + c].first = bounds[c];
+        nodes_[child + c].count = bounds[c + 1] - bounds[c];
+    }
+    for (int c = 0; c < children; ++c) {
+        split(child + c, level + 1);
+    }
+}
+
+void GravityOctree::compute_moments(Node& node) const {
+    const int end = node.first + node.count;
+    double mass = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    for (int k = node.first; k < end; ++k) {
+        mass += mass_[k];
+        cx += mass_[k] * x_[k];
+        cy += mass_[k] * y_[k];
+        cz += mass_[k] * z_[k];
+    }
+    node.mass = mass;
+    if (mass > 0.0) {
+        cx /= mass;
+        cy /= mass;
+        cz /= mass;
+    } else {
+        cx = x_[node.first];
+        cy = y_[node.first];
+        cz = z_[node.first];
+    }
+    node.center[0] = cx;
+    node.center[1] = cy;
+    node.center[2] = cz;
+
+    double radius2 = 0.0;
+    std::fill(node.quadrupole, node.quadrupole + 6, 0.0);
+    for (int k = node.first; k < end; ++k) {
+        double dx = x_[k] - cx, dy = y_[k] - cy, dz = z_[k] - cz;
+        double d2 = dx * dx + dy * dy + dz * dz;
+        double m = mass_[k];
+        radius2 = std::max(radius2, d2);
+        node.quadrupole[0] += m * (3.0 * dx * dx - d2);
+        node.quadrupole[1] += m * (3.0 * dy * dy - d2);
+        node.quadrupole[2] += m * (3.0 * dz * dz - d2);
+        node.quadrupole[3] += m * 3.0 * dx * dy;
+        node.quadrupole[4] += m * 3.0 * dx * dz;
+        node.quadrupole[5] += m * 3.0 * dy * dz;
+    }
+    node.radius = std::sqrt(radius2);
+}
+
+void GravityOctree::accumulate(double* ax, double* ay, double* az, double opening_angle, double softening2,
+                               ThreadPool& pool, const unsigned char* active) {
+    const std::size_t count = mass_.size();
+    if (count == 0) return;
+    ax_.assign(count, 0.0);
+    ay_.assign(count, 0.0);
+    az_.assign(count, 0.0);
+    worker_lists_.resize(pool.get_thread_count());
+
+    const NBodyArrays arrays{x_.data(), y_.data(), z_.data(), mass_.data(), ax_.data(), ay_.data(), az_.data()};
+
+    // One leaf per task
+    pool.parallel_for(leaves_.size(), [&](std::size_t leaf, unsigned worker) {
+        const Node& group = nodes_[leaves_[leaf]];
+        const std::size_t begin = group.first;
+        const std::size_t end = begin + group.count;
+        if (active && std::none_of(order_.begin() + begin, order_.begin() + end,
+                                   [&](std::uint32_t i) { return active[i] != 0; })) {
+            return;
+        }
+
+        WalkLists& lists = worker_lists_[worker];
+        lists.cells.clear();
+        lists.leaves.clear();
+
+        // Cells far enough from every point within the leaf's extent are used
+        // whole; the stack holds at most seven siblings per level
+        int stack[7 * kMaxDepth + 8];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const int n = stack[--top];
+            const Node& node = nodes_[n];
+            double dx = node.center[0] - group.center[0];
+            double dy = node.center[1] - group.center[1];
+            double dz = node.center[2] - group.center[2];
+            double gap = std::sqrt(dx * dx + dy * dy + dz * dz) - group.radius;
+
+            if (gap > 0.0 && node.radius < opening_angle * gap) {
+                lists.cells.push_back(n);
+            } else if (node.child < 0) {
+                lists.leaves.push_back(n);
+            } else {
+                for (int c = 0; c < node.child_count; ++c) {
+                    stack[top++] = node.child + c;
+                }
+            }
+        }
+
+        // Near field body by body
+        for (int n : lists.leaves) {
+            const Node& source = nodes_[n];
+            accumulate_nbody(arrays, begin, end, source.first, source.first + source.count, softening2);
+        }
+
+        // Far field from monopole and quadrupole:
+        // a = -M d / r^3 + Q d / r^5 - 5/2 (d.Q d) d / r^7, d from the cell to the body
+        for (std::size_t i = begin; i < end; ++i) {
+            if (active && !active[order_[i]]) continue;
+            double sum_x = 0.0, sum_y = 0.0, sum_z = 0.0;
+            for (int n : lists.cells) {
+                const Node& node = nodes_[n];
+                double dx = x_[i] - node.center[0];
+                double dy = y_[i] - node.center[1];
+                double dz = z_[i] - node.center[2];
+                double inv_r = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + softening2);
+                double inv_r2 = inv_r * inv_r;
+                double inv_r3 = inv_r * inv_r2;
+                double inv_r5 = inv_r3 * inv_r2;
+
+                const double* q = node.quadrupole;
+                double qx = q[0] * dx + q[3] * dy + q[4] * dz;
+                double qy = q[3] * dx + q[1] * dy + q[5] * dz;
+                double qz = q[4] * dx + q[5] * dy + q[2] * dz;
+                double radial = -node.mass * inv_r3 - 2.5 * (dx * qx + dy * qy + dz * qz) * inv_r5 * inv_r2;
+                sum_x += radial * dx + qx * inv_r5;
+                sum_y += radial * dy + qy * inv_r5;
+                sum_z += radial * dz + qz * inv_r5;
+            }
+            ax[order_[i]] += ax_[i] + sum_x;
+            ay[order_[i]] += ay_[i] + sum_y;
+            az[order_[i]] += az_[i] + sum_z;
+        }
+    });
+}
+
+std::size_t GravityOctree::get_byte_size() const {
+    return nodes_.capacity() * sizeof(Node) + leaves_.capacity() * sizeof(int) +
+           keys_.capacity() * sizeof(std::uint64_t) + order_.capacity() * sizeof(std::uint32_t) +
+           (x_.capacity() + y_.capacity() + z_.capacity() + mass_.capacity() +
+            ax_.capacity() + ay_.capacity() + az_.capacity()) * sizeof(double);
+}
@@ -0,0 +1,80 @@
+#ifndef GRAVITYOCTREE_H
+#define GRAVITYOCTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Barnes-Hut octree over point masses, rebuilt from scratch for every force
+// evaluation.
+//
+// Bodies are sorted along a Morton (Z-order) curve of their positions in the
+// bounding cube, 21 bits per axis, and copied into planar arrays in that
+// order. Every cell then covers a contiguous range of bodies, found by
+// splitting on successive 3-bit digits of the keys. Nodes live in one pooled
+// array whose capacity is kept between builds; the children of a cell are
+// allocated next to each other.
+//
+// Cells store their mass, center of mass, extent (farthest body from the
+// center) and traceless quadrupole. The walk goes one leaf at a time: a cell
+// is used as a multipole when its extent is below opening_angle times its
+// distance to the nearest point the leaf's bodies could occupy, otherwise it is
+// opened. Leaves that cannot be used are summed body by body with the SIMD
+// pair kernels, since their bodies are contiguous. Leaves are walked in
+// parallel and each body's sum has a fixed order, so results do not depend on
+// the thread count.
+class GravityOctree {
+public:
+    static const int kMaxDepth = 21;
+
+    GravityOctree();
+
+    void build(const double* x, const double* y, const double* z, const double* mass,
+               std::size_t count, int leaf_size);
+
+    // Adds sum m (r_j - r_i) / (|r_j - r_i|^2 + softening2)^(3/2) over the
+    // other bodies, without G, to ax, ay and az, indexed like the input of build.
+    // With active flags only flagged bodies are written, and leaves without one
+    // are not walked.
+    void accumulate(double* ax, double* ay, double* az, double opening_angle, double softening2,
+                    ThreadPool& pool, const unsigned char* active = nullptr);
+
+    std::size_t size() const { return mass_.size(); }
+    std::size_t get_node_count() const { return nodes_.size(); }
+    std::size_t get_leaf_count() const { return leaves_.size(); }
+    std::size_t get_byte_size() const;
+
+private:
+    struct Node {
+        double center[3];      // Center of mass
+        double mass;
+        double quadrupole[6];  // sum m (3 d_i d_j - |d|^2 delta_ij): xx, yy, zz, xy, xz, yz
+        double radius;         // Farthest body from center
+        int first;             // Body range in Morton order
+        int count;
+        int child;             // First child, children are contiguous; -1 for leaves
+        int child_count;
+    };
+
+    // Per-worker interaction lists of one leaf walk
+    struct WalkLists {
+        std::vector<int> cells;
+        std::vector<int> leaves;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<int> leaves_;
+    std::vector<std::uint64_t> keys_;
+    std::vector<std::uint32_t> order_;   // Morton position to input index
+    std::vector<double> x_, y_, z_, mass_;
+    std::vector<double> ax_, ay_, az_;
+    std::vector<WalkLists> worker_lists_;
+    int leaf_size_;
+
+    void split(int node, int level);
+    void compute_moments(Node& node) const;
+};
+
+#endif
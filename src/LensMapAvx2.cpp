@@ -0,0 +1,93 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "LensMapKernel.h"
+#include <immintrin.h>
+#include <cstdint>
+
+namespace {
+
+// Eight half floats starting at the 16-bit plane entries in index; each gather
+// reads 32 bits, which the padding entry at the end of the plane allows
+inline __m256 gather_half(const void* plane, __m256i index) {
+    __m256i words = _mm256_i32gather_epi32(static_cast<const int*>(plane), index, 2);
+    words = _mm256_and_si256(words, _mm256_set1_epi32(0xffff));
+    // Pack the low halves into the first 128 bits, in order
+    __m256i packed = _mm256_packus_epi32(words, words);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    return _mm256_cvtph_ps(_mm256_castsi256_si128(packed));
+}
+
+inline __m256 gather(const LensMapView& map, const void* plane, __m256i index) {
+    return map.half ? gather_half(plane, index)
+                    : _mm256_i32gather_ps(static_cast<const float*>(plane), index, 4);
+}
+
+inline __m256 bilinear(const LensMapView& map, const void* plane, __m256i i00, __m256i stride,
+                       __m256 fx, __m256 fy) {
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256 v00 = gather(map, plane, i00);
+    __m256 v01 = gather(map, plane, _mm256_add_epi32(i00, one));
+    __m256 v10 = gather(map, plane, _mm256_add_epi32(i00, stride));
+    __m256 v11 = gather(map, plane, _mm256_add_epi32(i00, _mm256_add_epi32(stride, one)));
+    __m256 v0 = _mm256_fmadd_ps(fy, _mm256_sub_ps(v01, v00), v00);
+    __m256 v1 = _mm256_fmadd_ps(fy, _mm256_sub_ps(v11, v10), v10);
+    return _mm256_fmadd_ps(fx, _mm256_sub_ps(v1, v0), v0);
+}
+
+}
+
+std::size_t lookup_lens_map_avx2(const LensMapView& map, const LensLookupBatch& batch, std::size_t count) {
+    const std::size_t full = count & ~static_cast<std::size_t>(7);
+    const int n = map.resolution;
+
+    const __m256 half_n = _mm256_set1_ps(0.5f * n);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 last = _mm256_set1_ps(static_cast<float>(n - 1));
+    const __m256i last_cell = _mm256_set1_epi32(n - 2);
+    const __m256i stride = _mm256_set1_epi32(n);
+
+    for (std::size_t k = 0; k < full; k += 8) {
+        // Grid coordinates, clamped to the map
+        __m256 gx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(batch.screen_x + k), one), half_n);
+        __m256 gy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(batch.screen_y + k), one), half_n);
+        gx = _mm256_min_ps(_mm256_max_ps(gx, _mm256_setzero_ps()), last);
+        gy = _mm256_min_ps(_mm256_max_ps(gy, _mm256_setzero_ps()), last);
+
+        __m256i x0 = _mm256_min_epi32(_mm256_cvttps_epi32(gx), last_cell);
+        __m256i y0 = _mm256_min_epi32(_mm256_cvttps_epi32(gy), last_cell);
+        __m256 fx = _mm256_sub_ps(gx, _mm256_cvtepi32_ps(x0));
+        __m256 fy = _mm256_sub_ps(gy, _mm256_cvtepi32_ps(y0));
+        __m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(x0, stride), y0);
+
+        _mm256_storeu_ps(batch.deflection_x + k, bilinear(map, map.deflection_x, i00, stride, fx, fy));
+        _mm256_storeu_ps(batch.deflection_y + k, bilinear(map, map.deflection_y, i00, stride, fx, fy));
+        if (batch.magnification) {
+            _mm256_storeu_ps(batch.magnification + k, bilinear(map, map.magnification, i00, stride, fx, fy));
+        }
+    }
+    return full;
+}
+
+std::size_t lens_jacobian_row_avx2(const LensJacobianRow& row, std::size_t count) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 inv_row = _mm256_set1_ps(row.inv_row_distance);
+    const __m256 inv_along = _mm256_set1_ps(0.5f * row.inv_spacing);
+
+    std::size_t j = 1;
+    for (; j + 8 < count; j += 8) {
+        __m256 dxx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.x_next + j),
+                                                 _mm256_loadu_ps(row.x_prev + j)), inv_row);
+        __m256 dyx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.y_next + j),
+                                                 _mm256_loadu_ps(row.y_prev + j)), inv_row);
+        __m256 dxy = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.x_row + j + 1),
+                                                 _mm256_loadu_ps(row.x_row + j - 1)), inv_along);
+        __m256 dyy = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row.y_row + j + 1),
+                                                 _mm256_loadu_ps(row.y_row + j - 1)), inv_along);
+        __m256 det = _mm256_fmsub_ps(_mm256_add_ps(one, dxx), _mm256_add_ps(one, dyy),
+                                     _mm256_mul_ps(dxy, dyx));
+        _mm256_storeu_ps(row.determinant + j, det);
+    }
+    return j;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef LENSMAPKERNEL_H
+#define LENSMAPKERNEL_H
+
+#include <cstddef>
+
+// Plain-data interface between GravitationalLensing and the per-ISA lens map
+// lookup kernels, which are compiled with ISA-specific flags.
+
+// Planes are float, or binary16 when half is set
+struct LensMapView {
+    int resolution;
+    bool half;
+    const void* deflection_x;
+    const void* deflection_y;
+    const void* magnification;
+};
+
+// Planar batch of lookups; magnification may be null
+struct LensLookupBatch {
+    const float* screen_x;
+    const float* screen_y;
+    float* deflection_x;
+    float* deflection_y;
+    float* magnification;
+};
+
+// One map row of the lens equation Jacobian det(I + d deflection / d screen).
+// prev and next are the neighbouring rows, or the row itself at the map edge;
+// derivatives along the row are central inside and one-sided at its ends.
+struct LensJacobianRow {
+    const float* x_prev;
+    const float* x_row;
+    const float* x_next;
+    const float* y_prev;
+    const float* y_row;
+    const float* y_next;
+    float inv_row_distance;  // 1 / screen distance from prev to next
+    float inv_spacing;       // 1 / screen distance between points of a row
+    float* determinant;
+};
+
+// Bilinear lookup of screen positions in [-1, 1], clamped to the map edge
+void lookup_lens_map_scalar(const LensMapView& map, const LensLookupBatch& batch,
+                            std::size_t begin, std::size_t end);
+
+// Points 0 and [begin, count) of a row of count >= 2 points
+void lens_jacobian_row_scalar(const LensJacobianRow& row, std::size_t begin, std::size_t count);
+
+// Whole row with the widest kernel this CPU runs
+void lens_jacobian_row(const LensJacobianRow& row, std::size_t count);
+
+// Signed magnification 1 / det, capped in magnitude where det vanishes
+void lens_magnification_row(const float* determinant, float* magnification, std::size_t count);
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+// Handles count rounded down to a multiple of 8 and returns how many it did
+std::size_t lookup_lens_map_avx2(const LensMapView& map, const LensLookupBatch& batch, std::size_t count);
+
+// Interior points from 1 in blocks of 8; returns the first point it did not do
+std::size_t lens_jacobian_row_avx2(const LensJacobianRow& row, std::size_t count);
+#endif
+
+#endif
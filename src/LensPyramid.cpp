@@ -0,0 +1,179 @@
+#include "LensPyramid.h"
+#include "GravitationalLensing.h"
+#include "LensMapKernel.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+LensPyramid::LensPyramid() : base_resolution_(0), tile_size_(0) {}
+
+void LensPyramid::clear() {
+    levels_.clear();
+}
+
+void LensPyramid::build(const LensMap& base, const LensPyramidSettings& settings, ThreadPool& pool,
+                        const TraceFunction& trace) {
+    clear();
+    base_resolution_ = base.get_resolution();
+    tile_size_ = std::clamp(settings.tile_size & ~1, 2, kMaxTileSize);
+    if (settings.levels <= 0 || base_resolution_ < 2) return;
+
+    const int T = tile_size_;
+    const int half = T / 2;
+    const std::size_t points = tile_points();
+    // Bilinear interpolation misses by about an eighth of the second difference
+    const double refine_difference = 8.0 * settings.refine_threshold;
+
+    auto tiles_for = [T](int resolution) { return std::max(1, (resolution - 2) / T + 1); };
+
+    for (int l = 1; l <= settings.levels; ++l) {
+        const int parent_resolution = base_resolution_ << (l - 1);
+        const int parent_tiles = tiles_for(parent_resolution);
+        const Level* parent = l > 1 ? &levels_.back() : nullptr;
+
+        Level level;
+        level.resolution = base_resolution_ << l;
+        level.tiles_per_side = tiles_for(level.resolution);
+        level.slots.assign(static_cast<std::size_t>(level.tiles_per_side) * level.tiles_per_side, -1);
+
+        // Mark the children of every quadrant of a parent tile that bends too fast
+        std::vector<int> candidates;
+        for (int px = 0; px < parent_tiles; ++px) {
+            for (int py = 0; py < parent_tiles; ++py) {
+                int parent_slot = -1;
+                if (parent) {
+                    parent_slot = parent->slots[static_cast<std::size_t>(px) * parent_tiles + py];
+                    if (parent_slot < 0) continue;
+                }
+
+                // Parent value at local point (a, b) of this tile
+                auto value = [&](int a, int b) {
+                    if (parent) {
+                        std::size_t k = parent_slot * points + static_cast<std::size_t>(a) * (T + 1) + b;
+                        return Eigen::Vector2d(parent->deflection_x[k], parent->deflection_y[k]);
+                    }
+                    int i = std::min(px * T + a, base_resolution_ - 1);
+                    int j = std::min(py * T + b, base_resolution_ - 1);
+                    return base.get_deflection(static_cast<std::size_t>(i) * base_resolution_ + j);
+                };
+
+                for (int q = 0; q < 4; ++q) {
+                    int tx = 2 * px + (q & 1);
+                    int ty = 2 * py + (q >> 1);
+                    if (tx >= level.tiles_per_side || ty >= level.tiles_per_side) continue;
+
+                    int a0 = std::max(1, (q & 1) * half), a1 = std::min(T - 1, (q & 1) * half + half);
+                    int b0 = std::max(1, (q >> 1) * half), b1 = std::min(T - 1, (q >> 1) * half + half);
+                    bool refine = false;
+                    for (int a = a0; a <= a1 && !refine; ++a) {
+                        for (int b = b0; b <= b1 && !refine; ++b) {
+                            Eigen::Vector2d center = value(a, b);
+                            double dxx = (value(a + 1, b) - 2.0 * center + value(a - 1, b)).norm();
+                            double dyy = (value(a, b + 1) - 2.0 * center + value(a, b - 1)).norm();
+                            refine = std::max(dxx, dyy) > refine_difference;
+                        }
+                    }
+                    if (refine) {
+                        std::size_t tile = static_cast<std::size_t>(tx) * level.tiles_per_side + ty;
+                        level.slots[tile] = static_cast<int>(candidates.size());
+                        candidates.push_back(static_cast<int>(tile));
+                    }
+                }
+            }
+        }
+        if (candidates.empty()) break;
+
+        level.deflection_x.assign(candidates.size() * points, 0.0f);
+        level.deflection_y.assign(candidates.size() * points, 0.0f);
+        level.magnification.assign(candidates.size() * points, 0.0f);
+
+        // One tile per task
+        const float spacing = 2.0f / level.resolution;
+        pool.parallel_for(candidates.size(), [&](std::size_t slot, unsigned) {
+            int tx = candidates[slot] / level.tiles_per_side;
+            int ty = candidates[slot] % level.tiles_per_side;
+            float* x = level.deflection_x.data() + slot * points;
+            float* y = level.deflection_y.data() + slot * points;
+            float* magnification = level.magnification.data() + slot * points;
+            for (int a = 0; a <= T; ++a) {
+                for (int b = 0; b <= T; ++b) {
+                    Eigen::Vector2d screen_pos(2.0 * (tx * T + a) / level.resolution - 1.0,
+                                               2.0 * (ty * T + b) / level.resolution - 1.0);
+                    Eigen::Vector2d deflection = trace(screen_pos);
+                    x[a * (T + 1) + b] = static_cast<float>(deflection.x());
+                    y[a * (T + 1) + b] = static_cast<float>(deflection.y());
+                }
+            }
+
+            // Signed magnification from the tile's Jacobian, one-sided at its edges
+            float determinant[kMaxTileSize + 1];
+            for (int a = 0; a <= T; ++a) {
+                int prev = std::max(a - 1, 0), next = std::min(a + 1, T);
+                LensJacobianRow row{x + prev * (T + 1), x + a * (T + 1), x + next * (T + 1),
+                                    y + prev * (T + 1), y + a * (T + 1), y + next * (T + 1),
+                                    1.0f / (spacing * (next - prev)), 1.0f / spacing, determinant};
+                lens_jacobian_row(row, T + 1);
+                lens_magnification_row(determinant, magnification + a * (T + 1), T + 1);
+            }
+        });
+
+        levels_.push_back(std::move(level));
+    }
+}
+
+std::size_t LensPyramid::get_tile_count(int level) const {
+    if (level < 1 || level > get_level_count()) return 0;
+    return levels_[level - 1].deflection_x.size() / tile_points();
+}
+
+std::size_t LensPyramid::get_byte_size() const {
+    std::size_t bytes = 0;
+    for (const Level& level : levels_) {
+        bytes += level.slots.size() * sizeof(int);
+        bytes += (level.deflection_x.size() + level.deflection_y.size() + level.magnification.size()) *
+                 sizeof(float);
+    }
+    return bytes;
+}
+
+int LensPyramid::select_level(double footprint) const {
+    const int finest = get_level_count();
+    if (footprint <= 0.0 || base_resolution_ < 2) return finest;
+    // Level l has a spacing of 2 / (base_resolution * 2^l)
+    double level = std::floor(std::log2(2.0 / (base_resolution_ * footprint)));
+    return static_cast<int>(std::clamp(level, 0.0, static_cast<double>(finest)));
+}
+
+bool LensPyramid::lookup(double screen_x, double screen_y, int level,
+                         Eigen::Vector2d& deflection, double& magnification) const {
+    const int T = tile_size_;
+    for (int l = std::min(level, get_level_count()); l >= 1; --l) {
+        const Level& lv = levels_[l - 1];
+        const double last = lv.resolution - 1;
+        double gx = std::clamp((screen_x + 1.0) * 0.5 * lv.resolution, 0.0, last);
+        double gy = std::clamp((screen_y + 1.0) * 0.5 * lv.resolution, 0.0, last);
+        int tx = std::min(static_cast<int>(gx) / T, lv.tiles_per_side - 1);
+        int ty = std::min(static_cast<int>(gy) / T, lv.tiles_per_side - 1);
+
+        int slot = lv.slots[static_cast<std::size_t>(tx) * lv.tiles_per_side + ty];
+        if (slot < 0) continue;
+
+        double u = gx - tx * T;
+        double v = gy - ty * T;
+        int a = std::min(static_cast<int>(u), T - 1);
+        int b = std::min(static_cast<int>(v), T - 1);
+        double fx = u - a;
+        double fy = v - b;
+
+        std::size_t k = slot * tile_points() + static_cast<std::size_t>(a) * (T + 1) + b;
+        auto bilinear = [&](const std::vector<float>& plane) {
+            double v0 = plane[k] + fy * (plane[k + 1] - plane[k]);
+            double v1 = plane[k + T + 1] + fy * (plane[k + T + 2] - plane[k + T + 1]);
+            return v0 + fx * (v1 - v0);
+        };
+        deflection = Eigen::Vector2d(bilinear(lv.deflection_x), bilinear(lv.deflection_y));
+        magnification = bilinear(lv.magnification);
+        return true;
+    }
+    return false;
+}
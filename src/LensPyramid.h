@@ -0,0 +1,82 @@
+#ifndef LENSPYRAMID_H
+#define LENSPYRAMID_H
+
+#include <Eigen/Dense>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+class LensMap;
+class ThreadPool;
+
+struct LensPyramidSettings {
+    int levels;               // Refinement levels above the base map, 0 disables
+    int tile_size;            // Cells per tile edge, even, at most LensPyramid::kMaxTileSize
+    double refine_threshold;  // Predicted bilinear error, in screen units, that refines a tile
+
+    LensPyramidSettings() :
+        levels(0),
+        tile_size(16),
+        refine_threshold(2e-4) {}
+};
+
+// Sparse refinement levels on top of a dense lens map.
+//
+// Level l has the grid spacing of a dense map with base_resolution * 2^l points
+// per side, but only stores square tiles of tile_size cells (tile_size + 1
+// points per side, planar like LensMap) where the level below varies quickly.
+// The bilinear error of a level is predicted from its second differences, about
+// one eighth of them, and the four child tiles over a tile region are traced
+// when that exceeds refine_threshold. Far-field deflection stays on the base map
+// while the shadow edge and the Einstein ring go down to the finest level. Tile
+// magnification comes from the Jacobian of the tile's own deflection, as for
+// the base map.
+//
+// Lookups take a footprint, the screen extent of the query (2 / pixels across
+// for one pixel), and use the coarsest level at least as fine as it, falling
+// back to coarser levels where no tile was allocated.
+class LensPyramid {
+public:
+    static constexpr int kMaxTileSize = 256;
+
+    using TraceFunction = std::function<Eigen::Vector2d(const Eigen::Vector2d& screen_pos)>;
+
+    LensPyramid();
+
+    // Rebuilds every level above base; tiles are traced on pool
+    void build(const LensMap& base, const LensPyramidSettings& settings, ThreadPool& pool,
+               const TraceFunction& trace);
+    void clear();
+
+    int get_level_count() const { return static_cast<int>(levels_.size()); }
+    std::size_t get_tile_count(int level) const;  // Level 1 and up
+    std::size_t get_byte_size() const;
+
+    // Level a query of this footprint would like; 0 is the base map
+    int select_level(double footprint) const;
+
+    // Bilinear value from the finest allocated level at or below level; false
+    // when only the base map covers the point
+    bool lookup(double screen_x, double screen_y, int level,
+                Eigen::Vector2d& deflection, double& magnification) const;
+
+private:
+    struct Level {
+        int resolution;           // Points per side of the equivalent dense map
+        int tiles_per_side;
+        std::vector<int> slots;   // Tile index to storage slot, -1 where not refined
+        std::vector<float> deflection_x;
+        std::vector<float> deflection_y;
+        std::vector<float> magnification;
+    };
+
+    int base_resolution_;
+    int tile_size_;
+    std::vector<Level> levels_;   // levels_[l - 1] is level l
+
+    std::size_t tile_points() const {
+        return static_cast<std::size_t>(tile_size_ + 1) * (tile_size_ + 1);
+    }
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include "LensTree.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Binomial coefficients C(n, k) for the multipole to local shift
+struct BinomialTable {
+    double value[2 * LensTree::kMaxOrder][2 * LensTree::kMaxOrder];
+
+    BinomialTable() {
+        for (int n = 0; n < 2 * LensTree::kMaxOrder; ++n) {
+            value[n][0] = 1.0;
+            for (int k = 1; k <= n; ++k) {
+                value[n][k] = value[n - 1][k - 1] + (k < n ? value[n - 1][k] : 0.0);
+            }
+            for (int k = n + 1; k < 2 * LensTree::kMaxOrder; ++k) {
+                value[n][k] = 0.0;
+            }
+        }
+    }
+};
+
+const BinomialTable kBinomial;
+
+}
+
+LensTree::LensTree() : order_(1), opening_angle_(0.5) {}
+
+void LensTree::clear() {
+    nodes_.clear();
+    moments_.clear();
+    x_.clear();
+    y_.clear();
+    strength_.clear();
+}
+
+void LensTree::build(const std::vector<ScreenLens>& lenses, const LensTreeSettings& settings) {
+    clear();
+    order_ = std::clamp(settings.expansion_order, 1, kMaxOrder);
+    opening_angle_ = std::max(settings.opening_angle, 0.0);
+    const int leaf_size = std::max(settings.leaf_size, 1);
+
+    std::vector<ScreenLens> sorted;
+    sorted.reserve(lenses.size());
+    for (const ScreenLens& lens : lenses) {
+        if (lens.strength > 0.0 && std::isfinite(lens.strength) && lens.position.allFinite()) {
+            sorted.push_back(lens);
+        }
+    }
+    if (sorted.empty()) return;
+
+    Eigen::Vector2d low = sorted.front().position;
+    Eigen::Vector2d high = low;
+    for (const ScreenLens& lens : sorted) {
+        low = low.cwiseMin(lens.position);
+        high = high.cwiseMax(lens.position);
+    }
+
+    // Square cell bounds, only needed while splitting
+    struct Cell {
+        Eigen::Vector2d middle;
+        double half_size;
+        int depth;
+    };
+    std::vector<Cell> cells;
+    cells.push_back({0.5 * (low + high), 0.5 * (high - low).maxCoeff(), 0});
+    nodes_.push_back({Eigen::Vector2d::Zero(), 0.0, 0, static_cast<int>(sorted.size()), -1, 0});
+
+    // Breadth first, so the children of a node are appended next to each other
+    for (std::size_t n = 0; n < nodes_.size(); ++n) {
+        const Cell cell = cells[n];
+        const int first = nodes_[n].first;
+        const int count = nodes_[n].count;
+        if (count <= leaf_size || cell.depth >= kMaxDepth || cell.half_size <= 0.0) continue;
+
+        // Split the range by x, then each half by y
+        auto begin = sorted.begin() + first;
+        auto end = begin + count;
+        auto below_x = [&](const ScreenLens& lens) { return lens.position.x() < cell.middle.x(); };
+        auto below_y = [&](const ScreenLens& lens) { return lens.position.y() < cell.middle.y(); };
+        auto split_x = std::partition(begin, end, below_x);
+        const std::vector<ScreenLens>::iterator edges[5] = {
+            begin, std::partition(begin, split_x, below_y), split_x, std::partition(split_x, end, below_y), end};
+
+        // Quadrant q holds x above the middle for q & 2 and y above it for q & 1
+        nodes_[n].child = static_cast<int>(nodes_.size());
+        for (int q = 0; q < 4; ++q) {
+            int child_first = static_cast<int>(edges[q] - sorted.begin());
+            int child_count = static_cast<int>(edges[q + 1] - edges[q]);
+            if (child_count == 0) continue;
+
+            double quarter = 0.5 * cell.half_size;
+            Eigen::Vector2d middle = cell.middle + Eigen::Vector2d(q & 2 ? quarter : -quarter,
+                                                                   q & 1 ? quarter : -quarter);
+            cells.push_back({middle, quarter, cell.depth + 1});
+            nodes_.push_back({Eigen::Vector2d::Zero(), 0.0, child_first, child_count, -1, 0});
+            ++nodes_[n].child_count;
+        }
+    }
+
+    x_.resize(sorted.size());
+    y_.resize(sorted.size());
+    strength_.resize(sorted.size());
+    for (std::size_t i = 0; i < sorted.size(); ++i) {
+        x_[i] = sorted[i].position.x();
+        y_[i] = sorted[i].position.y();
+        strength_[i] = sorted[i].strength;
+    }
+
+    // Centroid, extent and moments of every cell, straight from its lenses
+    moments_.assign(nodes_.size() * order_, std::complex<double>(0.0, 0.0));
+    for (std::size_t n = 0; n < nodes_.size(); ++n) {
+        Node& node = nodes_[n];
+        double total = 0.0;
+        Eigen::Vector2d weighted = Eigen::Vector2d::Zero();
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            total += strength_[i];
+            weighted += strength_[i] * Eigen::Vector2d(x_[i], y_[i]);
+        }
+        node.center = weighted / total;
+
+        std::complex<double>* moments = moments_.data() + n * order_;
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            std::complex<double> offset(x_[i] - node.center.x(), y_[i] - node.center.y());
+            node.radius = std::max(node.radius, std::abs(offset));
+            std::complex<double> term = strength_[i];
+            for (int k = 0; k < order_; ++k) {
+                moments[k] += term;
+                term *= offset;
+            }
+        }
+    }
+}
+
+Eigen::Vector2d LensTree::sum_range(double x, double y, int first, int count) const {
+    double dx_sum = 0.0, dy_sum = 0.0;
+    for (int i = first; i < first + count; ++i) {
+        double dx = x_[i] - x;
+        double dy = y_[i] - y;
+        double r2 = dx * dx + dy * dy;
+        if (r2 > 0.0) {
+            double scale = strength_[i] / r2;
+            dx_sum += scale * dx;
+            dy_sum += scale * dy;
+        }
+    }
+    return Eigen::Vector2d(dx_sum, dy_sum);
+}
+
+Eigen::Vector2d LensTree::deflection(const Eigen::Vector2d& screen_pos) const {
+    if (nodes_.empty()) return Eigen::Vector2d::Zero();
+    const int root = 0;
+    std::complex<double> field(0.0, 0.0);
+    Eigen::Vector2d direct = walk(screen_pos.x(), screen_pos.y(), &root, 1, field);
+    return direct + Eigen::Vector2d(-field.real(), field.imag());
+}
+
+Eigen::Vector2d LensTree::walk(double x, double y, const int* start, std::size_t start_count,
+                               std::complex<double>& field) const {
+    const double opening2 = opening_angle_ * opening_angle_;
+    Eigen::Vector2d direct = Eigen::Vector2d::Zero();
+
+    for (std::size_t s = 0; s < start_count; ++s) {
+        // Each level leaves at most three siblings on the stack
+        int stack[3 * kMaxDepth + 4];
+        int top = 0;
+        stack[top++] = start[s];
+        while (top > 0) {
+            const int n = stack[--top];
+            const Node& node = nodes_[n];
+            double dx = x - node.center.x();
+            double dy = y - node.center.y();
+            
+            if (node.radius * node.radius < opening2 * (dx * dx + dy * dy)) {
+                add_expansion(n, dx, dy, field);
+            } else if (node.child < 0) {
+                direct += sum_range(x, y, node.first, node.count);
+            } else {
+                for (int c = 0; c < node.child_count; ++c) {
+                    stack[top++] = node.child + c;
+                }
+            }
+        }
+    }
+    return direct;
+}
+
+void LensTree::add_expansion(int node, double dx, double dy, std::complex<double>& field) const {
+    // F = sum a_k / w^(k + 1), w = z - c
+    double distance2 = dx * dx + dy * dy;
+    std::complex<double> inverse(dx / distance2, -dy / distance2);
+    std::complex<double> power = inverse;
+    const std::complex<double>* moments = moments_.data() + static_cast<std::size_t>(node) * order_;
+    for (int k = 0; k < order_; ++k) {
+        field += moments[k] * power;
+        power *= inverse;
+    }
+}
+
+void LensTree::deflection(const double* x, const double* y, double* deflection_x, double* deflection_y,
+                          std::size_t count) const {
+    if (count == 0) return;
+    if (nodes_.empty() || count == 1) {
+        for (std::size_t p = 0; p < count; ++p) {
+            Eigen::Vector2d d = deflection(Eigen::Vector2d(x[p], y[p]));
+            deflection_x[p] = d.x();
+            deflection_y[p] = d.y();
+        }
+        return;
+    }
+
+    // Bounding circle of the batch
+    double low_x = x[0], high_x = x[0], low_y = y[0], high_y = y[0];
+    for (std::size_t p = 1; p < count; ++p) {
+        low_x = std::min(low_x, x[p]);
+        high_x = std::max(high_x, x[p]);
+        low_y = std::min(low_y, y[p]);
+        high_y = std::max(high_y, y[p]);
+    }
+    const double center_x = 0.5 * (low_x + high_x);
+    const double center_y = 0.5 * (low_y + high_y);
+    const double batch_radius = 0.5 * std::hypot(high_x - low_x, high_y - low_y);
+    const double opening2 = opening_angle_ * opening_angle_;
+
+    // Local expansion b_m about the batch center from every well separated cell;
+    // 1 / (w + h)^(k + 1) = sum_m C(k + m, m) (-h)^m / w^(k + m + 1)
+    std::complex<double> local[kMaxOrder] = {};
+    std::vector<int> near;
+
+    int stack[3 * kMaxDepth + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const int n = stack[--top];
+        const Node& node = nodes_[n];
+        double dx = center_x - node.center.x();
+        double dy = center_y - node.center.y();
+        double distance2 = dx * dx + dy * dy;
+        double extent = node.radius + batch_radius;
+
+        if (extent * extent < opening2 * distance2) {
+            std::complex<double> inverse(dx / distance2, -dy / distance2);
+            std::complex<double> inverse_powers[2 * kMaxOrder];
+            inverse_powers[0] = inverse;
+            for (int k = 1; k < 2 * order_; ++k) {
+                inverse_powers[k] = inverse_powers[k - 1] * inverse;
+            }
+            const std::complex<double>* moments = moments_.data() + static_cast<std::size_t>(n) * order_;
+            for (int m = 0; m < order_; ++m) {
+                std::complex<double> term(0.0, 0.0);
+                for (int k = 0; k < order_; ++k) {
+                    term += kBinomial.value[k + m][m] * moments[k] * inverse_powers[k + m];
+                }
+                local[m] += (m & 1) ? -term : term;
+            }
+        } else if (node.child < 0 || node.radius <= batch_radius) {
+            near.push_back(n);
+        } else {
+            for (int c = 0; c < node.child_count; ++c) {
+                stack[top++] = node.child + c;
+            }
+        }
+    }
+
+    // Cells near the batch and no larger than it are walked from each point
+    for (std::size_t p = 0; p < count; ++p) {
+        std::complex<double> h(x[p] - center_x, y[p] - center_y);
+        std::complex<double> field = local[order_ - 1];
+        for (int m = order_ - 2; m >= 0; --m) {
+            field = field * h + local[m];
+        }
+
+        Eigen::Vector2d direct = walk(x[p], y[p], near.data(), near.size(), field);
+        deflection_x[p] = direct.x() - field.real();
+        deflection_y[p] = direct.y() + field.imag();
+    }
+}
+
+Eigen::Vector2d LensTree::direct_deflection(const Eigen::Vector2d& screen_pos) const {
+    return sum_range(screen_pos.x(), screen_pos.y(), 0, static_cast<int>(strength_.size()));
+}
+
+std::size_t LensTree::get_byte_size() const {
+    return nodes_.size() * sizeof(Node) + moments_.size() * sizeof(std::complex<double>) +
+           (x_.size() + y_.size() + strength_.size()) * sizeof(double);
+}
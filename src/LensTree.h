@@ -0,0 +1,100 @@
+#ifndef LENSTREE_H
+#define LENSTREE_H
+
+#include <Eigen/Dense>
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Point lens in the screen plane. strength is the squared Einstein radius in
+// screen units, so the lens deflects a ray at distance r by strength / r.
+struct ScreenLens {
+    Eigen::Vector2d position;
+    double strength;
+};
+
+struct LensTreeSettings {
+    double opening_angle;  // Cell radius over distance below which its expansion is used, 0 sums directly
+    int expansion_order;   // Multipole terms kept, 1 is monopole only, at most LensTree::kMaxOrder
+    int leaf_size;         // Lenses a cell may hold before it is split
+
+    LensTreeSettings() :
+        opening_angle(0.5),
+        expansion_order(6),
+        leaf_size(16) {}
+};
+
+// Barnes-Hut quadtree over many screen-plane point lenses.
+//
+// The thin-lens deflection of N point masses is d(z) = -conj(F(z)) with
+// F(z) = sum s_i / (z - z_i) in complex screen coordinates. Every cell stores the
+// multipole moments a_k = sum s_i (z_i - c)^k about its strength-weighted
+// centroid c, for which a_1 vanishes, so far from the cell
+// F(z) = sum a_k / (z - c)^(k + 1). A query walks the tree and uses a cell's
+// expansion once all its lenses lie within opening_angle times the distance to
+// the cell; the truncation error then falls as opening_angle^expansion_order.
+// Leaves that are too close are summed directly. A query costs O(log N) cell
+// visits for N lenses instead of O(N).
+//
+// Batched queries share the walk between nearby points: cells far from the
+// whole batch are shifted into one local expansion about the batch center,
+// F(z0 + h) = sum b_m h^m, which every point then evaluates in order terms, and
+// each point walks on from the cells near the batch that are no larger than it.
+// Batches of a few neighbouring map points make the far field almost free.
+//
+// Lenses are reordered so every cell covers a contiguous range of the planar
+// position and strength arrays. The tree is immutable once built and may be
+// queried from any number of threads.
+class LensTree {
+public:
+    static constexpr int kMaxOrder = 16;
+    static const int kMaxDepth = 48;
+
+    LensTree();
+
+    // Lenses with non-positive or non-finite strength are dropped
+    void build(const std::vector<ScreenLens>& lenses, const LensTreeSettings& settings = LensTreeSettings());
+    void clear();
+
+    Eigen::Vector2d deflection(const Eigen::Vector2d& screen_pos) const;
+
+    // count points, planar; cheapest when the points are close together
+    void deflection(const double* x, const double* y, double* deflection_x, double* deflection_y,
+                    std::size_t count) const;
+
+    // Exact sum over every lens, for checking the opening angle
+    Eigen::Vector2d direct_deflection(const Eigen::Vector2d& screen_pos) const;
+
+    bool empty() const { return strength_.empty(); }
+    std::size_t size() const { return strength_.size(); }
+    std::size_t get_node_count() const { return nodes_.size(); }
+    std::size_t get_byte_size() const;
+
+private:
+    struct Node {
+        Eigen::Vector2d center;    // Strength-weighted centroid
+        double radius;             // Farthest lens from center
+        int first;                 // Lens range
+        int count;
+        int child;                 // First child, children are contiguous; -1 for leaves
+        int child_count;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<std::complex<double>> moments_;  // order_ per node, a_0 first
+    std::vector<double> x_;
+    std::vector<double> y_;
+    std::vector<double> strength_;
+    int order_;
+    double opening_angle_;
+
+    Eigen::Vector2d sum_range(double x, double y, int first, int count) const;
+    void add_expansion(int node, double dx, double dy, std::complex<double>& field) const;
+
+    // Barnes-Hut walk below the start cells; returns the direct part and adds
+    // expansions to field
+    Eigen::Vector2d walk(double x, double y, const int* start, std::size_t start_count,
+                         std::complex<double>& field) const;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "LensedEnvironment.h"
+#include "BlackHole.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Face f looks along axis f / 2, positive for even f; texel columns run along
+// the next axis and rows along the one after
+inline int face_axis(int face) { return face >> 1; }
+inline double face_sign(int face) { return (face & 1) ? -1.0 : 1.0; }
+
+}
+
+LensedEnvironment::LensedEnvironment()
+    : face_size_(0),
+      observer_(Eigen::Vector3d::Zero()),
+      mass_(0.0),
+      spin_(0.0),
+      disk_inner_radius_(0.0),
+      disk_outer_radius_(0.0) {}
+
+void LensedEnvironment::reset(const BlackHoleParameters& params, const Eigen::Vector3d& observer,
+                              int face_size) {
+    face_size_ = std::max(2, face_size);
+    observer_ = observer;
+    mass_ = params.mass;
+    spin_ = params.spin;
+    disk_inner_radius_ = params.accretion_disk_inner_radius;
+    disk_outer_radius_ = params.accretion_disk_outer_radius;
+
+    const std::size_t count = get_texel_count();
+    direction_x_.assign(count, 0.0f);
+    direction_y_.assign(count, 0.0f);
+    direction_z_.assign(count, 0.0f);
+    disk_radius_.assign(count, 0.0f);
+    angular_momentum_.assign(count, 0.0f);
+    termination_.assign(count, static_cast<std::uint8_t>(GeodesicTermination::MaxSteps));
+    disk_crossings_.assign(count, 0);
+}
+
+bool LensedEnvironment::matches(const BlackHoleParameters& params, const Eigen::Vector3d& observer,
+                                int face_size, double tolerance) const {
+    return is_valid() && face_size_ == std::max(2, face_size) && params.mass == mass_ && params.spin == spin_ &&
+           params.accretion_disk_inner_radius == disk_inner_radius_ &&
+           params.accretion_disk_outer_radius == disk_outer_radius_ &&
+           (observer - observer_).norm() <= tolerance;
+}
+
+Eigen::Vector3d LensedEnvironment::texel_direction(std::size_t index) const {
+    const std::size_t face_texels = static_cast<std::size_t>(face_size_) * face_size_;
+    int face = static_cast<int>(index / face_texels);
+    int row = static_cast<int>(index % face_texels) / face_size_;
+    int column = static_cast<int>(index % face_texels) % face_size_;
+
+    int a = face_axis(face);
+    Eigen::Vector3d direction;
+    direction[a] = face_sign(face);
+    direction[(a + 1) % 3] = 2.0 * (column + 0.5) / face_size_ - 1.0;
+    direction[(a + 2) % 3] = 2.0 * (row + 0.5) / face_size_ - 1.0;
+    return direction.normalized();
+}
+
+void LensedEnvironment::store(std::size_t index, const GeodesicResult& result) {
+    direction_x_[index] = static_cast<float>(result.direction.x());
+    direction_y_[index] = static_cast<float>(result.direction.y());
+    direction_z_[index] = static_cast<float>(result.direction.z());
+    disk_radius_[index] = static_cast<float>(result.disk_radius);
+    angular_momentum_[index] = static_cast<float>(result.angular_momentum);
+    termination_[index] = static_cast<std::uint8_t>(result.termination);
+    disk_crossings_[index] = static_cast<std::uint8_t>(std::min(result.disk_crossings, 255));
+}
+
+GeodesicResult LensedEnvironment::lookup(const Eigen::Vector3d& direction) const {
+    GeodesicResult result;
+    if (!is_valid() || direction.squaredNorm() == 0.0) return result;
+
+    Eigen::Index axis = 0;
+    direction.cwiseAbs().maxCoeff(&axis);
+    const int a = static_cast<int>(axis);
+    int face = 2 * a + (direction[a] < 0.0 ? 1 : 0);
+    double major = std::abs(direction[a]);
+
+    // Texel centers sit at integer grid coordinates; clamp to the face
+    const int n = face_size_;
+    double gx = std::clamp((direction[(a + 1) % 3] / major + 1.0) * 0.5 * n - 0.5, 0.0, n - 1.0);
+    double gy = std::clamp((direction[(a + 2) % 3] / major + 1.0) * 0.5 * n - 0.5, 0.0, n - 1.0);
+    int x0 = std::min(static_cast<int>(gx), n - 2);
+    int y0 = std::min(static_cast<int>(gy), n - 2);
+    double fx = gx - x0;
+    double fy = gy - y0;
+
+    const std::size_t base = static_cast<std::size_t>(face) * n * n;
+    std::size_t index[4];
+    double weight[4];
+    for (int c = 0; c < 4; ++c) {
+        int dx = c & 1, dy = c >> 1;
+        index[c] = base + static_cast<std::size_t>(y0 + dy) * n + x0 + dx;
+        weight[c] = (dx ? fx : 1.0 - fx) * (dy ? fy : 1.0 - fy);
+    }
+
+    int nearest = static_cast<int>(std::max_element(weight, weight + 4) - weight);
+    const std::size_t k = index[nearest];
+    Eigen::Vector3d reference(direction_x_[k], direction_y_[k], direction_z_[k]);
+
+    // Blend only corners with the same fate whose rays left less than a quarter turn apart
+    Eigen::Vector3d blended = Eigen::Vector3d::Zero();
+    double disk_radius = 0.0;
+    double angular_momentum = 0.0;
+    bool blend = true;
+    for (int c = 0; c < 4 && blend; ++c) {
+        if (weight[c] == 0.0) continue;
+        const std::size_t i = index[c];
+        Eigen::Vector3d d(direction_x_[i], direction_y_[i], direction_z_[i]);
+        blend = termination_[i] == termination_[k] && disk_crossings_[i] == disk_crossings_[k] &&
+                d.dot(reference) > 0.0;
+        blended += weight[c] * d;
+        disk_radius += weight[c] * disk_radius_[i];
+        angular_momentum += weight[c] * angular_momentum_[i];
+    }
+    if (!blend) {
+        blended = reference;
+        disk_radius = disk_radius_[k];
+        angular_momentum = angular_momentum_[k];
+    }
+
+    result.termination = static_cast<GeodesicTermination>(termination_[k]);
+    result.direction = blended.squaredNorm() > 0.0 ? Eigen::Vector3d(blended.normalized()) : blended;
+    result.disk_radius = disk_radius;
+    result.disk_crossings = disk_crossings_[k];
+    result.angular_momentum = angular_momentum;
+    return result;
+}
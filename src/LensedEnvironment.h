@@ -0,0 +1,68 @@
+#ifndef LENSEDENVIRONMENT_H
+#define LENSEDENVIRONMENT_H
+
+#include "GeodesicIntegrator.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BlackHoleParameters;
+
+// Geodesic fates of every viewing direction from one observer position.
+//
+// The sky seen from a fixed point depends only on that point, not on where the
+// camera looks, so rotating the view needs no new geodesics. The environment is
+// a cubemap with faces +x, -x, +y, -y, +z, -z in world axes; each texel holds
+// the traced result of the ray through its center: final direction, termination,
+// disk crossings, and the hit radius and angular momentum of disk rays, which is
+// all the shading needs. Storage is planar, one array per field.
+//
+// Lookups interpolate bilinearly between the four nearest texels of a face when
+// they agree on termination and disk crossings, and take the nearest texel
+// otherwise, so the shadow edge and the photon ring stay sharp. The observer
+// position is relative to the hole in gravitational radii.
+class LensedEnvironment {
+public:
+    LensedEnvironment();
+
+    // Clears the texels; call store() for every texel afterwards
+    void reset(const BlackHoleParameters& params, const Eigen::Vector3d& observer, int face_size);
+    void invalidate() { face_size_ = 0; }
+    bool is_valid() const { return face_size_ > 0; }
+
+    // True when the texels were traced for these parameters at this face size
+    // from within tolerance (gravitational radii) of observer
+    bool matches(const BlackHoleParameters& params, const Eigen::Vector3d& observer, int face_size,
+                 double tolerance) const;
+
+    std::size_t get_texel_count() const { return static_cast<std::size_t>(face_size_) * face_size_ * 6; }
+    int get_face_size() const { return face_size_; }
+    const Eigen::Vector3d& get_observer() const { return observer_; }
+
+    // Direction through the center of texel index (face-major, then row, then column)
+    Eigen::Vector3d texel_direction(std::size_t index) const;
+    void store(std::size_t index, const GeodesicResult& result);
+
+    // Result of the ray leaving the observer along direction (need not be normalized).
+    // Only termination, direction, disk_radius, disk_crossings and angular_momentum are set.
+    GeodesicResult lookup(const Eigen::Vector3d& direction) const;
+
+private:
+    int face_size_;
+    Eigen::Vector3d observer_;
+    double mass_;
+    double spin_;
+    double disk_inner_radius_;
+    double disk_outer_radius_;
+
+    std::vector<float> direction_x_;
+    std::vector<float> direction_y_;
+    std::vector<float> direction_z_;
+    std::vector<float> disk_radius_;
+    std::vector<float> angular_momentum_;
+    std::vector<std::uint8_t> termination_;
+    std::vector<std::uint8_t> disk_crossings_;
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "NBodyKernel.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Accumulator {
+    __m256d x, y, z;
+};
+
+// Adds source j to four targets at (xi, yi, zi)
+inline void interact(__m256d sx, __m256d sy, __m256d sz, __m256d sm, __m256d xi, __m256d yi, __m256d zi,
+                     __m256d eps2, Accumulator& a) {
+    __m256d dx = _mm256_sub_pd(sx, xi);
+    __m256d dy = _mm256_sub_pd(sy, yi);
+    __m256d dz = _mm256_sub_pd(sz, zi);
+    __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, eps2)));
+
+    // m / r^3, zeroed where r2 is 0 and the division gave inf or NaN
+    __m256d r3 = _mm256_mul_pd(r2, _mm256_sqrt_pd(r2));
+    __m256d scale = _mm256_div_pd(sm, r3);
+    scale = _mm256_and_pd(scale, _mm256_cmp_pd(r2, _mm256_setzero_pd(), _CMP_GT_OQ));
+
+    a.x = _mm256_fmadd_pd(dx, scale, a.x);
+    a.y = _mm256_fmadd_pd(dy, scale, a.y);
+    a.z = _mm256_fmadd_pd(dz, scale, a.z);
+}
+
+inline void store(const NBodyArrays& bodies, std::size_t i, const Accumulator& a) {
+    _mm256_storeu_pd(bodies.ax + i, _mm256_add_pd(_mm256_loadu_pd(bodies.ax + i), a.x));
+    _mm256_storeu_pd(bodies.ay + i, _mm256_add_pd(_mm256_loadu_pd(bodies.ay + i), a.y));
+    _mm256_storeu_pd(bodies.az + i, _mm256_add_pd(_mm256_loadu_pd(bodies.az + i), a.z));
+}
+
+}
+
+std::size_t accumulate_nbody_avx2(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                                  std::size_t source_begin, std::size_t source_end, double softening2) {
+    const __m256d eps2 = _mm256_set1_pd(softening2);
+
+    // Eight targets in two registers share each broadcast source
+    std::size_t i = target_begin;
+    for (; i + 8 <= target_end; i += 8) {
+        const __m256d x0 = _mm256_loadu_pd(bodies.x + i), x1 = _mm256_loadu_pd(bodies.x + i + 4);
+        const __m256d y0 = _mm256_loadu_pd(bodies.y + i), y1 = _mm256_loadu_pd(bodies.y + i + 4);
+        const __m256d z0 = _mm256_loadu_pd(bodies.z + i), z1 = _mm256_loadu_pd(bodies.z + i + 4);
+        Accumulator a0{_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+        Accumulator a1 = a0;
+
+        for (std::size_t j = source_begin; j < source_end; ++j) {
+            __m256d sx = _mm256_broadcast_sd(bodies.x + j);
+            __m256d sy = _mm256_broadcast_sd(bodies.y + j);
+            __m256d sz = _mm256_broadcast_sd(bodies.z + j);
+            __m256d sm = _mm256_broadcast_sd(bodies.mass + j);
+            interact(sx, sy, sz, sm, x0, y0, z0, eps2, a0);
+            interact(sx, sy, sz, sm, x1, y1, z1, eps2, a1);
+        }
+        store(bodies, i, a0);
+        store(bodies, i + 4, a1);
+    }
+
+    for (; i + 4 <= target_end; i += 4) {
+        const __m256d x0 = _mm256_loadu_pd(bodies.x + i);
+        const __m256d y0 = _mm256_loadu_pd(bodies.y + i);
+        const __m256d z0 = _mm256_loadu_pd(bodies.z + i);
+        Accumulator a0{_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+
+        for (std::size_t j = source_begin; j < source_end; ++j) {
+            interact(_mm256_broadcast_sd(bodies.x + j), _mm256_broadcast_sd(bodies.y + j),
+                     _mm256_broadcast_sd(bodies.z + j), _mm256_broadcast_sd(bodies.mass + j),
+                     x0, y0, z0, eps2, a0);
+        }
+        store(bodies, i, a0);
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "NBodyKernel.h"
+#include <immintrin.h>
+
+namespace {
+
+struct Accumulator {
+    __m512d x, y, z;
+};
+
+// Adds source j to eight targets at (xi, yi, zi)
+inline void interact(__m512d sx, __m512d sy, __m512d sz, __m512d sm, __m512d xi, __m512d yi, __m512d zi,
+                     __m512d eps2, Accumulator& a) {
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d three_halves = _mm512_set1_pd(1.5);
+
+    __m512d dx = _mm512_sub_pd(sx, xi);
+    __m512d dy = _mm512_sub_pd(sy, yi);
+    __m512d dz = _mm512_sub_pd(sz, zi);
+    __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, eps2)));
+
+    // 1 / r from the 14-bit estimate and two Newton steps, within a few ulp
+    // and without the divider; lanes with r2 = 0 are dropped
+    __m512d inv_r = _mm512_maskz_rsqrt14_pd(0xff, r2);
+    __m512d half_r2 = _mm512_mul_pd(half, r2);
+    inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(half_r2, _mm512_mul_pd(inv_r, inv_r), three_halves));
+    inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(half_r2, _mm512_mul_pd(inv_r, inv_r), three_halves));
+    __mmask8 separated = _mm512_cmp_pd_mask(r2, _mm512_setzero_pd(), _CMP_GT_OQ);
+    __m512d scale = _mm512_maskz_mul_pd(separated, sm, _mm512_mul_pd(inv_r, _mm512_mul_pd(inv_r, inv_r)));
+
+    a.x = _mm512_fmadd_pd(dx, scale, a.x);
+    a.y = _mm512_fmadd_pd(dy, scale, a.y);
+    a.z = _mm512_fmadd_pd(dz, scale, a.z);
+}
+
+inline void store(const NBodyArrays& bodies, std::size_t i, const Accumulator& a) {
+    _mm512_storeu_pd(bodies.ax + i, _mm512_add_pd(_mm512_loadu_pd(bodies.ax + i), a.x));
+    _mm512_storeu_pd(bodies.ay + i, _mm512_add_pd(_mm512_loadu_pd(bodies.ay + i), a.y));
+    _mm512_storeu_pd(bodies.az + i, _mm512_add_pd(_mm512_loadu_pd(bodies.az + i), a.z));
+}
+
+}
+
+std::size_t accumulate_nbody_avx512(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                                    std::size_t source_begin, std::size_t source_end, double softening2) {
+    const __m512d eps2 = _mm512_set1_pd(softening2);
+
+    // Sixteen targets in two registers share each broadcast source
+    std::size_t i = target_begin;
+    for (; i + 16 <= target_end; i += 16) {
+        const __m512d x0 = _mm512_loadu_pd(bodies.x + i), x1 = _mm512_loadu_pd(bodies.x + i + 8);
+        const __m512d y0 = _mm512_loadu_pd(bodies.y + i), y1 = _mm512_loadu_pd(bodies.y + i + 8);
+        const __m512d z0 = _mm512_loadu_pd(bodies.z + i), z1 = _mm512_loadu_pd(bodies.z + i + 8);
+        Accumulator a0{_mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd()};
+        Accumulator a1 = a0;
+
+        for (std::size_t j = source_begin; j < source_end; ++j) {
+            __m512d sx = _mm512_set1_pd(bodies.x[j]);
+            __m512d sy = _mm512_set1_pd(bodies.y[j]);
+            __m512d sz = _mm512_set1_pd(bodies.z[j]);
+            __m512d sm = _mm512_set1_pd(bodies.mass[j]);
+            interact(sx, sy, sz, sm, x0, y0, z0, eps2, a0);
+            interact(sx, sy, sz, sm, x1, y1, z1, eps2, a1);
+        }
+        store(bodies, i, a0);
+        store(bodies, i + 8, a1);
+    }
+
+    for (; i + 8 <= target_end; i += 8) {
+        const __m512d x0 = _mm512_loadu_pd(bodies.x + i);
+        const __m512d y0 = _mm512_loadu_pd(bodies.y + i);
+        const __m512d z0 = _mm512_loadu_pd(bodies.z + i);
+        Accumulator a0{_mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd()};
+
+        for (std::size_t j = source_begin; j < source_end; ++j) {
+            interact(_mm512_set1_pd(bodies.x[j]), _mm512_set1_pd(bodies.y[j]), _mm512_set1_pd(bodies.z[j]),
+                     _mm512_set1_pd(bodies.mass[j]), x0, y0, z0, eps2, a0);
+        }
+        store(bodies, i, a0);
+    }
+    return i;
+}
+
+#endif
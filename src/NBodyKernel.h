@@ -0,0 +1,41 @@
+#ifndef NBODYKERNEL_H
+#define NBODYKERNEL_H
+
+#include <cstddef>
+
+// Plain-data interface between PhysicsEngine and the per-ISA all-pairs gravity
+// kernels, which are compiled with ISA-specific flags.
+
+// Structure-of-arrays body state, one entry per body
+struct NBodyArrays {
+    const double* x;
+    const double* y;
+    const double* z;
+    const double* mass;
+    double* ax;
+    double* ay;
+    double* az;
+};
+
+// Adds sum_j m_j (r_j - r_i) / (|r_j - r_i|^2 + softening2)^(3/2), without G, to
+// the acceleration of every target in [target_begin, target_end) from the
+// sources in [source_begin, source_end). Pairs with no separation and no
+// softening contribute nothing, which covers the body itself. Each target sums
+// its sources in index order.
+void accumulate_nbody_scalar(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                             std::size_t source_begin, std::size_t source_end, double softening2);
+
+// Same with the widest kernel this CPU runs
+void accumulate_nbody(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                      std::size_t source_begin, std::size_t source_end, double softening2);
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+// Targets from target_begin in groups of 4 (AVX2) or 8 (AVX-512); return the
+// first target they did not do
+std::size_t accumulate_nbody_avx2(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                                  std::size_t source_begin, std::size_t source_end, double softening2);
+std::size_t accumulate_nbody_avx512(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                                    std::size_t source_begin, std::size_t source_end, double softening2);
+#endif
+
+#endif
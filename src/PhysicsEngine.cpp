@@ -1,68 +1,655 @@
 #include "PhysicsEngine.h"
+#include "GeodesicPacket.h"
+#include "NBodyKernel.h"
+#include "TidalKernel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
 
-PhysicsEngine::PhysicsEngine() : black_hole_(nullptr) {}
+namespace {
+
+// Bodies per task, a multiple of the widest kernel's 16 targets
+const std::size_t kTargetBlock = 64;
+
+// Sources swept per pass over a target block; 4 arrays of 1024 doubles fit in L1
+const std::size_t kSourceBlock = 1024;
+
+// Block step levels past this would overflow the tick counter's precision
+const int kMaxBlockLevel = 40;
+
+// Tidal tensor points per task; a block's six output planes stay in L2
+const std::size_t kTidalBlock = 4096;
+
+}
+
+void accumulate_nbody_scalar(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                             std::size_t source_begin, std::size_t source_end, double softening2) {
+    for (std::size_t i = target_begin; i < target_end; ++i) {
+        double ax = 0.0, ay = 0.0, az = 0.0;
+        for (std::size_t j = source_begin; j < source_end; ++j) {
+            double dx = bodies.x[j] - bodies.x[i];
+            double dy = bodies.y[j] - bodies.y[i];
+            double dz = bodies.z[j] - bodies.z[i];
+            double r2 = dx * dx + dy * dy + dz * dz + softening2;
+            if (r2 > 0.0) {
+                double scale = bodies.mass[j] / (r2 * std::sqrt(r2));
+                ax += dx * scale;
+                ay += dy * scale;
+                az += dz * scale;
+            }
+        }
+        bodies.ax[i] += ax;
+        bodies.ay[i] += ay;
+        bodies.az[i] += az;
+    }
+}
+
+void accumulate_nbody(const NBodyArrays& bodies, std::size_t target_begin, std::size_t target_end,
+                      std::size_t source_begin, std::size_t source_end, double softening2) {
+    std::size_t done = target_begin;
+#ifdef BLACKHOLE_SIMD_KERNELS
+    const SimdIsa isa = detect_simd_isa();
+    if (isa == SimdIsa::Avx512) {
+        done = accumulate_nbody_avx512(bodies, done, target_end, source_begin, source_end, softening2);
+    }
+    if (isa == SimdIsa::Avx512 || isa == SimdIsa::Avx2) {
+        done = accumulate_nbody_avx2(bodies, done, target_end, source_begin, source_end, softening2);
+    }
+#endif
+    accumulate_nbody_scalar(bodies, done, target_end, source_begin, source_end, softening2);
+}
+
+void evaluate_tidal_scalar(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                           std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+        double dx = points.x[i] - source.x;
+        double dy = points.y[i] - source.y;
+        double dz = points.z[i] - source.z;
+        double r2 = dx * dx + dy * dy + dz * dz;
+        double s = 0.0, q = 0.0;
+        if (r2 > 0.0) {
+            s = source.gm / (r2 * std::sqrt(r2));
+            q = 3.0 * s / r2;
+        }
+        out.xx[i] = q * dx * dx - s;
+        out.xy[i] = q * dx * dy;
+        out.xz[i] = q * dx * dz;
+        out.yy[i] = q * dy * dy - s;
+        out.yz[i] = q * dy * dz;
+        out.zz[i] = q * dz * dz - s;
+    }
+}
+
+void evaluate_tidal(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                    std::size_t begin, std::size_t end) {
+    std::size_t done = begin;
+#ifdef BLACKHOLE_SIMD_KERNELS
+    const SimdIsa isa = detect_simd_isa();
+    if (isa == SimdIsa::Avx512) {
+        done = evaluate_tidal_avx512(source, points, out, done, end);
+    }
+    if (isa == SimdIsa::Avx512 || isa == SimdIsa::Avx2) {
+        done = evaluate_tidal_avx2(source, points, out, done, end);
+    }
+#endif
+    evaluate_tidal_scalar(source, points, out, done, end);
+}
+
+void BodyArrays::push_back(const CelestialBody& body, std::uint32_t body_id) {
+    x.push_back(body.position.x());
+    y.push_back(body.position.y());
+    z.push_back(body.position.z());
+    vx.push_back(body.velocity.x());
+    vy.push_back(body.velocity.y());
+    vz.push_back(body.velocity.z());
+    ax.push_back(body.acceleration.x());
+    ay.push_back(body.acceleration.y());
+    az.push_back(body.acceleration.z());
+    mass.push_back(body.mass);
+    radius.push_back(body.radius);
+    id.push_back(body_id);
+}
+
+void BodyArrays::swap_remove(std::size_t index) {
+    std::vector<double>* planes[] = {&x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass, &radius};
+    for (std::vector<double>* plane : planes) {
+        (*plane)[index] = plane->back();
+        plane->pop_back();
+    }
+    id[index] = id.back();
+    id.pop_back();
+}
+
+CelestialBody BodyArrays::get(std::size_t index) const {
+    CelestialBody body(position(index), Eigen::Vector3d(vx[index], vy[index], vz[index]),
+                       mass[index], radius[index]);
+    body.acceleration = Eigen::Vector3d(ax[index], ay[index], az[index]);
+    return body;
+}
+
+void TidalTensorArrays::resize(std::size_t count) {
+    xx.resize(count);
+    xy.resize(count);
+    xz.resize(count);
+    yy.resize(count);
+    yz.resize(count);
+    zz.resize(count);
+}
+
+Eigen::Matrix3d TidalTensorArrays::get(std::size_t index) const {
+    Eigen::Matrix3d tensor;
+    tensor << xx[index], xy[index], xz[index],
+              xy[index], yy[index], yz[index],
+              xz[index], yz[index], zz[index];
+    return tensor;
+}
+
+PhysicsEngine::PhysicsEngine(unsigned thread_count)
+    : black_hole_(nullptr),
+      pool_(std::make_unique<ThreadPool>(thread_count)),
+      softening_length_(0.0),
+      time_(0.0),
+      next_id_(0),
+      accelerations_valid_(false),
+      force_evaluations_(0) {}
 
 void PhysicsEngine::set_black_hole(const std::shared_ptr<BlackHole>& black_hole) {
     black_hole_ = black_hole;
+    accelerations_valid_ = false;
 }
 
-void PhysicsEngine::add_body(const CelestialBody& body) {
-    bodies_.push_back(body);
+std::uint32_t PhysicsEngine::add_body(const CelestialBody& body) {
+    bodies_.push_back(body, next_id_);
+    levels_.push_back(0);
+    jerks_.push_back(0.0);
+    accelerations_valid_ = false;
+    return next_id_++;
+}
+
+std::size_t PhysicsEngine::take_events(std::vector<BodyEvent>& events) {
+    const std::size_t count = events_.size();
+    events.insert(events.end(), events_.begin(), events_.end());
+    events_.clear();
+    return count;
+}
+
+std::vector<CelestialBody> PhysicsEngine::get_bodies() const {
+    std::vector<CelestialBody> bodies;
+    bodies.reserve(bodies_.size());
+    for (std::size_t i = 0; i < bodies_.size(); ++i) {
+        bodies.push_back(bodies_.get(i));
+    }
+    return bodies;
+}
+
+void PhysicsEngine::set_gravity_settings(const GravitySettings& settings) {
+    gravity_ = settings;
+    accelerations_valid_ = false;
+}
+
+void PhysicsEngine::save_snapshot(PhysicsSnapshot& snapshot) const {
+    const std::size_t count = bodies_.size();
+    const BodyArrays& b = bodies_;
+    snapshot.allocate(count);
+    
+    SnapshotHeader& header = snapshot.get_header();
+    header.time = time_;
+    header.softening_length = softening_length_;
+    if (black_hole_) {
+        const BlackHoleParameters& params = black_hole_->get_parameters();
+        header.has_black_hole = 1;
+        header.hole_mass = params.mass;
+        header.hole_spin = params.spin;
+        header.hole_disk_inner_radius = params.accretion_disk_inner_radius;
+        header.hole_disk_outer_radius = params.accretion_disk_outer_radius;
+        header.hole_position[0] = params.position.x();
+        header.hole_position[1] = params.position.y();
+        header.hole_position[2] = params.position.z();
+    }
+    header.opening_angle = gravity_.opening_angle;
+    header.accuracy = timestep_.accuracy;
+    header.solver = static_cast<std::int32_t>(gravity_.solver);
+    header.leaf_size = gravity_.leaf_size;
+    header.integrator = static_cast<std::int32_t>(timestep_.integrator);
+    header.block_steps = timestep_.block_steps ? 1 : 0;
+    header.max_level = timestep_.max_level;
+    header.accelerations_valid = accelerations_valid_ ? 1 : 0;
+    header.next_id = next_id_;
+    
+    const std::vector<double>* planes[] = {&b.x, &b.y, &b.z, &b.vx, &b.vy, &b.vz, &b.ax, &b.ay, &b.az,
+                                           &b.mass, &b.radius};
+    for (int p = 0; p < static_cast<int>(SnapshotPlane::Jerk); ++p) {
+        std::memcpy(snapshot.get_plane(static_cast<SnapshotPlane>(p)), planes[p]->data(), count * sizeof(double));
+    }
+    double* jerks = snapshot.get_plane(SnapshotPlane::Jerk);
+    for (std::size_t i = 0; i < count; ++i) {
+        jerks[i] = i < jerks_.size() ? jerks_[i] : 0.0;
+    }
+    std::memcpy(snapshot.get_ids(), b.id.data(), count * sizeof(std::uint32_t));
+}
+
+bool PhysicsEngine::load_snapshot(const PhysicsSnapshot& snapshot) {
+    if (!snapshot.is_valid()) return false;
+    const std::size_t count = snapshot.get_body_count();
+    const SnapshotHeader& header = snapshot.get_header();
+    
+    // Nothing is replaced unless every setting is in range
+    if (header.solver != static_cast<std::int32_t>(GravitySolver::Direct) &&
+        header.solver != static_cast<std::int32_t>(GravitySolver::BarnesHut)) return false;
+    if (header.integrator != static_cast<std::int32_t>(TimeIntegrator::Leapfrog) &&
+        header.integrator != static_cast<std::int32_t>(TimeIntegrator::Yoshida4)) return false;
+    if (header.leaf_size < 1 || header.max_level < 0 || header.max_level > kMaxBlockLevel) return false;
+    if (!(header.opening_angle >= 0.0) || !(header.accuracy > 0.0) || !(header.softening_length >= 0.0)) return false;
+    if (!std::isfinite(header.time) || (header.has_black_hole && !(header.hole_mass > 0.0))) return false;
+    
+    time_ = header.time;
+    softening_length_ = header.softening_length;
+    black_hole_.reset();
+    if (header.has_black_hole) {
+        BlackHoleParameters params;
+        params.mass = header.hole_mass;
+        params.spin = header.hole_spin;
+        params.accretion_disk_inner_radius = header.hole_disk_inner_radius;
+        params.accretion_disk_outer_radius = header.hole_disk_outer_radius;
+        params.position = Eigen::Vector3d(header.hole_position[0], header.hole_position[1], header.hole_position[2]);
+        black_hole_ = std::make_shared<BlackHole>(params);
+    }
+    gravity_.solver = static_cast<GravitySolver>(header.solver);
+    gravity_.opening_angle = header.opening_angle;
+    gravity_.leaf_size = header.leaf_size;
+    timestep_.integrator = static_cast<TimeIntegrator>(header.integrator);
+    timestep_.block_steps = header.block_steps != 0;
+    timestep_.accuracy = header.accuracy;
+    timestep_.max_level = header.max_level;
+    next_id_ = header.next_id;
+    
+    BodyArrays& b = bodies_;
+    std::vector<double>* planes[] = {&b.x, &b.y, &b.z, &b.vx, &b.vy, &b.vz, &b.ax, &b.ay, &b.az,
+                                     &b.mass, &b.radius, &jerks_};
+    for (int p = 0; p < static_cast<int>(SnapshotPlane::Count); ++p) {
+        const double* plane = snapshot.get_plane(static_cast<SnapshotPlane>(p));
+        planes[p]->assign(plane, plane + count);
+    }
+    b.id.assign(snapshot.get_ids(), snapshot.get_ids() + count);
+    levels_.assign(count, 0);
+    accelerations_valid_ = header.accelerations_valid != 0;
+    return true;
+}
+
+void PhysicsEngine::set_softening_length(double length) {
+    softening_length_ = length;
+    accelerations_valid_ = false;
 }
 
 void PhysicsEngine::update(double delta_time) {
+    // Time runs on without bodies, so clocks and checkpoints keep following it
+    if (bodies_.size() == 0) {
+        time_ += delta_time;
+        return;
+    }
+    if (!accelerations_valid_) {
+        compute_gravitational_forces();
+    }
+    
+    // Yoshida's composition: the backward middle step cancels the third-order error
+    const double cbrt2 = std::cbrt(2.0);
+    const double w1 = 1.0 / (2.0 - cbrt2);
+    const double w0 = -cbrt2 * w1;
+    const double yoshida[3] = {w1, w0, w1};
+    const double leapfrog[1] = {1.0};
+    const bool fourth_order = timestep_.integrator == TimeIntegrator::Yoshida4;
+    const double* weights = fourth_order ? yoshida : leapfrog;
+    
+    for (int k = 0; k < (fourth_order ? 3 : 1); ++k) {
+        if (timestep_.block_steps) {
+            block_step(weights[k] * delta_time);
+        } else {
+            leapfrog_step(weights[k] * delta_time);
+        }
+    }
+    time_ += delta_time;
+    
+    resolve_body_events();
+}
+
+void PhysicsEngine::leapfrog_step(double delta_time) {
+    const std::size_t count = bodies_.size();
+    
+    // Velocity Verlet: half kick, drift, forces at the new positions, half kick
+    const double half_dt = 0.5 * delta_time;
+    BodyArrays& b = bodies_;
+    for (std::size_t i = 0; i < count; ++i) {
+        b.vx[i] += half_dt * b.ax[i];
+        b.vy[i] += half_dt * b.ay[i];
+        b.vz[i] += half_dt * b.az[i];
+        b.x[i] += delta_time * b.vx[i];
+        b.y[i] += delta_time * b.vy[i];
+        b.z[i] += delta_time * b.vz[i];
+    }
+    
     compute_gravitational_forces();
     
-    // Update bodies using Verlet integration
-    for (auto& body : bodies_) {
-        Eigen::Vector3d new_position = body.position + body.velocity * delta_time + 
-                                      0.5 * body.acceleration * delta_time * delta_time;
-        
-        // Store old acceleration
-        Eigen::Vector3d old_acceleration = body.acceleration;
+    for (std::size_t i = 0; i < count; ++i) {
+        b.vx[i] += half_dt * b.ax[i];
+        b.vy[i] += half_dt * b.ay[i];
+        b.vz[i] += half_dt * b.az[i];
+    }
+}
+
+void PhysicsEngine::block_step(double delta_time) {
+    const std::size_t count = bodies_.size();
+    const int max_level = std::min(std::max(timestep_.max_level, 0), kMaxBlockLevel);
+    const std::uint64_t ticks = std::uint64_t(1) << max_level;
+    const double tick = delta_time / static_cast<double>(ticks);
+    BodyArrays& b = bodies_;
+    levels_.resize(count, 0);
+    step_ends_.resize(count);
+    jerks_.resize(count, 0.0);
+    
+    // Every body opens a step at the start
+    for (std::size_t i = 0; i < count; ++i) {
+        levels_[i] = choose_level(i, delta_time, max_level);
+        step_ends_[i] = ticks >> levels_[i];
+        const double half_dt = 0.5 * tick * static_cast<double>(step_ends_[i]);
+        b.vx[i] += half_dt * b.ax[i];
+        b.vy[i] += half_dt * b.ay[i];
+        b.vz[i] += half_dt * b.az[i];
+    }
+    
+    std::uint64_t now = 0;
+    while (now < ticks) {
+        const std::uint64_t next = *std::min_element(step_ends_.begin(), step_ends_.end());
+        const double drift = tick * static_cast<double>(next - now);
+        for (std::size_t i = 0; i < count; ++i) {
+            b.x[i] += drift * b.vx[i];
+            b.y[i] += drift * b.vy[i];
+            b.z[i] += drift * b.vz[i];
+        }
+        now = next;
         
-        // Update position
-        body.position = new_position;
+        active_.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (step_ends_[i] == now) {
+                active_.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+        previous_ax_.resize(active_.size());
+        previous_ay_.resize(active_.size());
+        previous_az_.resize(active_.size());
+        for (std::size_t k = 0; k < active_.size(); ++k) {
+            previous_ax_[k] = b.ax[active_[k]];
+            previous_ay_[k] = b.ay[active_[k]];
+            previous_az_[k] = b.az[active_[k]];
+        }
         
-        // Compute new acceleration
-        compute_gravitational_forces();
+        compute_active_forces();
         
-        // Update velocity
-        body.velocity += 0.5 * (old_acceleration + body.acceleration) * delta_time;
+        // Close the finished steps and open the next ones
+        for (std::size_t k = 0; k < active_.size(); ++k) {
+            const std::uint32_t i = active_[k];
+            double step = tick * static_cast<double>(ticks >> levels_[i]);
+            b.vx[i] += 0.5 * step * b.ax[i];
+            b.vy[i] += 0.5 * step * b.ay[i];
+            b.vz[i] += 0.5 * step * b.az[i];
+            
+            Eigen::Vector3d change(b.ax[i] - previous_ax_[k], b.ay[i] - previous_ay_[k], b.az[i] - previous_az_[k]);
+            jerks_[i] = change.norm() / std::abs(step);
+            if (now == ticks) continue;
+            
+            // Shorter steps always line up with now; longer ones only at their boundaries
+            int level = choose_level(i, delta_time, max_level);
+            if (level < levels_[i]) {
+                int current = levels_[i];
+                while (current > level && now % (ticks >> (current - 1)) == 0) {
+                    --current;
+                }
+                level = current;
+            }
+            levels_[i] = level;
+            step_ends_[i] = now + (ticks >> level);
+            
+            step = tick * static_cast<double>(ticks >> level);
+            b.vx[i] += 0.5 * step * b.ax[i];
+            b.vy[i] += 0.5 * step * b.ay[i];
+            b.vz[i] += 0.5 * step * b.az[i];
+        }
     }
 }
 
+int PhysicsEngine::choose_level(std::size_t index, double delta_time, int max_level) const {
+    const BodyArrays& b = bodies_;
+    double acceleration = std::sqrt(b.ax[index] * b.ax[index] + b.ay[index] * b.ay[index] + b.az[index] * b.az[index]);
+    double jerk = index < jerks_.size() ? jerks_[index] : 0.0;
+    
+    // Exact jerk of the hole's pull, so bodies falling in shorten their step in time
+    if (black_hole_) {
+        const double solar_mass = 1.989e30;
+        Eigen::Vector3d r = b.position(index) - black_hole_->get_parameters().position;
+        Eigen::Vector3d v(b.vx[index], b.vy[index], b.vz[index]);
+        double r2 = r.squaredNorm();
+        if (r2 > 0.0) {
+            double inv_r3 = 1.0 / (r2 * std::sqrt(r2));
+            double gm = G * black_hole_->get_parameters().mass * solar_mass;
+            Eigen::Vector3d hole_jerk = gm * inv_r3 * (3.0 * r.dot(v) / r2 * r - v);
+            jerk = std::max(jerk, hole_jerk.norm());
+        }
+    }
+    if (!(jerk > 0.0) || !(acceleration > 0.0)) return 0;
+    
+    const double target = timestep_.accuracy * acceleration / jerk;
+    double step = std::abs(delta_time);
+    int level = 0;
+    while (step > target && level < max_level) {
+        step *= 0.5;
+        ++level;
+    }
+    return level;
+}
+
 void PhysicsEngine::compute_gravitational_forces() {
-    const double solar_mass = 1.989e30;
+    const std::size_t count = bodies_.size();
+    BodyArrays& b = bodies_;
+    std::fill(b.ax.begin(), b.ax.end(), 0.0);
+    std::fill(b.ay.begin(), b.ay.end(), 0.0);
+    std::fill(b.az.begin(), b.az.end(), 0.0);
     
-    for (auto& body : bodies_) {
-        body.acceleration = Eigen::Vector3d::Zero();
+    const double softening2 = softening_length_ * softening_length_;
+    
+    if (gravity_.solver == GravitySolver::BarnesHut) {
+        octree_.build(b.x.data(), b.y.data(), b.z.data(), b.mass.data(), count, gravity_.leaf_size);
+        octree_.accumulate(b.ax.data(), b.ay.data(), b.az.data(), gravity_.opening_angle, softening2, *pool_);
+    } else {
+        const NBodyArrays arrays{b.x.data(), b.y.data(), b.z.data(), b.mass.data(),
+                                 b.ax.data(), b.ay.data(), b.az.data()};
         
-        // Black hole gravity
-        if (black_hole_) {
-            Eigen::Vector3d to_bh = black_hole_->get_parameters().position - body.position;
-            double distance = to_bh.norm();
-            
-            if (distance > 0.0) {
-                double bh_mass = black_hole_->get_parameters().mass * solar_mass;
-                double force_magnitude = G * bh_mass / (distance * distance);
-                body.acceleration += to_bh.normalized() * force_magnitude;
+        // One block of targets per task, sweeping the sources chunk by chunk
+        const std::size_t blocks = (count + kTargetBlock - 1) / kTargetBlock;
+        pool_->parallel_for(blocks, [&](std::size_t block, unsigned) {
+            const std::size_t begin = block * kTargetBlock;
+            const std::size_t end = std::min(begin + kTargetBlock, count);
+            for (std::size_t source = 0; source < count; source += kSourceBlock) {
+                accumulate_nbody(arrays, begin, end, source, std::min(source + kSourceBlock, count), softening2);
             }
+        });
+    }
+    
+    force_evaluations_ += count;
+    finish_accelerations(nullptr, count);
+    accelerations_valid_ = true;
+}
+
+void PhysicsEngine::compute_active_forces() {
+    const std::size_t count = bodies_.size();
+    const std::size_t active = active_.size();
+    BodyArrays& b = bodies_;
+    const double softening2 = softening_length_ * softening_length_;
+    for (std::uint32_t i : active_) {
+        b.ax[i] = 0.0;
+        b.ay[i] = 0.0;
+        b.az[i] = 0.0;
+    }
+    
+    if (gravity_.solver == GravitySolver::BarnesHut) {
+        active_flags_.assign(count, 0);
+        for (std::uint32_t i : active_) {
+            active_flags_[i] = 1;
+        }
+        octree_.build(b.x.data(), b.y.data(), b.z.data(), b.mass.data(), count, gravity_.leaf_size);
+        octree_.accumulate(b.ax.data(), b.ay.data(), b.az.data(), gravity_.opening_angle, softening2, *pool_,
+                           active_flags_.data());
+    } else {
+        GatherArrays& g = gather_;
+        g.x.assign(b.x.begin(), b.x.end());
+        g.y.assign(b.y.begin(), b.y.end());
+        g.z.assign(b.z.begin(), b.z.end());
+        g.mass.assign(b.mass.begin(), b.mass.end());
+        for (std::uint32_t i : active_) {
+            g.x.push_back(b.x[i]);
+            g.y.push_back(b.y[i]);
+            g.z.push_back(b.z[i]);
+            g.mass.push_back(b.mass[i]);
         }
+        g.ax.assign(count + active, 0.0);
+        g.ay.assign(count + active, 0.0);
+        g.az.assign(count + active, 0.0);
+        const NBodyArrays arrays{g.x.data(), g.y.data(), g.z.data(), g.mass.data(),
+                                 g.ax.data(), g.ay.data(), g.az.data()};
         
-        // Other bodies gravity (simplified)
-        for (const auto& other : bodies_) {
-            if (&body != &other) {
-                Eigen::Vector3d to_other = other.position - body.position;
-                double distance = to_other.norm();
+        const std::size_t blocks = (active + kTargetBlock - 1) / kTargetBlock;
+        pool_->parallel_for(blocks, [&](std::size_t block, unsigned) {
+            const std::size_t begin = count + block * kTargetBlock;
+            const std::size_t end = std::min(begin + kTargetBlock, count + active);
+            for (std::size_t source = 0; source < count; source += kSourceBlock) {
+                accumulate_nbody(arrays, begin, end, source, std::min(source + kSourceBlock, count), softening2);
+            }
+        });
+        for (std::size_t k = 0; k < active; ++k) {
+            b.ax[active_[k]] = g.ax[count + k];
+            b.ay[active_[k]] = g.ay[count + k];
+            b.az[active_[k]] = g.az[count + k];
+        }
+    }
+    
+    force_evaluations_ += active;
+    finish_accelerations(active_.data(), active);
+}
+
+// Scales the body-body sums by G and adds the hole, an exact external point
+// mass for either solver, for the listed bodies or the first count if null
+void PhysicsEngine::finish_accelerations(const std::uint32_t* targets, std::size_t count) {
+    const double solar_mass = 1.989e30;
+    BodyArrays& b = bodies_;
+    const bool has_hole = static_cast<bool>(black_hole_);
+    const Eigen::Vector3d bh_pos = has_hole ? black_hole_->get_parameters().position : Eigen::Vector3d::Zero();
+    const double bh_mass = has_hole ? black_hole_->get_parameters().mass * solar_mass : 0.0;
+    
+    const std::size_t blocks = (count + kTargetBlock - 1) / kTargetBlock;
+    pool_->parallel_for(blocks, [&](std::size_t block, unsigned) {
+        const std::size_t begin = block * kTargetBlock;
+        const std::size_t end = std::min(begin + kTargetBlock, count);
+        for (std::size_t k = begin; k < end; ++k) {
+            const std::size_t i = targets ? targets[k] : k;
+            Eigen::Vector3d acceleration = G * Eigen::Vector3d(b.ax[i], b.ay[i], b.az[i]);
+            
+            // Black hole gravity
+            if (has_hole) {
+                Eigen::Vector3d to_bh = bh_pos - b.position(i);
+                double distance = to_bh.norm();
                 
                 if (distance > 0.0) {
-                    double force_magnitude = G * other.mass / (distance * distance);
-                    body.acceleration += to_other.normalized() * force_magnitude;
+                    double force_magnitude = G * bh_mass / (distance * distance);
+                    acceleration += to_bh.normalized() * force_magnitude;
                 }
             }
+            
+            b.ax[i] = acceleration.x();
+            b.ay[i] = acceleration.y();
+            b.az[i] = acceleration.z();
         }
+    });
+}
+
+void PhysicsEngine::resolve_body_events() {
+    const std::size_t count = bodies_.size();
+    BodyArrays& b = bodies_;
+    removed_.assign(count, 0);
+    removals_.clear();
+    
+    if (black_hole_ && (events_settings_.horizon_capture || events_settings_.tidal_disruption)) {
+        const Eigen::Vector3d bh_pos = black_hole_->get_parameters().position;
+        const double horizon = black_hole_->get_event_horizon_radius();
+        for (std::size_t i = 0; i < count; ++i) {
+            const Eigen::Vector3d position = b.position(i);
+            if (events_settings_.horizon_capture && (position - bh_pos).norm() < horizon) {
+                record_event(BodyEventType::HorizonCapture, i, b.id[i]);
+                continue;
+            }
+            
+            // Stretch across the radius against gravity at the surface
+            const double radius = b.radius[i];
+            if (events_settings_.tidal_disruption && radius > 0.0 &&
+                calculate_tidal_forces(position).norm() * radius > G * b.mass[i] / (radius * radius)) {
+                record_event(BodyEventType::TidalDisruption, i, b.id[i]);
+            }
+        }
+    }
+    
+    if (events_settings_.collisions) {
+        overlaps_.clear();
+        collision_hash_.build(b.x.data(), b.y.data(), b.z.data(), b.radius.data(), count);
+        collision_hash_.find_overlaps(b.x.data(), b.y.data(), b.z.data(), b.radius.data(), overlaps_);
+        
+        // Pairs in index order; a body merged away this step takes no part in later pairs
+        for (const auto& pair : overlaps_) {
+            std::size_t keep = pair.first, gone = pair.second;
+            if (removed_[keep] || removed_[gone]) continue;
+            if (b.mass[gone] > b.mass[keep]) std::swap(keep, gone);
+            record_event(BodyEventType::Collision, gone, b.id[keep]);
+            
+            const double mass = b.mass[keep] + b.mass[gone];
+            const double wk = mass > 0.0 ? b.mass[keep] / mass : 0.5;
+            const double wg = 1.0 - wk;
+            b.x[keep] = wk * b.x[keep] + wg * b.x[gone];
+            b.y[keep] = wk * b.y[keep] + wg * b.y[gone];
+            b.z[keep] = wk * b.z[keep] + wg * b.z[gone];
+            b.vx[keep] = wk * b.vx[keep] + wg * b.vx[gone];
+            b.vy[keep] = wk * b.vy[keep] + wg * b.vy[gone];
+            b.vz[keep] = wk * b.vz[keep] + wg * b.vz[gone];
+            b.mass[keep] = mass;
+            b.radius[keep] = std::cbrt(b.radius[keep] * b.radius[keep] * b.radius[keep] +
+                                       b.radius[gone] * b.radius[gone] * b.radius[gone]);
+        }
+    }
+    if (removals_.empty()) return;
+    
+    // Highest index first, so the body moved into a hole is never one still to remove
+    std::sort(removals_.begin(), removals_.end(), std::greater<std::uint32_t>());
+    for (std::uint32_t i : removals_) {
+        b.swap_remove(i);
+        jerks_[i] = jerks_.back();
+        jerks_.pop_back();
+        levels_[i] = levels_.back();
+        levels_.pop_back();
     }
+    accelerations_valid_ = false;
+}
+
+void PhysicsEngine::record_event(BodyEventType type, std::size_t index, std::uint32_t other) {
+    const BodyArrays& b = bodies_;
+    BodyEvent event;
+    event.type = type;
+    event.body = b.id[index];
+    event.other = other;
+    event.time = time_;
+    event.position = b.position(index);
+    event.velocity = Eigen::Vector3d(b.vx[index], b.vy[index], b.vz[index]);
+    event.mass = b.mass[index];
+    event.radius = b.radius[index];
+    events_.push_back(event);
+    
+    removed_[index] = 1;
+    removals_.push_back(static_cast<std::uint32_t>(index));
 }
 
 Eigen::Vector3d PhysicsEngine::calculate_tidal_forces(const Eigen::Vector3d& position) const {
@@ -82,3 +669,104 @@ Eigen::Vector3d PhysicsEngine::calculate_tidal_forces(const Eigen::Vector3d& pos
     
     return to_bh.normalized() * force_gradient;
 }
+
+bool PhysicsEngine::get_tidal_source(TidalSource& source) const {
+    if (!black_hole_) return false;
+    
+    const double solar_mass = 1.989e30;
+    const BlackHoleParameters& params = black_hole_->get_parameters();
+    source.x = params.position.x();
+    source.y = params.position.y();
+    source.z = params.position.z();
+    source.gm = G * params.mass * solar_mass;
+    return true;
+}
+
+Eigen::Matrix3d PhysicsEngine::calculate_tidal_tensor(const Eigen::Vector3d& position) const {
+    TidalSource source;
+    if (!get_tidal_source(source)) return Eigen::Matrix3d::Zero();
+    
+    double xx, xy, xz, yy, yz, zz;
+    const TidalPoints point{&position.x(), &position.y(), &position.z()};
+    const TidalOutput out{&xx, &xy, &xz, &yy, &yz, &zz};
+    evaluate_tidal_scalar(source, point, out, 0, 1);
+    
+    Eigen::Matrix3d tensor;
+    tensor << xx, xy, xz,
+              xy, yy, yz,
+              xz, yz, zz;
+    return tensor;
+}
+
+void PhysicsEngine::evaluate_tidal_tensors(const double* x, const double* y, const double* z, std::size_t count,
+                                           TidalTensorArrays& tensors) const {
+    tensors.resize(count);
+    const TidalOutput out{tensors.xx.data(), tensors.xy.data(), tensors.xz.data(),
+                          tensors.yy.data(), tensors.yz.data(), tensors.zz.data()};
+    TidalSource source;
+    if (!get_tidal_source(source)) {
+        for (double* plane : {out.xx, out.xy, out.xz, out.yy, out.yz, out.zz}) {
+            std::fill(plane, plane + count, 0.0);
+        }
+        return;
+    }
+    
+    const TidalPoints points{x, y, z};
+    const std::size_t blocks = (count + kTidalBlock - 1) / kTidalBlock;
+    pool_->parallel_for(blocks, [&](std::size_t block, unsigned) {
+        const std::size_t begin = block * kTidalBlock;
+        evaluate_tidal(source, points, out, begin, std::min(begin + kTidalBlock, count));
+    });
+}
+
+void PhysicsEngine::evaluate_tidal_grid(const TidalGrid& grid, TidalTensorArrays& tensors) const {
+    const std::size_t count = grid.size();
+    tensors.resize(count);
+    const TidalOutput out{tensors.xx.data(), tensors.xy.data(), tensors.xz.data(),
+                          tensors.yy.data(), tensors.yz.data(), tensors.zz.data()};
+    TidalSource source;
+    if (!get_tidal_source(source)) {
+        for (double* plane : {out.xx, out.xy, out.xz, out.yy, out.yz, out.zz}) {
+            std::fill(plane, plane + count, 0.0);
+        }
+        return;
+    }
+    if (count == 0) return;
+    
+    // Rows along x share one x array; each worker fills constant y and z rows
+    const std::size_t row_length = grid.count[0];
+    const std::size_t rows = grid.count[1] * grid.count[2];
+    std::vector<double> x(row_length);
+    for (std::size_t i = 0; i < row_length; ++i) {
+        x[i] = grid.origin.x() + static_cast<double>(i) * grid.spacing.x();
+    }
+    std::vector<std::vector<double>> y(pool_->get_thread_count()), z(pool_->get_thread_count());
+    
+    // Whole rows per task, about kTidalBlock points each
+    const std::size_t rows_per_task = std::max<std::size_t>(1, kTidalBlock / row_length);
+    const std::size_t tasks = (rows + rows_per_task - 1) / rows_per_task;
+    pool_->parallel_for(tasks, [&](std::size_t task, unsigned worker) {
+        std::vector<double>& row_y = y[worker];
+        std::vector<double>& row_z = z[worker];
+        row_y.resize(row_length);
+        row_z.resize(row_length);
+        const TidalPoints points{x.data(), row_y.data(), row_z.data()};
+        
+        const std::size_t end = std::min((task + 1) * rows_per_task, rows);
+        for (std::size_t row = task * rows_per_task; row < end; ++row) {
+            const std::size_t j = row % grid.count[1];
+            const std::size_t k = row / grid.count[1];
+            std::fill(row_y.begin(), row_y.end(), grid.origin.y() + static_cast<double>(j) * grid.spacing.y());
+            std::fill(row_z.begin(), row_z.end(), grid.origin.z() + static_cast<double>(k) * grid.spacing.z());
+            
+            const std::size_t offset = row * row_length;
+            const TidalOutput row_out{out.xx + offset, out.xy + offset, out.xz + offset,
+                                      out.yy + offset, out.yz + offset, out.zz + offset};
+            evaluate_tidal(source, points, row_out, 0, row_length);
+        }
+    });
+}
+
+void PhysicsEngine::evaluate_body_tidal_tensors(TidalTensorArrays& tensors) const {
+    evaluate_tidal_tensors(bodies_.x.data(), bodies_.y.data(), bodies_.z.data(), bodies_.size(), tensors);
+}
@@ -2,7 +2,15 @@
 #define PHYSICSENGINE_H
 
 #include "BlackHole.h"
+#include "GravityOctree.h"
+#include "PhysicsSnapshot.h"
+#include "SpatialHash.h"
+#include "TidalKernel.h"
+#include "ThreadPool.h"
 #include <Eigen/Dense>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 struct CelestialBody {
@@ -16,28 +24,235 @@ struct CelestialBody {
         : position(pos), velocity(vel), acceleration(Eigen::Vector3d::Zero()), mass(m), radius(r) {}
 };
 
+enum class GravitySolver {
+    Direct,     // Exact all-pairs sum, O(N^2)
+    BarnesHut   // Octree with quadrupole cells, O(N log N)
+};
+
+struct GravitySettings {
+    GravitySolver solver;
+    double opening_angle;  // Barnes-Hut cell extent over distance below which a cell is used whole
+    int leaf_size;         // Barnes-Hut bodies per leaf
+    
+    GravitySettings() :
+        solver(GravitySolver::Direct),
+        opening_angle(0.5),
+        leaf_size(16) {}
+};
+
+enum class TimeIntegrator {
+    Leapfrog,  // Kick-drift-kick, second order
+    Yoshida4   // Three leapfrog steps composed to fourth order
+};
+
+struct TimestepSettings {
+    TimeIntegrator integrator;
+    bool block_steps;   // Individual power-of-two steps per body instead of one shared step
+    double accuracy;    // Step as a fraction of |a| / |da/dt|
+    int max_level;      // Deepest halving of the update step
+    
+    TimestepSettings() :
+        integrator(TimeIntegrator::Leapfrog),
+        block_steps(false),
+        accuracy(0.02),
+        max_level(12) {}
+};
+
+enum class BodyEventType {
+    Collision,        // Merged into another body
+    HorizonCapture,   // Crossed the event horizon
+    TidalDisruption   // Torn apart by the hole's tidal field
+};
+
+// A body removed from the simulation, as it was when removed
+struct BodyEvent {
+    BodyEventType type;
+    std::uint32_t body;   // Id of the removed body
+    std::uint32_t other;  // For collisions the id of the body it merged into, else body
+    double time;          // Simulation time in seconds
+    Eigen::Vector3d position;
+    Eigen::Vector3d velocity;
+    double mass;
+    double radius;
+};
+
+struct BodyEventSettings {
+    bool collisions;
+    bool horizon_capture;
+    bool tidal_disruption;
+    
+    BodyEventSettings() :
+        collisions(true),
+        horizon_capture(true),
+        tidal_disruption(true) {}
+};
+
+// Symmetric tidal tensors as structure of arrays, one entry per point. The
+// tidal acceleration of a small offset d from a point is T d.
+struct TidalTensorArrays {
+    std::vector<double> xx, xy, xz, yy, yz, zz;
+    
+    std::size_t size() const { return xx.size(); }
+    void resize(std::size_t count);
+    Eigen::Matrix3d get(std::size_t index) const;
+};
+
+// Regular grid of count[0] x count[1] x count[2] points; x varies fastest
+struct TidalGrid {
+    Eigen::Vector3d origin;
+    Eigen::Vector3d spacing;
+    std::size_t count[3];
+    
+    TidalGrid() :
+        origin(Eigen::Vector3d::Zero()),
+        spacing(Eigen::Vector3d::Ones()),
+        count{0, 0, 0} {}
+    
+    std::size_t size() const { return count[0] * count[1] * count[2]; }
+};
+
+// Body state as structure of arrays, one entry per body in every array
+struct BodyArrays {
+    std::vector<double> x, y, z;
+    std::vector<double> vx, vy, vz;
+    std::vector<double> ax, ay, az;
+    std::vector<double> mass;
+    std::vector<double> radius;
+    std::vector<std::uint32_t> id;  // Stable across removals, unlike the index
+    
+    std::size_t size() const { return mass.size(); }
+    void push_back(const CelestialBody& body, std::uint32_t body_id);
+    void swap_remove(std::size_t index);  // Moves the last body into index
+    CelestialBody get(std::size_t index) const;
+    Eigen::Vector3d position(std::size_t index) const { return Eigen::Vector3d(x[index], y[index], z[index]); }
+};
+
+// Newtonian N-body integration around the black hole.
+//
+// Each step is one velocity-Verlet (kick-drift-kick) step that evaluates the
+// forces once; the accelerations at the end of a step start the next one.
+// Yoshida4 runs three such steps of w1, w0, w1 times the update step.
+//
+// With block steps every body steps by the update step over 2^level, its level
+// chosen from accuracy * |a| / |jerk|. The jerk is the larger of the hole's
+// exact one and the change of the body's acceleration over its last step. All
+// bodies drift together to the next step end, and only the bodies ending a step
+// there get new forces and kicks. A body can move to a longer step only where
+// that step's boundaries fall. Every body is synchronized at the end of update.
+// The all-pairs sum runs in blocks of targets on an owned thread pool, each
+// block sweeping the sources in cache-sized chunks with the widest SIMD kernel
+// the CPU runs. Every body's acceleration is summed by one task in source
+// order, so results do not depend on the thread count or on scheduling. The
+// Barnes-Hut solver rebuilds a GravityOctree every evaluation instead. Either
+// way the hole is an exact external point mass.
 class PhysicsEngine {
 public:
-    PhysicsEngine();
+    // thread_count = 0 uses all hardware threads
+    explicit PhysicsEngine(unsigned thread_count = 0);
     
     void set_black_hole(const std::shared_ptr<BlackHole>& black_hole);
-    void add_body(const CelestialBody& body);
+    std::uint32_t add_body(const CelestialBody& body);  // Returns the body's id
     
     void update(double delta_time);
     
-    const std::vector<CelestialBody>& get_bodies() const { return bodies_; }
+    std::size_t get_body_count() const { return bodies_.size(); }
+    CelestialBody get_body(std::size_t index) const { return bodies_.get(index); }
+    std::vector<CelestialBody> get_bodies() const;  // Copy of every body
+    const BodyArrays& get_body_arrays() const { return bodies_; }
     std::shared_ptr<BlackHole> get_black_hole() const { return black_hole_; }
+    double get_time() const { return time_; }
+    
+    void set_event_settings(const BodyEventSettings& settings) { events_settings_ = settings; }
+    const BodyEventSettings& get_event_settings() const { return events_settings_; }
+    
+    // Appends the events since the last call to events and clears the queue
+    std::size_t take_events(std::vector<BodyEvent>& events);
+    std::size_t get_pending_event_count() const { return events_.size(); }
+    
+    void set_gravity_settings(const GravitySettings& settings);
+    const GravitySettings& get_gravity_settings() const { return gravity_; }
+    const GravityOctree& get_octree() const { return octree_; }
+    
+    void set_timestep_settings(const TimestepSettings& settings) { timestep_ = settings; }
+    const TimestepSettings& get_timestep_settings() const { return timestep_; }
+    
+    // Body accelerations evaluated so far, to compare stepping schemes
+    std::uint64_t get_force_evaluation_count() const { return force_evaluations_; }
+    // Block step level of a body after the last update, 0 for the full step
+    int get_body_level(std::size_t index) const { return index < levels_.size() ? levels_[index] : 0; }
+    
+    // Whole state including settings, block step state and the body ids. Loading
+    // replaces the black hole with one built from the saved parameters.
+    void save_snapshot(PhysicsSnapshot& snapshot) const;
+    bool load_snapshot(const PhysicsSnapshot& snapshot);
+    
+    // Plummer softening of body-body gravity in meters, 0 for point masses
+    void set_softening_length(double length);
+    double get_softening_length() const { return softening_length_; }
     
     // Calculate tidal forces
     Eigen::Vector3d calculate_tidal_forces(const Eigen::Vector3d& position) const;
     
+    // Tidal tensor of the hole, GM (3 n n^T - I) / r^3. This is the electric part
+    // of the Schwarzschild Riemann tensor in a static observer's frame, without
+    // spin corrections. The batched forms run the widest SIMD kernel on the
+    // thread pool and give zeros without a black hole; they must not run while
+    // update does on another thread.
+    Eigen::Matrix3d calculate_tidal_tensor(const Eigen::Vector3d& position) const;
+    void evaluate_tidal_tensors(const double* x, const double* y, const double* z, std::size_t count,
+                                TidalTensorArrays& tensors) const;
+    void evaluate_tidal_grid(const TidalGrid& grid, TidalTensorArrays& tensors) const;
+    void evaluate_body_tidal_tensors(TidalTensorArrays& tensors) const;  // In body order
+
 private:
     std::shared_ptr<BlackHole> black_hole_;
-    std::vector<CelestialBody> bodies_;
+    BodyArrays bodies_;
+    std::unique_ptr<ThreadPool> pool_;
+    GravitySettings gravity_;
+    GravityOctree octree_;
+    TimestepSettings timestep_;
+    BodyEventSettings events_settings_;
+    double softening_length_;
+    double time_;
+    std::uint32_t next_id_;
+    bool accelerations_valid_;
+    std::uint64_t force_evaluations_;
+    
+    // Block step state, one entry per body; levels_ and jerks_ follow every add and removal
+    std::vector<int> levels_;
+    std::vector<std::uint64_t> step_ends_;  // In ticks of the current step
+    std::vector<double> jerks_;             // |da/dt| over the last step
+    
+    // Bodies ending a step at the current tick and their previous accelerations
+    std::vector<std::uint32_t> active_;
+    std::vector<unsigned char> active_flags_;
+    std::vector<double> previous_ax_, previous_ay_, previous_az_;
+    
+    // All positions and masses followed by copies of the active bodies, so the
+    // pair kernels can take the active bodies as one contiguous target range
+    struct GatherArrays {
+        std::vector<double> x, y, z, mass;
+        std::vector<double> ax, ay, az;
+    };
+    GatherArrays gather_;
+    
+    SpatialHash collision_hash_;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> overlaps_;
+    std::vector<unsigned char> removed_;
+    std::vector<std::uint32_t> removals_;
+    std::vector<BodyEvent> events_;
     
     const double G = 6.67430e-11;  // Gravitational constant
     
+    void leapfrog_step(double delta_time);
+    void block_step(double delta_time);
+    int choose_level(std::size_t index, double delta_time, int max_level) const;
     void compute_gravitational_forces();
+    void compute_active_forces();
+    void finish_accelerations(const std::uint32_t* targets, std::size_t count);
+    void resolve_body_events();
+    void record_event(BodyEventType type, std::size_t index, std::uint32_t other);
+    bool get_tidal_source(TidalSource& source) const;
 };
 
 #endif
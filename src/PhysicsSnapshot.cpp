@@ -0,0 +1,282 @@
+#include "PhysicsSnapshot.h"
+#include "PhysicsEngine.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PHYSICS_SNAPSHOT_MMAP 1
+#endif
+
+namespace {
+
+const char kMagic[8] = {'B', 'H', 'S', 'N', 'A', 'P', '\0', '\0'};
+const std::uint32_t kEndianMarker = 0x01020304u;
+
+// Planes start on cache lines
+const std::uint64_t kAlignment = 64;
+
+inline std::uint64_t align_up(std::uint64_t size) {
+    return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// Double planes plus the id plane
+const std::uint64_t kPlaneCount = static_cast<std::uint64_t>(SnapshotPlane::Count) + 1;
+
+}
+
+PhysicsSnapshot::PhysicsSnapshot()
+    : mapping_(nullptr), mapping_size_(0), header_(nullptr), data_(nullptr) {
+    static_assert(sizeof(SnapshotHeader) == 160, "PhysicsSnapshot header layout changed");
+}
+
+PhysicsSnapshot::~PhysicsSnapshot() {
+    release();
+}
+
+void PhysicsSnapshot::release() {
+#ifdef PHYSICS_SNAPSHOT_MMAP
+    if (mapping_) {
+        munmap(mapping_, mapping_size_);
+    }
+#endif
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+    header_ = nullptr;
+    data_ = nullptr;
+}
+
+void PhysicsSnapshot::attach(unsigned char* data, std::size_t size) {
+    header_ = nullptr;
+    data_ = nullptr;
+    if (size < sizeof(SnapshotHeader)) return;
+
+    SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(data);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0) return;
+    if (header->version != kVersion || header->endian_marker != kEndianMarker) return;
+
+    // Planes after the header, 8-byte aligned and inside the file; checked by
+    // division so a corrupt header cannot overflow the bounds
+    if (header->data_offset < sizeof(SnapshotHeader) || header->data_offset > size) return;
+    if (header->data_offset % 8 != 0 || header->plane_stride % 8 != 0) return;
+    if (header->plane_stride > (size - header->data_offset) / kPlaneCount) return;
+    if (header->body_count > header->plane_stride / sizeof(double)) return;
+
+    header_ = header;
+    data_ = data;
+}
+
+void PhysicsSnapshot::allocate(std::size_t body_count) {
+    release();
+
+    const std::uint64_t data_offset = align_up(sizeof(SnapshotHeader));
+    const std::uint64_t stride = align_up(body_count * sizeof(double));
+    const std::uint64_t size = data_offset + kPlaneCount * stride;
+    buffer_.resize(size / sizeof(std::uint64_t));
+    std::memset(buffer_.data(), 0, data_offset);
+
+    SnapshotHeader* header = reinterpret_cast<SnapshotHeader*>(buffer_.data());
+    std::memcpy(header->magic, kMagic, sizeof(kMagic));
+    header->version = kVersion;
+    header->endian_marker = kEndianMarker;
+    header->body_count = body_count;
+    header->plane_stride = stride;
+    header->data_offset = data_offset;
+    attach(reinterpret_cast<unsigned char*>(buffer_.data()), size);
+}
+
+std::size_t PhysicsSnapshot::get_byte_size() const {
+    if (!header_) return 0;
+    return static_cast<std::size_t>(header_->data_offset + kPlaneCount * header_->plane_stride);
+}
+
+const double* PhysicsSnapshot::get_plane(SnapshotPlane plane) const {
+    return reinterpret_cast<const double*>(data_ + header_->data_offset +
+                                           static_cast<std::uint64_t>(plane) * header_->plane_stride);
+}
+
+double* PhysicsSnapshot::get_plane(SnapshotPlane plane) {
+    return reinterpret_cast<double*>(data_ + header_->data_offset +
+                                     static_cast<std::uint64_t>(plane) * header_->plane_stride);
+}
+
+const std::uint32_t* PhysicsSnapshot::get_ids() const {
+    return reinterpret_cast<const std::uint32_t*>(data_ + header_->data_offset +
+                                                  (kPlaneCount - 1) * header_->plane_stride);
+}
+
+std::uint32_t* PhysicsSnapshot::get_ids() {
+    return reinterpret_cast<std::uint32_t*>(data_ + header_->data_offset +
+                                            (kPlaneCount - 1) * header_->plane_stride);
+}
+
+bool PhysicsSnapshot::save(const std::string& path) const {
+    if (!header_) return false;
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+        file.write(reinterpret_cast<const char*>(data_), static_cast<std::streamsize>(get_byte_size()));
+        if (!file) return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+bool PhysicsSnapshot::load(const std::string& path) {
+    release();
+
+#ifdef PHYSICS_SNAPSHOT_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    // Copy-on-write, so edits stay in memory
+    void* mapping = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    mapping_ = mapping;
+    mapping_size_ = static_cast<std::size_t>(info.st_size);
+    attach(static_cast<unsigned char*>(mapping_), mapping_size_);
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::size_t size = static_cast<std::size_t>(file.tellg());
+    buffer_.assign((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t), 0);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(size));
+    if (!file) return false;
+    attach(reinterpret_cast<unsigned char*>(buffer_.data()), size);
+#endif
+
+    if (!header_) {
+        release();
+        return false;
+    }
+    return true;
+}
+
+CheckpointWriter::CheckpointWriter(const CheckpointSettings& settings)
+    : settings_(settings), scheduled_(false), next_time_(0.0),
+      spare_(std::make_unique<PhysicsSnapshot>()), stop_(false),
+      sequence_(0), written_count_(0), skipped_count_(0) {
+    std::error_code error;
+    std::filesystem::create_directories(settings_.directory, error);
+    thread_ = std::thread([this] { run(); });
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queued_.notify_one();
+    thread_.join();
+}
+
+bool CheckpointWriter::maybe_checkpoint(const PhysicsEngine& engine) {
+    if (!scheduled_) {
+        scheduled_ = true;
+        next_time_ = engine.get_time() + settings_.interval;
+        return false;
+    }
+    if (engine.get_time() < next_time_) return false;
+    if (!checkpoint(engine)) return false;
+    next_time_ = engine.get_time() + settings_.interval;
+    return true;
+}
+
+bool CheckpointWriter::checkpoint(const PhysicsEngine& engine) {
+    std::unique_ptr<PhysicsSnapshot> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!spare_) {
+            ++skipped_count_;
+            return false;
+        }
+        snapshot = std::move(spare_);
+    }
+
+    // The only work on the step loop: one copy of the arrays
+    engine.save_snapshot(*snapshot);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(snapshot);
+    }
+    queued_.notify_one();
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    written_.wait(lock, [this] { return spare_ != nullptr; });
+}
+
+std::uint64_t CheckpointWriter::get_written_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_count_;
+}
+
+std::uint64_t CheckpointWriter::get_skipped_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return skipped_count_;
+}
+
+std::string CheckpointWriter::get_last_path() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_path_;
+}
+
+void CheckpointWriter::run() {
+    for (;;) {
+        std::unique_ptr<PhysicsSnapshot> snapshot;
+        std::uint64_t sequence;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queued_.wait(lock, [this] { return pending_ != nullptr || stop_; });
+            if (!pending_) return;
+            snapshot = std::move(pending_);
+            sequence = sequence_++;
+        }
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "checkpoint_%08llu.bin", static_cast<unsigned long long>(sequence));
+        std::string path = settings_.directory + "/" + name;
+        bool saved = snapshot->save(path);
+        if (!saved) {
+            std::cerr << "Failed to write checkpoint " << path << std::endl;
+        }
+
+        if (settings_.keep > 0 && sequence >= static_cast<std::uint64_t>(settings_.keep)) {
+            std::snprintf(name, sizeof(name), "checkpoint_%08llu.bin",
+                          static_cast<unsigned long long>(sequence - settings_.keep));
+            std::error_code error;
+            std::filesystem::remove(settings_.directory + "/" + name, error);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            spare_ = std::move(snapshot);
+            if (saved) {
+                ++written_count_;
+                last_path_ = path;
+            }
+        }
+        written_.notify_all();
+    }
+}
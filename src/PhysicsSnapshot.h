@@ -0,0 +1,163 @@
+#ifndef PHYSICSSNAPSHOT_H
+#define PHYSICSSNAPSHOT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class PhysicsEngine;
+
+// Per-body arrays of a snapshot, in file order
+enum class SnapshotPlane {
+    X, Y, Z,
+    VelocityX, VelocityY, VelocityZ,
+    AccelerationX, AccelerationY, AccelerationZ,
+    Mass,
+    Radius,
+    Jerk,   // Block step jerk estimate
+    Count
+};
+
+// Scalar state ahead of the planes; fixed layout, written as is
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t endian_marker;
+    std::uint64_t body_count;
+    std::uint64_t plane_stride;   // Bytes from one plane to the next, a multiple of 64
+    std::uint64_t data_offset;
+    double time;
+    double softening_length;
+    double hole_mass;             // Black hole, when has_black_hole
+    double hole_spin;
+    double hole_disk_inner_radius;
+    double hole_disk_outer_radius;
+    double hole_position[3];
+    double opening_angle;         // GravitySettings
+    double accuracy;              // TimestepSettings
+    std::int32_t solver;
+    std::int32_t leaf_size;
+    std::int32_t integrator;
+    std::int32_t block_steps;
+    std::int32_t max_level;
+    std::uint32_t has_black_hole;
+    std::uint32_t accelerations_valid;
+    std::uint32_t next_id;
+};
+
+// Complete PhysicsEngine state: black hole, settings, simulation time and every
+// body.
+//
+// Files are versioned and in host byte order: the header, then one 64-byte
+// aligned plane per SnapshotPlane holding a double per body, then the body ids.
+// An endian marker in the header makes files from a host of the other byte
+// order fail to load rather than be misread. Loading maps the file
+// copy-on-write, so a state of any size is usable without parsing and can be
+// edited to branch a scenario without touching the file. Saving writes a
+// temporary file and renames it over the target, so a crash never leaves a torn
+// snapshot.
+class PhysicsSnapshot {
+public:
+    static const std::uint32_t kVersion = 1;
+
+    PhysicsSnapshot();
+    ~PhysicsSnapshot();
+
+    PhysicsSnapshot(const PhysicsSnapshot&) = delete;
+    PhysicsSnapshot& operator=(const PhysicsSnapshot&) = delete;
+
+    // Owned snapshot for body_count bodies with a zeroed header; the planes are
+    // left to the caller, and the buffer is reused when it is large enough
+    void allocate(std::size_t body_count);
+
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+
+    bool is_valid() const { return header_ != nullptr; }
+    std::size_t get_body_count() const { return header_ ? static_cast<std::size_t>(header_->body_count) : 0; }
+    std::size_t get_byte_size() const;
+
+    const SnapshotHeader& get_header() const { return *header_; }
+    SnapshotHeader& get_header() { return *header_; }
+    const double* get_plane(SnapshotPlane plane) const;
+    double* get_plane(SnapshotPlane plane);
+    const std::uint32_t* get_ids() const;
+    std::uint32_t* get_ids();
+
+private:
+    // Either a private mapping of a file or an owned buffer with the same layout
+    void* mapping_;
+    std::size_t mapping_size_;
+    std::vector<std::uint64_t> buffer_;  // 8-byte aligned storage
+
+    SnapshotHeader* header_;
+    unsigned char* data_;
+
+    void attach(unsigned char* data, std::size_t size);
+    void release();
+};
+
+struct CheckpointSettings {
+    std::string directory;
+    double interval;   // Simulation seconds between checkpoints
+    int keep;          // Newest files kept on disk
+
+    CheckpointSettings() :
+        directory("checkpoints"),
+        interval(3600.0),
+        keep(3) {}
+};
+
+// Periodic snapshots written by a background thread.
+//
+// The step loop only copies the engine's arrays into a reused snapshot buffer;
+// the file is written on the writer thread. If the previous checkpoint is still
+// being written the new one is skipped rather than waited for, so a slow disk
+// never stalls the simulation. Files are named checkpoint_<sequence>.bin and
+// the oldest are deleted beyond keep.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const CheckpointSettings& settings = CheckpointSettings());
+    ~CheckpointWriter();  // Finishes the queued checkpoint
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // Checkpoints when interval has passed since the last one; call after each update
+    bool maybe_checkpoint(const PhysicsEngine& engine);
+    // Checkpoints now; false if skipped because the writer is busy
+    bool checkpoint(const PhysicsEngine& engine);
+    // Blocks until the queued checkpoint is on disk
+    void wait();
+
+    std::uint64_t get_written_count() const;
+    std::uint64_t get_skipped_count() const;
+    std::string get_last_path() const;  // Newest checkpoint on disk
+    const CheckpointSettings& get_settings() const { return settings_; }
+
+private:
+    CheckpointSettings settings_;
+    bool scheduled_;
+    double next_time_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable written_;
+    std::unique_ptr<PhysicsSnapshot> pending_;  // Queued for the writer thread
+    std::unique_ptr<PhysicsSnapshot> spare_;    // Null while a checkpoint is in flight
+    bool stop_;
+    std::uint64_t sequence_;
+    std::uint64_t written_count_;
+    std::uint64_t skipped_count_;
+    std::string last_path_;
+    std::thread thread_;
+
+    void run();
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include "PhysicsThread.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Longest single sleep, so stop() is answered promptly
+const double kMaxSleep = 0.02;
+
+}
+
+float BodyFrame::blend(double display_time) const {
+    if (!(time > previous_time)) return 1.0f;
+    double t = (display_time - previous_time) / (time - previous_time);
+    return static_cast<float>(std::clamp(t, 0.0, 1.0));
+}
+
+PhysicsThread::PhysicsThread(PhysicsEngine& engine, const PhysicsThreadSettings& settings)
+    : engine_(engine), settings_(settings), stop_(false), step_count_(0), dropped_steps_(0) {}
+
+PhysicsThread::~PhysicsThread() {
+    stop();
+}
+
+void PhysicsThread::start() {
+    if (thread_.joinable()) return;
+    stop_.store(false);
+
+    // The first frame is ready before start returns
+    previous_positions_.clear();
+    previous_slots_.clear();
+    publish(engine_.get_time(), 0.0);
+    thread_ = std::thread([this] { run(); });
+}
+
+void PhysicsThread::stop() {
+    if (!thread_.joinable()) return;
+    stop_.store(true);
+    thread_.join();
+}
+
+const BodyFrame& PhysicsThread::acquire_frame() {
+    frames_.update();
+    return frames_.get_front();
+}
+
+double PhysicsThread::get_display_time(const BodyFrame& frame) const {
+    double since = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame.published).count();
+    return frame.time + frame.remainder - settings_.fixed_step + since * settings_.time_scale;
+}
+
+std::size_t PhysicsThread::take_events(std::vector<BodyEvent>& events) {
+    std::lock_guard<std::mutex> lock(events_mutex_);
+    const std::size_t count = events_.size();
+    events.insert(events.end(), events_.begin(), events_.end());
+    events_.clear();
+    return count;
+}
+
+void PhysicsThread::run() {
+    using clock = std::chrono::steady_clock;
+    const double step = settings_.fixed_step;
+    const int max_steps = std::max(settings_.max_catch_up_steps, 1);
+
+    double accumulator = 0.0;
+    clock::time_point last = clock::now();
+    while (!stop_.load(std::memory_order_relaxed)) {
+        clock::time_point now = clock::now();
+        accumulator += std::chrono::duration<double>(now - last).count() * settings_.time_scale;
+        last = now;
+
+        // Whole steps only; the remainder waits for the next wake-up
+        double due = std::floor(accumulator / step);
+        int steps = static_cast<int>(std::min(due, static_cast<double>(max_steps)));
+        if (due > steps) {
+            dropped_steps_.fetch_add(static_cast<std::uint64_t>(due - steps), std::memory_order_relaxed);
+            accumulator -= (due - steps) * step;
+        }
+
+        double previous_time = engine_.get_time();
+        for (int k = 0; k < steps; ++k) {
+            if (k == steps - 1) {
+                remember_positions();
+                previous_time = engine_.get_time();
+            }
+            engine_.update(step);
+            engine_.take_events(step_events_);
+            accumulator -= step;
+            step_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (steps > 0) {
+            publish(previous_time, accumulator);
+            if (!step_events_.empty()) {
+                std::lock_guard<std::mutex> lock(events_mutex_);
+                events_.insert(events_.end(), step_events_.begin(), step_events_.end());
+                step_events_.clear();
+            }
+        }
+
+        double wait = std::min((step - accumulator) / settings_.time_scale, kMaxSleep);
+        if (wait > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    }
+}
+
+void PhysicsThread::remember_positions() {
+    const BodyArrays& b = engine_.get_body_arrays();
+    const std::size_t count = b.size();
+    previous_positions_.resize(3 * count);
+    std::fill(previous_slots_.begin(), previous_slots_.end(), -1);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (b.id[i] >= previous_slots_.size()) {
+            previous_slots_.resize(b.id[i] + 1, -1);
+        }
+        previous_slots_[b.id[i]] = static_cast<std::int32_t>(i);
+        previous_positions_[3 * i] = static_cast<float>(b.x[i]);
+        previous_positions_[3 * i + 1] = static_cast<float>(b.y[i]);
+        previous_positions_[3 * i + 2] = static_cast<float>(b.z[i]);
+    }
+}
+
+void PhysicsThread::publish(double previous_time, double remainder) {
+    const BodyArrays& b = engine_.get_body_arrays();
+    const std::size_t count = b.size();
+    BodyFrame& frame = frames_.get_back();
+    frame.previous_time = previous_time;
+    frame.time = engine_.get_time();
+    frame.remainder = remainder;
+    frame.ids.assign(b.id.begin(), b.id.end());
+    frame.current.resize(3 * count);
+    frame.previous.resize(3 * count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        float* current = &frame.current[3 * i];
+        current[0] = static_cast<float>(b.x[i]);
+        current[1] = static_cast<float>(b.y[i]);
+        current[2] = static_cast<float>(b.z[i]);
+
+        // Bodies added since the last step start in place
+        std::uint32_t id = b.id[i];
+        std::int32_t slot = id < previous_slots_.size() ? previous_slots_[id] : -1;
+        const float* previous = slot >= 0 ? &previous_positions_[3 * slot] : current;
+        std::copy(previous, previous + 3, &frame.previous[3 * i]);
+    }
+
+    frame.published = std::chrono::steady_clock::now();
+    frames_.publish();
+}
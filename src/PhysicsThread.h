@@ -0,0 +1,99 @@
+#ifndef PHYSICSTHREAD_H
+#define PHYSICSTHREAD_H
+
+#include "PhysicsEngine.h"
+#include "TripleBuffer.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct PhysicsThreadSettings {
+    double fixed_step;       // Simulation seconds per update
+    double time_scale;       // Simulation seconds per wall-clock second
+    int max_catch_up_steps;  // Updates per wake-up; further backlog is dropped
+
+    PhysicsThreadSettings() :
+        fixed_step(100.0),
+        time_scale(1.0e4),
+        max_catch_up_steps(8) {}
+};
+
+// Body positions after one fixed step and before it, for interpolation
+struct BodyFrame {
+    double previous_time;
+    double time;
+    double remainder;  // Accumulated simulation time not yet stepped when published
+    std::chrono::steady_clock::time_point published;
+    std::vector<float> previous;  // x, y, z per body, same order as current
+    std::vector<float> current;
+    std::vector<std::uint32_t> ids;
+
+    BodyFrame() : previous_time(0.0), time(0.0), remainder(0.0) {}
+
+    std::size_t size() const { return ids.size(); }
+
+    // Fraction of the way from previous to current at a display time
+    float blend(double display_time) const;
+};
+
+// Runs a PhysicsEngine on its own thread at a fixed timestep.
+//
+// Wall-clock time scaled by time_scale accumulates, and whole fixed steps are
+// taken from it; a backlog beyond max_catch_up_steps is dropped, so a step
+// heavier than real time slows the simulation instead of spiralling. After
+// each wake-up the bodies are published through a TripleBuffer with their
+// positions before the last step, matched by id across removals. The renderer
+// reads frames without locks and shows them one step in the past, blending
+// between the two states, so neither thread ever waits for the other.
+//
+// The engine must not be touched from other threads while running; body events
+// are forwarded to take_events.
+class PhysicsThread {
+public:
+    explicit PhysicsThread(PhysicsEngine& engine,
+                           const PhysicsThreadSettings& settings = PhysicsThreadSettings());
+    ~PhysicsThread();  // Stops the thread
+
+    PhysicsThread(const PhysicsThread&) = delete;
+    PhysicsThread& operator=(const PhysicsThread&) = delete;
+
+    void start();
+    void stop();
+    bool is_running() const { return thread_.joinable(); }
+
+    // Render thread only: newest published frame, never blocks
+    const BodyFrame& acquire_frame();
+    // Simulation time the renderer should show now, one step behind the newest state
+    double get_display_time(const BodyFrame& frame) const;
+
+    std::size_t take_events(std::vector<BodyEvent>& events);
+    std::uint64_t get_step_count() const { return step_count_.load(std::memory_order_relaxed); }
+    std::uint64_t get_dropped_step_count() const { return dropped_steps_.load(std::memory_order_relaxed); }
+    const PhysicsThreadSettings& get_settings() const { return settings_; }
+
+private:
+    PhysicsEngine& engine_;
+    PhysicsThreadSettings settings_;
+    TripleBuffer<BodyFrame> frames_;
+    std::thread thread_;
+    std::atomic<bool> stop_;
+    std::atomic<std::uint64_t> step_count_;
+    std::atomic<std::uint64_t> dropped_steps_;
+
+    std::mutex events_mutex_;
+    std::vector<BodyEvent> events_;
+    std::vector<BodyEvent> step_events_;
+
+    // Positions before the latest step, indexed through previous_slots_ by id
+    std::vector<float> previous_positions_;
+    std::vector<std::int32_t> previous_slots_;
+
+    void run();
+    void remember_positions();
+    void publish(double previous_time, double remainder);
+};
+
+#endif
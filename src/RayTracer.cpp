@@ -0,0 +1,443 @@
+#include "RayTracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+// Integer hash for the procedural star field
+inline std::uint32_t hash_cell(std::uint32_t x, std::uint32_t y) {
+    std::uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u;
+    h ^= h >> 13;
+    h *= 0x85ebca6bu;
+    h ^= h >> 16;
+    return h;
+}
+
+bool same_geodesic_settings(const GeodesicSettings& a, const GeodesicSettings& b) {
+    return a.relative_tolerance == b.relative_tolerance && a.absolute_tolerance == b.absolute_tolerance &&
+           a.initial_step == b.initial_step && a.min_step == b.min_step &&
+           a.max_step_fraction == b.max_step_fraction && a.escape_radius == b.escape_radius &&
+           a.horizon_epsilon == b.horizon_epsilon && a.event_tolerance == b.event_tolerance &&
+           a.max_steps == b.max_steps && a.use_simd_packets == b.use_simd_packets &&
+           a.use_closed_form == b.use_closed_form && a.mixed_precision == b.mixed_precision &&
+           a.promotion_radius == b.promotion_radius && a.float_tolerance == b.float_tolerance;
+}
+
+}
+
+RayTracer::RayTracer(int width, int height, unsigned thread_count)
+    : width_(width), height_(height),
+      settings_(),
+      pool_(thread_count),
+      framebuffer_(static_cast<std::size_t>(width) * height * 3, 0.0f) {
+    unsigned threads = pool_.get_thread_count();
+    worker_rays_.resize(threads);
+    worker_results_.resize(threads);
+    worker_steps_.resize(threads);
+    worker_rays_traced_.resize(threads);
+    worker_samples_.resize(threads);
+    worker_cells_.resize(threads);
+    worker_pending_.resize(threads);
+}
+
+void RayTracer::render(const BlackHole& black_hole,
+                       const Eigen::Vector3d& camera_pos,
+                       const Eigen::Vector3d& camera_target,
+                       const Eigen::Vector3d& camera_up) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const double scene_scale = 0.5 * black_hole.get_event_horizon_radius();  // GM/c^2
+
+    FrameCamera camera;
+    camera.origin = black_hole.get_parameters().position + camera_pos * scene_scale;
+    camera.offset = camera_pos;
+    camera.front = (camera_target - camera_pos).normalized();
+    camera.right = camera.front.cross(camera_up).normalized();
+    camera.up = camera.right.cross(camera.front);
+    camera.scale_y = std::tan(settings_.field_of_view * M_PI / 360.0);
+    camera.scale_x = camera.scale_y * static_cast<double>(width_) / height_;
+
+    if (!disk_emission_.matches(black_hole.get_parameters())) {
+        disk_emission_.build(black_hole.get_parameters());
+    }
+
+    std::fill(worker_steps_.begin(), worker_steps_.end(), 0);
+    std::fill(worker_rays_traced_.begin(), worker_rays_traced_.end(), 0);
+    std::size_t steals_before = pool_.get_steal_count();
+
+    if (settings_.environment_cache) {
+        render_environment(black_hole, camera);
+    } else if (settings_.adaptive) {
+        render_adaptive(black_hole, camera);
+    } else {
+        render_tiles(black_hole, camera);
+    }
+
+    stats_.pixels = static_cast<std::size_t>(width_) * height_;
+    stats_.threads = pool_.get_thread_count();
+    stats_.steals = pool_.get_steal_count() - steals_before;
+    stats_.rays = 0;
+    stats_.integration_steps = 0;
+    for (unsigned worker = 0; worker < stats_.threads; ++worker) {
+        stats_.rays += worker_rays_traced_[worker];
+        stats_.integration_steps += worker_steps_[worker];
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats_.frame_seconds = std::chrono::duration<double>(end - start).count();
+}
+
+Eigen::Vector3d RayTracer::pixel_direction(const FrameCamera& camera, int x, int y) const {
+    double ndc_x = (2.0 * (x + 0.5) / width_ - 1.0) * camera.scale_x;
+    double ndc_y = (2.0 * (y + 0.5) / height_ - 1.0) * camera.scale_y;
+    return camera.front + camera.right * ndc_x + camera.up * ndc_y;
+}
+
+void RayTracer::write_pixel(int x, int y, const Eigen::Vector3f& color) {
+    float* pixel = &framebuffer_[(static_cast<std::size_t>(y) * width_ + x) * 3];
+    pixel[0] = color.x();
+    pixel[1] = color.y();
+    pixel[2] = color.z();
+}
+
+void RayTracer::render_tiles(const BlackHole& black_hole, const FrameCamera& camera) {
+    const int tile = std::max(1, settings_.tile_size);
+    const int tiles_x = (width_ + tile - 1) / tile;
+    const int tiles_y = (height_ + tile - 1) / tile;
+    const std::size_t tile_count = static_cast<std::size_t>(tiles_x) * tiles_y;
+
+    pool_.parallel_for(tile_count, [&](std::size_t index, unsigned worker) {
+        int x0 = static_cast<int>(index % tiles_x) * tile;
+        int y0 = static_cast<int>(index / tiles_x) * tile;
+        int x1 = std::min(x0 + tile, width_);
+        int y1 = std::min(y0 + tile, height_);
+
+        std::vector<GeodesicRay>& rays = worker_rays_[worker];
+        std::vector<GeodesicResult>& results = worker_results_[worker];
+        rays.clear();
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                rays.push_back(GeodesicRay{camera.origin, pixel_direction(camera, x, y)});
+            }
+        }
+
+        results.resize(rays.size());
+        black_hole.trace_geodesics(rays.data(), results.data(), rays.size(), settings_.geodesic);
+        worker_rays_traced_[worker] += rays.size();
+
+        std::size_t i = 0;
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x, ++i) {
+                write_pixel(x, y, shade(results[i]));
+                worker_steps_[worker] += results[i].steps + results[i].rejected_steps;
+            }
+        }
+    });
+
+    stats_.tiles = tile_count;
+}
+
+void RayTracer::render_adaptive(const BlackHole& black_hole, const FrameCamera& camera) {
+    const int cell = std::max(1, settings_.adaptive_cell);
+    const int cells_x = std::max(1, (width_ - 2 + cell) / cell);
+    const int cells_y = std::max(1, (height_ - 2 + cell) / cell);
+    const int points_x = cells_x + 1;
+    const int points_y = cells_y + 1;
+
+    auto grid_x = [&](int i) { return std::min(i * cell, width_ - 1); };
+    auto grid_y = [&](int j) { return std::min(j * cell, height_ - 1); };
+
+    // Coarse grid, one row of corner rays per task
+    coarse_samples_.resize(static_cast<std::size_t>(points_x) * points_y);
+    pool_.parallel_for(points_y, [&](std::size_t j, unsigned worker) {
+        std::vector<GeodesicRay>& rays = worker_rays_[worker];
+        std::vector<GeodesicResult>& results = worker_results_[worker];
+        rays.clear();
+
+        int y = grid_y(static_cast<int>(j));
+        for (int i = 0; i < points_x; ++i) {
+            rays.push_back(GeodesicRay{camera.origin, pixel_direction(camera, grid_x(i), y)});
+        }
+
+        results.resize(rays.size());
+        black_hole.trace_geodesics(rays.data(), results.data(), rays.size(), settings_.geodesic);
+        worker_rays_traced_[worker] += rays.size();
+
+        for (int i = 0; i < points_x; ++i) {
+            coarse_samples_[j * points_x + i] = make_sample(results[i], rays[i].direction);
+            worker_steps_[worker] += results[i].steps + results[i].rejected_steps;
+        }
+    });
+
+    // Refine one row of coarse cells per task, level by level, so that each
+    // level of the row is traced as a single batch
+    pool_.parallel_for(static_cast<std::size_t>(cells_y), [&](std::size_t row, unsigned worker) {
+        const int cj = static_cast<int>(row);
+        const int origin_y = grid_y(cj);
+        const int h = grid_y(cj + 1) - origin_y;
+        const int stride = width_;
+
+        std::vector<GeodesicRay>& rays = worker_rays_[worker];
+        std::vector<GeodesicResult>& results = worker_results_[worker];
+        std::vector<PixelSample>& samples = worker_samples_[worker];
+        std::vector<RefineCell>& cells = worker_cells_[worker];
+        std::vector<std::size_t>& pending = worker_pending_[worker];
+
+        PixelSample empty = PixelSample();
+        empty.traced = false;
+        samples.assign(static_cast<std::size_t>(stride) * (h + 1), empty);
+        for (int i = 0; i < points_x; ++i) {
+            samples[grid_x(i)] = coarse_samples_[cj * points_x + i];
+            samples[h * stride + grid_x(i)] = coarse_samples_[(cj + 1) * points_x + i];
+        }
+
+        auto request = [&](int x, int y) {
+            std::size_t slot = static_cast<std::size_t>(y) * stride + x;
+            if (samples[slot].traced) return;
+            samples[slot].traced = true;
+            pending.push_back(slot);
+            rays.push_back(GeodesicRay{camera.origin, pixel_direction(camera, x, origin_y + y)});
+        };
+
+        // Every cell gets its center traced before it is judged: the cell is
+        // interpolated only if the center agrees with its corners and lies within
+        // refine_threshold of their bilinear prediction. The center is a corner
+        // of the children when the cell is split.
+        rays.clear();
+        pending.clear();
+        cells.clear();
+        for (int i = 0; i < cells_x; ++i) {
+            RefineCell root{grid_x(i), 0, grid_x(i + 1), h};
+            cells.push_back(root);
+            request((root.x0 + root.x1) / 2, (root.y0 + root.y1) / 2);
+        }
+
+        std::size_t begin = 0;
+        while (begin < cells.size()) {
+            if (!rays.empty()) {
+                results.resize(rays.size());
+                black_hole.trace_geodesics(rays.data(), results.data(), rays.size(), settings_.geodesic);
+                worker_rays_traced_[worker] += rays.size();
+                for (std::size_t k = 0; k < rays.size(); ++k) {
+                    samples[pending[k]] = make_sample(results[k], rays[k].direction);
+                    worker_steps_[worker] += results[k].steps + results[k].rejected_steps;
+                }
+                rays.clear();
+                pending.clear();
+            }
+
+            std::size_t end = cells.size();
+            for (std::size_t c = begin; c < end; ++c) {
+                RefineCell rc = cells[c];
+                if (rc.x1 - rc.x0 <= 1 && rc.y1 - rc.y0 <= 1) continue;
+
+                int xs[3] = {rc.x0, (rc.x0 + rc.x1) / 2, rc.x1};
+                int ys[3] = {rc.y0, (rc.y0 + rc.y1) / 2, rc.y1};
+
+                const PixelSample* corners[4] = {
+                    &samples[rc.y0 * stride + rc.x0], &samples[rc.y0 * stride + rc.x1],
+                    &samples[rc.y1 * stride + rc.x0], &samples[rc.y1 * stride + rc.x1]};
+                const PixelSample& center = samples[ys[1] * stride + xs[1]];
+
+                double inv_w = 1.0 / std::max(rc.x1 - rc.x0, 1);
+                double inv_h = 1.0 / std::max(rc.y1 - rc.y0, 1);
+                auto interpolate = [&](int x, int y, PixelSample& sample) {
+                    float fx = static_cast<float>((x - rc.x0) * inv_w);
+                    float fy = static_cast<float>((y - rc.y0) * inv_h);
+                    float w00 = (1.0f - fx) * (1.0f - fy), w10 = fx * (1.0f - fy);
+                    float w01 = (1.0f - fx) * fy, w11 = fx * fy;
+                    sample.deflection = corners[0]->deflection * w00 + corners[1]->deflection * w10 +
+                                        corners[2]->deflection * w01 + corners[3]->deflection * w11;
+                    sample.disk_radius = corners[0]->disk_radius * w00 + corners[1]->disk_radius * w10 +
+                                         corners[2]->disk_radius * w01 + corners[3]->disk_radius * w11;
+                    sample.redshift = corners[0]->redshift * w00 + corners[1]->redshift * w10 +
+                                      corners[2]->redshift * w01 + corners[3]->redshift * w11;
+                    sample.termination = corners[0]->termination;
+                    sample.disk_crossings = corners[0]->disk_crossings;
+                };
+
+                PixelSample predicted = center;
+                interpolate(xs[1], ys[1], predicted);
+                if (cell_agrees(corners, center, predicted)) {
+                    for (int y = rc.y0; y <= rc.y1; ++y) {
+                        for (int x = rc.x0; x <= rc.x1; ++x) {
+                            PixelSample& sample = samples[y * stride + x];
+                            if (!sample.traced) interpolate(x, y, sample);
+                        }
+                    }
+                    continue;
+                }
+
+                // Split in four, or in two when the cell is one pixel thin
+                int nx = rc.x1 - rc.x0 > 1 ? 2 : 1;
+                int ny = rc.y1 - rc.y0 > 1 ? 2 : 1;
+                if (nx == 1) xs[1] = rc.x1;
+                if (ny == 1) ys[1] = rc.y1;
+
+                for (int b = 0; b < ny; ++b) {
+                    for (int a = 0; a < nx; ++a) {
+                        RefineCell child{xs[a], ys[b], xs[a + 1], ys[b + 1]};
+                        cells.push_back(child);
+                        request(child.x0, child.y0);
+                        request(child.x1, child.y0);
+                        request(child.x0, child.y1);
+                        request(child.x1, child.y1);
+                        request((child.x0 + child.x1) / 2, (child.y0 + child.y1) / 2);
+                    }
+                }
+            }
+            begin = end;
+        }
+
+        // Rows own their lower edge; the last row also owns the top one
+        int own_y = cj == cells_y - 1 ? h : h - 1;
+        for (int y = 0; y <= own_y; ++y) {
+            for (int x = 0; x < width_; ++x) {
+                write_pixel(x, origin_y + y,
+                            shade_sample(samples[y * stride + x], pixel_direction(camera, x, origin_y + y)));
+            }
+        }
+    });
+
+    stats_.tiles = static_cast<std::size_t>(cells_x) * cells_y;
+}
+
+void RayTracer::render_environment(const BlackHole& black_hole, const FrameCamera& camera) {
+    if (!environment_.matches(black_hole.get_parameters(), camera.offset, settings_.environment_face_size,
+                              settings_.environment_tolerance) ||
+        !same_geodesic_settings(environment_geodesic_, settings_.geodesic)) {
+        trace_environment(black_hole, camera);
+    }
+
+    const int tile = std::max(1, settings_.tile_size);
+    const int tiles_x = (width_ + tile - 1) / tile;
+    const int tiles_y = (height_ + tile - 1) / tile;
+    const std::size_t tile_count = static_cast<std::size_t>(tiles_x) * tiles_y;
+
+    pool_.parallel_for(tile_count, [&](std::size_t index, unsigned) {
+        int x0 = static_cast<int>(index % tiles_x) * tile;
+        int y0 = static_cast<int>(index / tiles_x) * tile;
+        int x1 = std::min(x0 + tile, width_);
+        int y1 = std::min(y0 + tile, height_);
+
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                write_pixel(x, y, shade(environment_.lookup(pixel_direction(camera, x, y))));
+            }
+        }
+    });
+
+    stats_.tiles = tile_count;
+}
+
+void RayTracer::trace_environment(const BlackHole& black_hole, const FrameCamera& camera) {
+    environment_.reset(black_hole.get_parameters(), camera.offset, settings_.environment_face_size);
+    environment_geodesic_ = settings_.geodesic;
+    const std::size_t row = environment_.get_face_size();
+    const std::size_t rows = environment_.get_texel_count() / row;
+
+    // One texel row per task, traced as a single batch
+    pool_.parallel_for(rows, [&](std::size_t r, unsigned worker) {
+        std::vector<GeodesicRay>& rays = worker_rays_[worker];
+        std::vector<GeodesicResult>& results = worker_results_[worker];
+        rays.clear();
+
+        const std::size_t first = r * row;
+        for (std::size_t i = 0; i < row; ++i) {
+            rays.push_back(GeodesicRay{camera.origin, environment_.texel_direction(first + i)});
+        }
+
+        results.resize(rays.size());
+        black_hole.trace_geodesics(rays.data(), results.data(), rays.size(), settings_.geodesic);
+        worker_rays_traced_[worker] += rays.size();
+
+        for (std::size_t i = 0; i < row; ++i) {
+            environment_.store(first + i, results[i]);
+            worker_steps_[worker] += results[i].steps + results[i].rejected_steps;
+        }
+    });
+}
+
+RayTracer::PixelSample RayTracer::make_sample(const GeodesicResult& result,
+                                              const Eigen::Vector3d& direction) const {
+    PixelSample sample;
+    sample.deflection = result.termination == GeodesicTermination::Horizon
+                            ? Eigen::Vector3f::Zero()
+                            : Eigen::Vector3f((result.direction - direction.normalized()).cast<float>());
+    sample.disk_radius = static_cast<float>(result.disk_radius);
+    sample.redshift = result.termination == GeodesicTermination::Disk
+                          ? static_cast<float>(disk_emission_.redshift(result.disk_radius, result.angular_momentum))
+                          : 0.0f;
+    sample.termination = result.termination;
+    sample.disk_crossings = result.disk_crossings;
+    sample.traced = true;
+    return sample;
+}
+
+bool RayTracer::cell_agrees(const PixelSample* corners[4], const PixelSample& center,
+                            const PixelSample& predicted) const {
+    for (int i = 0; i < 4; ++i) {
+        if (corners[i]->termination != center.termination ||
+            corners[i]->disk_crossings != center.disk_crossings) {
+            return false;
+        }
+    }
+    switch (center.termination) {
+        case GeodesicTermination::Escaped:
+            return (center.deflection - predicted.deflection).norm() <= settings_.refine_threshold;
+        case GeodesicTermination::Disk:
+            // Only the hit radius and redshift are shaded
+            return std::abs(center.disk_radius - predicted.disk_radius) <=
+                       settings_.refine_threshold * center.disk_radius &&
+                   std::abs(center.redshift - predicted.redshift) <= settings_.refine_threshold * center.redshift;
+        default:
+            return true;
+    }
+}
+
+Eigen::Vector3f RayTracer::shade_sample(const PixelSample& sample, const Eigen::Vector3d& direction) const {
+    switch (sample.termination) {
+        case GeodesicTermination::Escaped:
+            return sky_color((direction.normalized() + sample.deflection.cast<double>()).normalized());
+        case GeodesicTermination::Disk:
+            return disk_color(sample.disk_radius, sample.redshift);
+        default:
+            return Eigen::Vector3f::Zero();
+    }
+}
+
+Eigen::Vector3f RayTracer::shade(const GeodesicResult& result) const {
+    switch (result.termination) {
+        case GeodesicTermination::Escaped:
+            return sky_color(result.direction);
+        case GeodesicTermination::Disk:
+            return disk_color(result.disk_radius,
+                              disk_emission_.redshift(result.disk_radius, result.angular_momentum));
+        default:
+            return Eigen::Vector3f::Zero();
+    }
+}
+
+Eigen::Vector3f RayTracer::sky_color(const Eigen::Vector3d& direction) const {
+    // Faint galactic band around the y = 0 plane
+    float band = static_cast<float>(std::exp(-direction.y() * direction.y() * 40.0));
+    Eigen::Vector3f color = Eigen::Vector3f(0.02f, 0.02f, 0.035f) * band;
+
+    // Stars on a latitude/longitude grid
+    double u = (std::atan2(direction.z(), direction.x()) + M_PI) / (2.0 * M_PI);
+    double v = std::acos(std::clamp(direction.y(), -1.0, 1.0)) / M_PI;
+    std::uint32_t h = hash_cell(static_cast<std::uint32_t>(u * 2048.0),
+                                static_cast<std::uint32_t>(v * 1024.0));
+    if ((h & 0xffffu) < 160u) {
+        float brightness = 0.3f + 0.7f * static_cast<float>(h >> 24) / 255.0f;
+        color += Eigen::Vector3f(brightness, brightness, brightness * 1.1f);
+    }
+    return color;
+}
+
+Eigen::Vector3f RayTracer::disk_color(double radius, double redshift) const {
+    return disk_emission_.emission(radius, redshift);
+}
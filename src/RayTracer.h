@@ -0,0 +1,155 @@
+#ifndef RAYTRACER_H
+#define RAYTRACER_H
+
+#include "BlackHole.h"
+#include "DiskEmission.h"
+#include "LensedEnvironment.h"
+#include "ThreadPool.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <vector>
+
+struct RayTracerSettings {
+    int tile_size;           // Tile edge in pixels
+    float field_of_view;     // Vertical, degrees
+    bool adaptive;           // Trace a coarse grid and refine only where rays disagree
+    int adaptive_cell;       // Coarse grid spacing in pixels
+    double refine_threshold; // Largest accepted interpolation error, see RayTracer
+    bool environment_cache;  // Shade from a lensed cubemap traced once per camera position
+    int environment_face_size;     // Cubemap face edge in texels
+    double environment_tolerance;  // Camera movement in gravitational radii before a retrace
+    GeodesicSettings geodesic;
+
+    RayTracerSettings() :
+        tile_size(16),
+        field_of_view(45.0f),
+        adaptive(false),
+        adaptive_cell(8),
+        refine_threshold(2e-3),
+        environment_cache(false),
+        environment_face_size(512),
+        environment_tolerance(1e-3),
+        geodesic() {}
+};
+
+struct RayTracerStats {
+    double frame_seconds;
+    std::size_t pixels;
+    std::size_t rays;        // Geodesics traced; below pixels in adaptive mode
+    std::size_t integration_steps;
+    std::size_t tiles;
+    std::size_t steals;      // Tiles executed by a worker other than the one they were dealt to
+    unsigned threads;
+
+    RayTracerStats() :
+        frame_seconds(0.0), pixels(0), rays(0), integration_steps(0), tiles(0), steals(0), threads(0) {}
+};
+
+// CPU frame renderer that traces one Kerr geodesic per pixel.
+//
+// The image is split into square tiles which are scheduled on a work-stealing
+// thread pool: tiles around the photon ring need far more integration steps than
+// sky tiles, so static partitioning would leave cores idle. Camera coordinates are
+// in scene units, where one unit is one gravitational radius (GM/c^2) around the
+// black hole. The output is a linear float RGB framebuffer with row 0 at the bottom.
+//
+// In adaptive mode rays are first traced on a coarse grid. A grid cell is split
+// in four while its corner and center rays disagree on termination or disk
+// crossings, or the center ray misses the bilinear prediction from the corners
+// by more than refine_threshold: the deflection (final minus initial direction)
+// in radians for escaped rays, the relative hit radius for disk rays. Accepted
+// cells interpolate and shade every pixel from the interpolated values, so the
+// star field stays sharp while only the band around the shadow edge and photon
+// ring is traced per pixel.
+//
+// Disk hits are shaded from DiskEmission tables (Novikov-Thorne temperature and
+// blackbody color), rebuilt whenever the black hole parameters change, with the
+// redshift of a Keplerian emitter seen by a distant observer.
+//
+// With environment_cache set, the fate of every viewing direction is traced
+// into a LensedEnvironment cubemap and frames are shaded by lookup alone. The
+// cubemap is kept while the camera stays within environment_tolerance of the
+// position it was traced from, so turning the camera costs no geodesics. It is
+// retraced when the face size or the geodesic settings change.
+class RayTracer {
+public:
+    // thread_count = 0 uses all hardware threads
+    RayTracer(int width, int height, unsigned thread_count = 0);
+
+    void render(const BlackHole& black_hole,
+                const Eigen::Vector3d& camera_pos,
+                const Eigen::Vector3d& camera_target,
+                const Eigen::Vector3d& camera_up);
+
+    const std::vector<float>& get_framebuffer() const { return framebuffer_; }
+    const RayTracerStats& get_stats() const { return stats_; }
+
+    int get_width() const { return width_; }
+    int get_height() const { return height_; }
+
+    RayTracerSettings& get_settings() { return settings_; }
+    void set_settings(const RayTracerSettings& settings) { settings_ = settings; }
+
+    const DiskEmission& get_disk_emission() const { return disk_emission_; }
+    const LensedEnvironment& get_environment() const { return environment_; }
+    void invalidate_environment() { environment_.invalidate(); }
+
+private:
+    struct FrameCamera {
+        Eigen::Vector3d origin;
+        Eigen::Vector3d offset;    // From the hole, gravitational radii
+        Eigen::Vector3d front, right, up;
+        double scale_x, scale_y;   // Image plane half extent at unit distance
+    };
+
+    // Ray result kept for interpolation in adaptive mode
+    struct PixelSample {
+        Eigen::Vector3f deflection;   // Final minus initial direction
+        float disk_radius;
+        float redshift;               // Observed over emitted energy of disk hits
+        GeodesicTermination termination;
+        int disk_crossings;
+        bool traced;
+    };
+
+    // Cell corners in pixels; x is absolute, y relative to the coarse row
+    struct RefineCell {
+        int x0, y0, x1, y1;
+    };
+
+    int width_, height_;
+    RayTracerSettings settings_;
+    ThreadPool pool_;
+    std::vector<float> framebuffer_;
+    RayTracerStats stats_;
+    DiskEmission disk_emission_;
+    LensedEnvironment environment_;
+    GeodesicSettings environment_geodesic_;   // Settings environment_ was traced with
+
+    // Per-worker scratch space, reused across frames
+    std::vector<std::vector<GeodesicRay>> worker_rays_;
+    std::vector<std::vector<GeodesicResult>> worker_results_;
+    std::vector<std::size_t> worker_steps_;
+    std::vector<std::size_t> worker_rays_traced_;
+    std::vector<std::vector<PixelSample>> worker_samples_;
+    std::vector<std::vector<RefineCell>> worker_cells_;
+    std::vector<std::vector<std::size_t>> worker_pending_;
+    std::vector<PixelSample> coarse_samples_;
+
+    Eigen::Vector3d pixel_direction(const FrameCamera& camera, int x, int y) const;
+    void render_tiles(const BlackHole& black_hole, const FrameCamera& camera);
+    void render_adaptive(const BlackHole& black_hole, const FrameCamera& camera);
+    void render_environment(const BlackHole& black_hole, const FrameCamera& camera);
+    void trace_environment(const BlackHole& black_hole, const FrameCamera& camera);
+    PixelSample make_sample(const GeodesicResult& result, const Eigen::Vector3d& direction) const;
+    bool cell_agrees(const PixelSample* corners[4], const PixelSample& center,
+                     const PixelSample& predicted) const;
+    Eigen::Vector3f shade_sample(const PixelSample& sample, const Eigen::Vector3d& direction) const;
+    void write_pixel(int x, int y, const Eigen::Vector3f& color);
+
+    Eigen::Vector3f shade(const GeodesicResult& result) const;
+    Eigen::Vector3f sky_color(const Eigen::Vector3d& direction) const;
+    Eigen::Vector3f disk_color(double radius, double redshift) const;
+};
+
+#endif
@@ -74,13 +74,49 @@ void main() {
 }
 )";
 
+// Полноэкранный квад для кадра CPU трассировщика
+const char* frame_vertex_shader = R"(
+#version 330 core
+layout (location = 0) in vec2 aPos;
+
+out vec2 TexCoord;
+
+void main() {
+    TexCoord = aPos * 0.5 + 0.5;
+    gl_Position = vec4(aPos, 0.0, 1.0);
+}
+)";
+
+const char* frame_fragment_shader = R"(
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D frame;
+
+void main() {
+    vec3 color = texture(frame, TexCoord).rgb;
+    color = color / (1.0 + color);          // Тональная компрессия
+    color = pow(color, vec3(1.0 / 2.2));    // Гамма-коррекция
+    FragColor = vec4(color, 1.0);
+}
+)";
+
 Renderer::Renderer(int width, int height) 
     : window_(nullptr), width_(width), height_(height),
       black_hole_shader_(0), accretion_shader_(0), star_shader_(0), body_shader_(0),
       black_hole_vao_(0), black_hole_vbo_(0),
       accretion_vao_(0), accretion_vbo_(0),
       star_vao_(0), star_vbo_(0),
-      body_vao_(0), body_vbo_(0) {}
+      body_vao_(0), body_vbo_(0),
+      disk_temperature_texture_(0), disk_color_texture_(0), accretion_vertex_count_(0),
+      disk_clock_(0.0),
+      ray_tracing_enabled_(false),
+      frame_shader_(0), frame_vao_(0), frame_vbo_(0), frame_texture_(0),
+      camera_pos_(0.0f, 5.0f, 30.0f),
+      camera_target_(0.0f, 0.0f, 0.0f),
+      camera_up_(0.0f, 1.0f, 0.0f) {}
 
 Renderer::~Renderer() {
     shutdown();
@@ -128,6 +164,7 @@ bool Renderer::initialize() {
     setup_accretion_disk_rendering();
     setup_black_hole_rendering();
     setup_body_rendering();
+    setup_ray_traced_frame();
     
     std::cout << "Renderer initialized successfully" << std::endl;
     return true;
@@ -168,61 +205,62 @@ void Renderer::setup_star_field_rendering() {
 }
 
 void Renderer::setup_accretion_disk_rendering() {
-    // Создание геометрии аккреционного диска
-    std::vector<float> vertices;
-    int segments = 200;
-    float inner_radius = 2.5f;
-    float outer_radius = 25.0f;
-    
-    for (int i = 0; i <= segments; ++i) {
-        float angle1 = 2.0f * M_PI * i / segments;
-        float angle2 = 2.0f * M_PI * (i + 1) / segments;
-        
-        // Внутренняя точка 1
-        float x_in1 = inner_radius * cos(angle1);
-        float z_in1 = inner_radius * sin(angle1);
-        
-        // Внешняя точка 1
-        float x_out1 = outer_radius * cos(angle1);
-        float z_out1 = outer_radius * sin(angle1);
-        
-        // Внутренняя точка 2
-        float x_in2 = inner_radius * cos(angle2);
-        float z_in2 = inner_radius * sin(angle2);
-        
-        // Внешняя точка 2
-        float x_out2 = outer_radius * cos(angle2);
-        float z_out2 = outer_radius * sin(angle2);
-        
-        // Первый треугольник
-        vertices.insert(vertices.end(), {x_in1, 0.0f, z_in1});
-        vertices.insert(vertices.end(), {x_out1, 0.0f, z_out1});
-        vertices.insert(vertices.end(), {x_in2, 0.0f, z_in2});
-        
-        // Второй треугольник
-        vertices.insert(vertices.end(), {x_in2, 0.0f, z_in2});
-        vertices.insert(vertices.end(), {x_out1, 0.0f, z_out1});
-        vertices.insert(vertices.end(), {x_out2, 0.0f, z_out2});
-    }
-    
-    // Создание буферов
+    // Геометрия и таблицы создаются в update_accretion_disk по параметрам черной дыры
     glGenVertexArrays(1, &accretion_vao_);
     glGenBuffers(1, &accretion_vbo_);
     
     glBindVertexArray(accretion_vao_);
     glBindBuffer(GL_ARRAY_BUFFER, accretion_vbo_);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), 
-                 vertices.data(), GL_STATIC_DRAW);
-    
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
     
+    GLuint textures[2];
+    glGenTextures(2, textures);
+    disk_temperature_texture_ = textures[0];
+    disk_color_texture_ = textures[1];
+    for (GLuint texture : textures) {
+        glBindTexture(GL_TEXTURE_1D, texture);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_1D, 0);
+    
     // Загрузка шейдера аккреционного диска
     accretion_shader_ = ShaderManager::load_shader("accretion");
     
     glBindVertexArray(0);
 }
 
+void Renderer::update_accretion_disk(const BlackHole& black_hole) {
+    if (disk_emission_.matches(black_hole.get_parameters())) {
+        return;
+    }
+    disk_emission_.build(black_hole.get_parameters());
+    
+    // Частицы излучающего диска в гравитационных радиусах, как у трассировщика;
+    // буфер только выделяется, позиции пишет render_accretion_disk
+    disk_particles_.build(disk_emission_.get_inner_radius(), disk_emission_.get_outer_radius(),
+                          disk_emission_.get_spin());
+    accretion_vertex_count_ = static_cast<GLsizei>(disk_particles_.size());
+    disk_clock_ = glfwGetTime();
+    
+    glBindBuffer(GL_ARRAY_BUFFER, accretion_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, disk_particles_.size() * 3 * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    // Профиль температуры и цвет черного тела
+    const std::vector<float>& temperature = disk_emission_.get_temperature_table();
+    const std::vector<float>& color = disk_emission_.get_color_table();
+    glBindTexture(GL_TEXTURE_1D, disk_temperature_texture_);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_R32F, static_cast<GLsizei>(temperature.size()), 0,
+                 GL_RED, GL_FLOAT, temperature.data());
+    glBindTexture(GL_TEXTURE_1D, disk_color_texture_);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, static_cast<GLsizei>(color.size() / 3), 0,
+                 GL_RGB, GL_FLOAT, color.data());
+    glBindTexture(GL_TEXTURE_1D, 0);
+}
+
 void Renderer::setup_black_hole_rendering() {
     // Создание сферы для черной дыры
     std::vector<float> vertices;
@@ -282,17 +320,56 @@ void Renderer::setup_body_rendering() {
     glBindVertexArray(0);
 }
 
+void Renderer::setup_ray_traced_frame() {
+    ray_tracer_ = std::make_unique<RayTracer>(width_, height_);
+    // Интерактивный режим: грубая сетка лучей с уточнением у края тени
+    ray_tracer_->get_settings().adaptive = true;
+    
+    // Два треугольника на весь экран
+    std::vector<float> vertices = {
+        -1.0f, -1.0f,  1.0f, -1.0f,  1.0f,  1.0f,
+        -1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f
+    };
+    
+    glGenVertexArrays(1, &frame_vao_);
+    glGenBuffers(1, &frame_vbo_);
+    
+    glBindVertexArray(frame_vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, frame_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), 
+                 vertices.data(), GL_STATIC_DRAW);
+    
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    
+    // Текстура с плавающей точкой для HDR кадра
+    glGenTextures(1, &frame_texture_);
+    glBindTexture(GL_TEXTURE_2D, frame_texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width_, height_, 0, GL_RGB, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    frame_shader_ = compile_shader(frame_vertex_shader, frame_fragment_shader);
+    
+    glBindVertexArray(0);
+}
+
 void Renderer::render(const std::shared_ptr<BlackHole>& black_hole, 
-                     const PhysicsEngine& physics_engine) {
+                     PhysicsThread& physics) {
     // Очистка буферов
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
-    if (black_hole) {
+    if (black_hole && ray_tracing_enabled_ && ray_tracer_) {
+        render_ray_traced_frame(*black_hole);
+    } else if (black_hole) {
         // Рендеринг в правильном порядке
         render_star_field();
         render_accretion_disk(*black_hole);
-        render_celestial_bodies(physics_engine);
+        render_celestial_bodies(physics);
         render_black_hole(*black_hole);
     }
     
@@ -325,6 +402,8 @@ void Renderer::render_star_field() {
 }
 
 void Renderer::render_accretion_disk(const BlackHole& black_hole) {
+    update_accretion_disk(black_hole);
+    
     glUseProgram(accretion_shader_);
     glEnable(GL_BLEND);
     
@@ -342,28 +421,54 @@ void Renderer::render_accretion_disk(const BlackHole& black_hole) {
     glUniformMatrix4fv(view_loc, 1, GL_FALSE, view.data());
     glUniformMatrix4fv(projection_loc, 1, GL_FALSE, projection.data());
     
-    // Параметры черной дыры
-    GLuint black_hole_pos_loc = glGetUniformLocation(accretion_shader_, "blackHolePos");
-    GLuint inner_radius_loc = glGetUniformLocation(accretion_shader_, "innerRadius");
-    GLuint outer_radius_loc = glGetUniformLocation(accretion_shader_, "outerRadius");
-    GLuint time_loc = glGetUniformLocation(accretion_shader_, "time");
+    // Параметры черной дыры и таблицы излучения
+    const DiskEmissionSettings& emission = disk_emission_.get_settings();
+    glUniform3f(glGetUniformLocation(accretion_shader_, "blackHolePos"), 0.0f, 0.0f, 0.0f);
+    glUniform3f(glGetUniformLocation(accretion_shader_, "cameraPos"),
+                camera_pos_.x(), camera_pos_.y(), camera_pos_.z());
+    glUniform1f(glGetUniformLocation(accretion_shader_, "innerRadius"),
+                static_cast<float>(disk_emission_.get_inner_radius()));
+    glUniform1f(glGetUniformLocation(accretion_shader_, "outerRadius"),
+                static_cast<float>(disk_emission_.get_outer_radius()));
+    glUniform1f(glGetUniformLocation(accretion_shader_, "spin"),
+                static_cast<float>(disk_emission_.get_spin()));
+    glUniform1f(glGetUniformLocation(accretion_shader_, "logRatioMin"),
+                static_cast<float>(std::log(emission.min_temperature_ratio)));
+    glUniform1f(glGetUniformLocation(accretion_shader_, "logRatioMax"),
+                static_cast<float>(std::log(emission.max_temperature_ratio)));
+    glUniform1f(glGetUniformLocation(accretion_shader_, "time"), static_cast<float>(glfwGetTime()));
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, disk_temperature_texture_);
+    glUniform1i(glGetUniformLocation(accretion_shader_, "temperatureTable"), 0);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_1D, disk_color_texture_);
+    glUniform1i(glGetUniformLocation(accretion_shader_, "colorTable"), 1);
+    
+    // Движение частиц по орбитам прямо в отображённый буфер
+    double now = glfwGetTime();
+    double orbit_time = (now - disk_clock_) * disk_particles_.get_settings().time_scale;
+    disk_clock_ = now;
     
-    Eigen::Vector3f bh_pos = black_hole.get_parameters().position.cast<float>();
-    float event_horizon = static_cast<float>(black_hole.get_event_horizon_radius());
-    float inner_radius = event_horizon * 2.5f;
-    float outer_radius = event_horizon * 25.0f;
-    float time = static_cast<float>(glfwGetTime());
-    
-    glUniform3f(black_hole_pos_loc, bh_pos.x(), bh_pos.y(), bh_pos.z());
-    glUniform1f(inner_radius_loc, inner_radius);
-    glUniform1f(outer_radius_loc, outer_radius);
-    glUniform1f(time_loc, time);
+    glBindBuffer(GL_ARRAY_BUFFER, accretion_vbo_);
+    GLsizeiptr buffer_size = static_cast<GLsizeiptr>(disk_particles_.size() * 3 * sizeof(float));
+    void* positions = glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size,
+                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (positions) {
+        disk_particles_.advance(orbit_time, static_cast<float*>(positions));
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     
     // Рендеринг аккреционного диска
     glBindVertexArray(accretion_vao_);
-    glDrawArrays(GL_TRIANGLES, 0, 1200);
+    glDrawArrays(GL_POINTS, 0, accretion_vertex_count_);
     glBindVertexArray(0);
     
+    glBindTexture(GL_TEXTURE_1D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    
     glDisable(GL_BLEND);
 }
 
@@ -403,7 +508,7 @@ void Renderer::render_black_hole(const BlackHole& black_hole) {
     glBindVertexArray(0);
 }
 
-void Renderer::render_celestial_bodies(const PhysicsEngine& physics_engine) {
+void Renderer::render_celestial_bodies(PhysicsThread& physics) {
     glUseProgram(body_shader_);
     glEnable(GL_BLEND);
     
@@ -424,11 +529,15 @@ void Renderer::render_celestial_bodies(const PhysicsEngine& physics_engine) {
     // Рендеринг каждого небесного тела
     glBindVertexArray(body_vao_);
     
-    int body_index = 0;
-    for (const auto& body : physics_engine.get_bodies()) {
+    // Последний кадр физики, на шаг позади: смешивание двух соседних состояний
+    const BodyFrame& frame = physics.acquire_frame();
+    const float blend = frame.blend(physics.get_display_time(frame));
+    for (std::size_t body_index = 0; body_index < frame.size(); ++body_index) {
         // Модельная матрица для позиционирования тела
+        Eigen::Map<const Eigen::Vector3f> previous(&frame.previous[3 * body_index]);
+        Eigen::Map<const Eigen::Vector3f> current(&frame.current[3 * body_index]);
         Eigen::Matrix4f model = Eigen::Matrix4f::Identity();
-        model.block<3,1>(0,3) = body.position.cast<float>();
+        model.block<3,1>(0,3) = previous + blend * (current - previous);
         
         GLuint model_loc = glGetUniformLocation(body_shader_, "model");
         glUniformMatrix4fv(model_loc, 1, GL_FALSE, model.data());
@@ -445,14 +554,34 @@ void Renderer::render_celestial_bodies(const PhysicsEngine& physics_engine) {
         
         // Рендеринг тела
         glDrawArrays(GL_POINTS, 0, 1);
-        
-        body_index++;
     }
     
     glBindVertexArray(0);
     glDisable(GL_BLEND);
 }
 
+void Renderer::render_ray_traced_frame(const BlackHole& black_hole) {
+    ray_tracer_->render(black_hole, camera_pos_.cast<double>(), 
+                        camera_target_.cast<double>(), camera_up_.cast<double>());
+    
+    // Загрузка кадра в текстуру
+    glBindTexture(GL_TEXTURE_2D, frame_texture_);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, GL_RGB, GL_FLOAT, 
+                    ray_tracer_->get_framebuffer().data());
+    
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(frame_shader_);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(glGetUniformLocation(frame_shader_, "frame"), 0);
+    
+    glBindVertexArray(frame_vao_);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
+
 Eigen::Matrix4f Renderer::create_projection_matrix() const {
     float fov = 45.0f;
     float aspect = static_cast<float>(width_) / height_;
@@ -463,11 +592,7 @@ Eigen::Matrix4f Renderer::create_projection_matrix() const {
 }
 
 Eigen::Matrix4f Renderer::create_view_matrix() const {
-    Eigen::Vector3f camera_pos(0.0f, 5.0f, 30.0f);
-    Eigen::Vector3f camera_target(0.0f, 0.0f, 0.0f);
-    Eigen::Vector3f camera_up(0.0f, 1.0f, 0.0f);
-    
-    return create_lookAt_matrix(camera_pos, camera_target, camera_up);
+    return create_lookAt_matrix(camera_pos_, camera_target_, camera_up_);
 }
 
 Eigen::Matrix4f Renderer::create_lookAt_matrix(const Eigen::Vector3f& position, 
@@ -570,8 +695,14 @@ void Renderer::shutdown() {
     if (body_vbo_) glDeleteBuffers(1, &body_vbo_);
     if (accretion_vao_) glDeleteVertexArrays(1, &accretion_vao_);
     if (accretion_vbo_) glDeleteBuffers(1, &accretion_vbo_);
+    if (disk_temperature_texture_) glDeleteTextures(1, &disk_temperature_texture_);
+    if (disk_color_texture_) glDeleteTextures(1, &disk_color_texture_);
     if (black_hole_vao_) glDeleteVertexArrays(1, &black_hole_vao_);
     if (black_hole_vbo_) glDeleteBuffers(1, &black_hole_vbo_);
+    if (frame_shader_) glDeleteProgram(frame_shader_);
+    if (frame_vao_) glDeleteVertexArrays(1, &frame_vao_);
+    if (frame_vbo_) glDeleteBuffers(1, &frame_vbo_);
+    if (frame_texture_) glDeleteTextures(1, &frame_texture_);
     
     // Очистка менеджера шейдеров
     ShaderManager::cleanup();
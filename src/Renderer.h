@@ -2,7 +2,10 @@
 #define RENDERER_H
 
 #include "BlackHole.h"
-#include "PhysicsEngine.h"
+#include "DiskEmission.h"
+#include "DiskParticles.h"
+#include "PhysicsThread.h"
+#include "RayTracer.h"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <Eigen/Dense>
@@ -15,12 +18,18 @@ public:
     ~Renderer();
     
     bool initialize();
+    // Bodies come from the physics thread's newest frame, read without locks
     void render(const std::shared_ptr<BlackHole>& black_hole, 
-                const PhysicsEngine& physics_engine);
+                PhysicsThread& physics);
     void shutdown();
     
     GLFWwindow* get_window() const { return window_; }
     
+    // Switch between the GL rasterized scene and the CPU geodesic ray tracer
+    void set_ray_tracing_enabled(bool enabled) { ray_tracing_enabled_ = enabled; }
+    bool is_ray_tracing_enabled() const { return ray_tracing_enabled_; }
+    const RayTracer* get_ray_tracer() const { return ray_tracer_.get(); }
+    
 private:
     GLFWwindow* window_;
     int width_, height_;
@@ -37,16 +46,40 @@ private:
     GLuint star_vao_, star_vbo_;
     GLuint body_vao_, body_vbo_;
     
+    // Таблицы излучения диска для текущих параметров черной дыры
+    DiskEmission disk_emission_;
+    GLuint disk_temperature_texture_, disk_color_texture_;
+    GLsizei accretion_vertex_count_;
+    
+    // Частицы диска на круговых орбитах, потоком в accretion_vbo_ каждый кадр
+    DiskParticles disk_particles_;
+    double disk_clock_;
+    
+    // CPU ray-traced frame path
+    std::unique_ptr<RayTracer> ray_tracer_;
+    bool ray_tracing_enabled_;
+    GLuint frame_shader_;
+    GLuint frame_vao_, frame_vbo_;
+    GLuint frame_texture_;
+    
+    // Fixed scene camera shared by the GL and ray-traced paths
+    Eigen::Vector3f camera_pos_;
+    Eigen::Vector3f camera_target_;
+    Eigen::Vector3f camera_up_;
+    
     void setup_black_hole_rendering();
     void setup_accretion_disk_rendering();
     void setup_star_field_rendering();
     void setup_body_rendering();
+    void setup_ray_traced_frame();
+    void update_accretion_disk(const BlackHole& black_hole);
     
     // Методы рендеринга без параметров матриц
     void render_black_hole(const BlackHole& black_hole);
     void render_accretion_disk(const BlackHole& black_hole);
     void render_star_field();
-    void render_celestial_bodies(const PhysicsEngine& physics_engine);
+    void render_celestial_bodies(PhysicsThread& physics);
+    void render_ray_traced_frame(const BlackHole& black_hole);
     
     GLuint compile_shader(const std::string& vertex_source, 
                          const std::string& fragment_source);
@@ -0,0 +1,112 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+// Fixed-capacity circular buffer; pushing onto a full buffer overwrites the
+// oldest value.
+//
+// Storage is allocated once, so push never moves existing values. Readers index
+// from the oldest value or walk it with iterators, and get_segments gives the
+// contents as at most two contiguous runs for callers that want raw pointers,
+// such as plotting code uploading a vertex buffer. None of these copy.
+template <class T>
+class RingBuffer {
+public:
+    // The contents in order: first[0..first_size) then second[0..second_size)
+    struct Segments {
+        const T* first;
+        std::size_t first_size;
+        const T* second;
+        std::size_t second_size;
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        const_iterator() : buffer_(nullptr), index_(0) {}
+        const_iterator(const RingBuffer* buffer, std::size_t index) : buffer_(buffer), index_(index) {}
+
+        reference operator*() const { return (*buffer_)[index_]; }
+        pointer operator->() const { return &(*buffer_)[index_]; }
+        reference operator[](difference_type n) const { return (*buffer_)[index_ + n]; }
+
+        const_iterator& operator++() { ++index_; return *this; }
+        const_iterator operator++(int) { const_iterator old = *this; ++index_; return old; }
+        const_iterator& operator--() { --index_; return *this; }
+        const_iterator operator--(int) { const_iterator old = *this; --index_; return old; }
+        const_iterator& operator+=(difference_type n) { index_ += n; return *this; }
+        const_iterator& operator-=(difference_type n) { index_ -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(buffer_, index_ + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(buffer_, index_ - n); }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+        }
+
+        bool operator==(const const_iterator& other) const { return index_ == other.index_; }
+        bool operator!=(const const_iterator& other) const { return index_ != other.index_; }
+        bool operator<(const const_iterator& other) const { return index_ < other.index_; }
+        bool operator>(const const_iterator& other) const { return index_ > other.index_; }
+        bool operator<=(const const_iterator& other) const { return index_ <= other.index_; }
+        bool operator>=(const const_iterator& other) const { return index_ >= other.index_; }
+
+    private:
+        const RingBuffer* buffer_;
+        std::size_t index_;  // From the oldest value
+    };
+
+    explicit RingBuffer(std::size_t capacity = 0) : values_(capacity), head_(0), size_(0) {}
+
+    void push_back(const T& value) {
+        if (values_.empty()) return;
+        std::size_t slot = head_ + size_;
+        if (slot >= values_.size()) slot -= values_.size();
+        values_[slot] = value;
+        if (size_ < values_.size()) {
+            ++size_;
+        } else if (++head_ == values_.size()) {
+            head_ = 0;
+        }
+    }
+
+    void clear() { head_ = 0; size_ = 0; }
+    // Drops the contents
+    void set_capacity(std::size_t capacity) { values_.assign(capacity, T()); clear(); }
+
+    std::size_t size() const { return size_; }
+    std::size_t capacity() const { return values_.size(); }
+    bool empty() const { return size_ == 0; }
+    bool full() const { return size_ == values_.size(); }
+
+    // 0 is the oldest value
+    const T& operator[](std::size_t index) const {
+        std::size_t slot = head_ + index;
+        if (slot >= values_.size()) slot -= values_.size();
+        return values_[slot];
+    }
+    const T& front() const { return (*this)[0]; }
+    const T& back() const { return (*this)[size_ - 1]; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size_); }
+
+    Segments get_segments() const {
+        const std::size_t first_size = std::min(size_, values_.size() - head_);
+        return Segments{values_.data() + head_, first_size, values_.data(), size_ - first_size};
+    }
+
+private:
+    std::vector<T> values_;
+    std::size_t head_;  // Slot of the oldest value
+    std::size_t size_;
+};
+
+#endif
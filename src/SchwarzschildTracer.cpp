@@ -0,0 +1,302 @@
+#include "SchwarzschildTracer.h"
+#include "BlackHole.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double G = 6.67430e-11;
+const double c = 299792458.0;
+const double solar_mass = 1.989e30;
+
+// Carlson's symmetric elliptic integral of the first kind R_F(x, y, z)
+double carlson_rf(double x, double y, double z) {
+    const double tolerance = 0.0025;
+    double delta_x, delta_y, delta_z, mean;
+    do {
+        double sqrt_x = std::sqrt(x);
+        double sqrt_y = std::sqrt(y);
+        double sqrt_z = std::sqrt(z);
+        double lambda = sqrt_x * (sqrt_y + sqrt_z) + sqrt_y * sqrt_z;
+        x = 0.25 * (x + lambda);
+        y = 0.25 * (y + lambda);
+        z = 0.25 * (z + lambda);
+        mean = (x + y + z) / 3.0;
+        delta_x = (mean - x) / mean;
+        delta_y = (mean - y) / mean;
+        delta_z = (mean - z) / mean;
+    } while (std::max({std::abs(delta_x), std::abs(delta_y), std::abs(delta_z)}) > tolerance);
+
+    double e2 = delta_x * delta_y - delta_z * delta_z;
+    double e3 = delta_x * delta_y * delta_z;
+    return (1.0 + (e2 / 24.0 - 0.1 - 3.0 * e3 / 44.0) * e2 + e3 / 14.0) / std::sqrt(mean);
+}
+
+// Jacobi sn and cn for parameter m = k^2 in [0, 1] by descending Landen transformation
+void jacobi_sn_cn(double w, double m, double& sn, double& cn) {
+    double mc = 1.0 - m;
+    if (mc <= 0.0) {
+        sn = std::tanh(w);
+        cn = 1.0 / std::cosh(w);
+        return;
+    }
+
+    double em[16], en[16];
+    double a = 1.0, dn = 1.0, cc = 1.0;
+    int levels = 0;
+    for (; levels < 16; ++levels) {
+        em[levels] = a;
+        mc = std::sqrt(mc);
+        en[levels] = mc;
+        cc = 0.5 * (a + mc);
+        if (std::abs(a - mc) <= 1e-8 * a) break;
+        mc *= a;
+        a = cc;
+    }
+    levels = std::min(levels, 15);
+
+    w *= cc;
+    sn = std::sin(w);
+    cn = std::cos(w);
+    if (sn != 0.0) {
+        a = cn / sn;
+        cc *= a;
+        for (int i = levels; i >= 0; --i) {
+            double b = em[i];
+            a *= cc;
+            cc *= dn;
+            dn = (en[i] + a) / (b + a);
+            a = cc / b;
+        }
+        a = 1.0 / std::sqrt(cc * cc + 1.0);
+        sn = sn >= 0.0 ? a : -a;
+        cn = cc * sn;
+    }
+}
+
+// (du/dphi)^2 for inverse impact parameter squared beta
+inline double orbit_potential(double u, double beta) {
+    return std::max(2.0 * u * u * u - u * u + beta, 0.0);
+}
+
+enum class OrbitKind {
+    Scatter,  // Turns at a periapsis outside the photon sphere and escapes
+    Plunge,   // No turning point, crosses the photon sphere
+    Inner     // Turns at an apoapsis inside the photon sphere and falls in
+};
+
+// One branch of the orbit equation. w is the argument of the Jacobi functions,
+// zero at the turning point (Scatter, Inner) or at u = root_c (Plunge); the
+// swept angle is scale * w.
+struct Orbit {
+    OrbitKind kind;
+    double root_a, root_b, root_c;  // u3 > u2 > u1, or the real root in root_c
+    double A;                       // Modulus of the complex roots relative to root_c
+    double m;                       // k^2
+    double scale;
+    double complete;                // K(m), Plunge only
+
+    double w(double u) const {
+        if (kind == OrbitKind::Plunge) {
+            double x = std::max(u - root_c, 0.0);
+            double cos_phi = (A - x) / (A + x);
+            double sin2 = 1.0 - cos_phi * cos_phi;
+            double f = std::sqrt(sin2) * carlson_rf(cos_phi * cos_phi, 1.0 - m * sin2, 1.0);
+            return cos_phi >= 0.0 ? f : 2.0 * complete - f;
+        }
+
+        double s;
+        if (kind == OrbitKind::Scatter) {
+            s = (root_a - root_c) * (root_b - u) / ((root_b - root_c) * (root_a - u));
+        } else {
+            s = (u - root_a) / (u - root_b);
+        }
+        s = std::clamp(s, 0.0, 1.0);
+        return std::sqrt(s) * carlson_rf(1.0 - s, 1.0 - m * s, 1.0);
+    }
+
+    double u(double w) const {
+        double sn, cn;
+        jacobi_sn_cn(std::abs(w), m, sn, cn);
+
+        if (kind == OrbitKind::Plunge) {
+            return root_c + A * (1.0 - cn) / std::max(1.0 + cn, 1e-300);
+        }
+
+        double s = sn * sn;
+        if (kind == OrbitKind::Scatter) {
+            return ((root_a - root_c) * root_b - s * (root_b - root_c) * root_a) /
+                   ((root_a - root_c) - s * (root_b - root_c));
+        }
+        return (root_a - s * root_b) / std::max(1.0 - s, 1e-300);
+    }
+
+    // Sign of dr/dphi at w; u moves away from the turning point as |w| grows
+    double radial_sign(double w) const {
+        double s = w > 0.0 ? 1.0 : (w < 0.0 ? -1.0 : 0.0);
+        return kind == OrbitKind::Scatter ? s : -s;
+    }
+};
+
+Orbit make_orbit(double beta, double u0) {
+    Orbit orbit;
+
+    if (beta < 1.0 / 27.0) {
+        // Three real roots of 2u^3 - u^2 + beta
+        double angle = std::acos(std::clamp(1.0 - 54.0 * beta, -1.0, 1.0)) / 3.0;
+        orbit.root_a = 1.0 / 6.0 + std::cos(angle) / 3.0;
+        orbit.root_b = 1.0 / 6.0 + std::cos(angle - 2.0 * M_PI / 3.0) / 3.0;
+        orbit.root_c = 1.0 / 6.0 + std::cos(angle - 4.0 * M_PI / 3.0) / 3.0;
+        orbit.kind = u0 < 0.5 * (orbit.root_a + orbit.root_b) ? OrbitKind::Scatter : OrbitKind::Inner;
+        orbit.A = 0.0;
+        orbit.m = (orbit.root_b - orbit.root_c) / (orbit.root_a - orbit.root_c);
+        orbit.scale = std::sqrt(2.0 / (orbit.root_a - orbit.root_c));
+        orbit.complete = 0.0;
+        return orbit;
+    }
+
+    // One real root (Cardano) and a complex pair mean +- i*nu
+    double q = 0.5 * beta - 1.0 / 108.0;
+    double d = std::sqrt(std::max(0.25 * q * q - 1.0 / 46656.0, 0.0));
+    double root = std::cbrt(-0.5 * q + d) + std::cbrt(-0.5 * q - d) + 1.0 / 6.0;
+    double mean = 0.5 * (0.5 - root);
+    double nu2 = std::max(-beta / (2.0 * root) - mean * mean, 0.0);
+
+    orbit.kind = OrbitKind::Plunge;
+    orbit.root_a = orbit.root_b = 0.0;
+    orbit.root_c = root;
+    orbit.A = std::sqrt((mean - root) * (mean - root) + nu2);
+    orbit.m = (orbit.A + mean - root) / (2.0 * orbit.A);
+    orbit.scale = 1.0 / std::sqrt(2.0 * orbit.A);
+    orbit.complete = carlson_rf(0.0, 1.0 - orbit.m, 1.0);
+    return orbit;
+}
+
+}
+
+SchwarzschildTracer::SchwarzschildTracer(const BlackHoleParameters& params,
+                                         const GeodesicSettings& settings)
+    : settings_(settings),
+      center_(params.position),
+      gravitational_radius_(G * params.mass * solar_mass / (c * c)),
+      // Disk radii are given in Schwarzschild radii (2M)
+      disk_inner_radius_(2.0 * params.accretion_disk_inner_radius),
+      disk_outer_radius_(2.0 * params.accretion_disk_outer_radius) {}
+
+GeodesicResult SchwarzschildTracer::trace(const GeodesicRay& ray) const {
+    GeodesicResult result;
+
+    Eigen::Vector3d p = (ray.origin - center_) / gravitational_radius_;
+    Eigen::Vector3d n = ray.direction.normalized();
+    double r0 = p.norm();
+
+    const double escape_radius = std::max(settings_.escape_radius, 1.01 * r0);
+    const double horizon_stop = 2.0 * (1.0 + settings_.horizon_epsilon);
+
+    // L about the world y axis, with E = 1 as in GeodesicIntegrator
+    result.angular_momentum = p.cross(n).y() / std::sqrt(std::max(1.0 - 2.0 / r0, 1e-12));
+
+    if (r0 <= horizon_stop) {
+        result.termination = GeodesicTermination::Horizon;
+        result.position = ray.origin;
+        result.direction = n;
+        return result;
+    }
+
+    // Orbital plane basis: e1 towards the observer, e2 along the transverse motion
+    Eigen::Vector3d e1 = p / r0;
+    double cos_alpha = n.dot(e1);
+    Eigen::Vector3d e2 = n - cos_alpha * e1;
+    double sin_alpha = e2.norm();
+
+    if (sin_alpha < 1e-12) {
+        bool escaped = cos_alpha > 0.0;
+        double r = escaped ? escape_radius : horizon_stop;
+        result.termination = escaped ? GeodesicTermination::Escaped : GeodesicTermination::Horizon;
+        result.position = center_ + e1 * r * gravitational_radius_;
+        result.direction = escaped ? e1 : Eigen::Vector3d(-e1);
+        return result;
+    }
+    e2 /= sin_alpha;
+
+    // Local static-frame angle to the conserved impact parameter, beta = 1/b^2
+    const double u0 = 1.0 / r0;
+    const double beta = u0 * u0 * (1.0 - 2.0 * u0) / (sin_alpha * sin_alpha);
+    const Orbit orbit = make_orbit(beta, u0);
+    const bool inward = cos_alpha < 0.0;
+
+    double w0, w_end, u_end;
+    bool escaped;
+    switch (orbit.kind) {
+    case OrbitKind::Scatter:
+        w0 = orbit.w(std::min(u0, orbit.root_b));
+        w0 = inward ? -w0 : w0;
+        u_end = 1.0 / escape_radius;
+        w_end = orbit.w(u_end);
+        escaped = true;
+        break;
+    case OrbitKind::Inner:
+        w0 = orbit.w(std::max(u0, orbit.root_a));
+        w0 = inward ? w0 : -w0;
+        u_end = 1.0 / horizon_stop;
+        w_end = orbit.w(u_end);
+        escaped = false;
+        break;
+    default:
+        w0 = inward ? orbit.w(u0) : -orbit.w(u0);
+        u_end = inward ? 1.0 / horizon_stop : 1.0 / escape_radius;
+        w_end = inward ? orbit.w(u_end) : -orbit.w(u_end);
+        escaped = !inward;
+        break;
+    }
+
+    const double phi_end = orbit.scale * (w_end - w0);
+
+    auto fill = [&](double phi, double u, double radial_sign) {
+        double r = 1.0 / u;
+        double dr = radial_sign * std::sqrt(orbit_potential(u, beta)) / (u * u);
+        Eigen::Vector3d e_r = std::cos(phi) * e1 + std::sin(phi) * e2;
+        Eigen::Vector3d e_phi = -std::sin(phi) * e1 + std::cos(phi) * e2;
+        result.position = center_ + e_r * r * gravitational_radius_;
+        result.direction = (dr * e_r + r * e_phi).normalized();
+        result.winding_number = phi / (2.0 * M_PI);
+    };
+
+    // The orbital plane meets the equatorial plane (world y = 0) every pi radians
+    double e1y = e1.y();
+    double e2y = e2.y();
+    if (std::abs(e1y) + std::abs(e2y) > 1e-12) {
+        double phi_node = std::fmod(std::atan2(e2y, e1y) + 0.5 * M_PI, M_PI);
+        if (phi_node <= 1e-12) phi_node += M_PI;
+
+        for (double phi = phi_node; phi < phi_end; phi += M_PI) {
+            ++result.disk_crossings;
+            double w = w0 + phi / orbit.scale;
+            double u = orbit.u(w);
+            double r = 1.0 / u;
+            if (r >= disk_inner_radius_ && r <= disk_outer_radius_) {
+                result.termination = GeodesicTermination::Disk;
+                result.disk_radius = r;
+                fill(phi, u, orbit.radial_sign(w));
+                return result;
+            }
+        }
+    }
+
+    result.termination = escaped ? GeodesicTermination::Escaped : GeodesicTermination::Horizon;
+    fill(phi_end, u_end, escaped ? 1.0 : -1.0);
+    return result;
+}
+
+void SchwarzschildTracer::trace(const GeodesicRay* rays, GeodesicResult* results,
+                                std::size_t count) const {
+    for (std::size_t i = 0; i < count; ++i) {
+        results[i] = trace(rays[i]);
+    }
+}
+
+void SchwarzschildTracer::trace(const std::vector<GeodesicRay>& rays,
+                                std::vector<GeodesicResult>& results) const {
+    results.resize(rays.size());
+    trace(rays.data(), results.data(), rays.size());
+}
@@ -0,0 +1,43 @@
+#ifndef SCHWARZSCHILDTRACER_H
+#define SCHWARZSCHILDTRACER_H
+
+#include "GeodesicIntegrator.h"
+#include <Eigen/Dense>
+#include <cstddef>
+#include <vector>
+
+struct BlackHoleParameters;
+
+// Closed-form null geodesics of a non-rotating black hole.
+//
+// A photon moves in a plane through the hole, where u = M/r obeys
+// (du/dphi)^2 = 2u^3 - u^2 + 1/b^2. Depending on the roots of the cubic the
+// orbit scatters off a periapsis, plunges from outside the photon sphere or
+// falls back from an apoapsis inside it. In every case phi(u) is an incomplete
+// elliptic integral of the first kind (Carlson R_F) and u(phi) follows from the
+// Jacobi elliptic functions, so a ray costs the same no matter how many times it
+// winds around the hole. Results follow the GeodesicIntegrator conventions; of
+// the settings only escape_radius and horizon_epsilon apply.
+class SchwarzschildTracer {
+public:
+    // BlackHole uses this tracer for spins below the threshold
+    static constexpr double kSpinThreshold = 1e-3;
+
+    explicit SchwarzschildTracer(const BlackHoleParameters& params,
+                                 const GeodesicSettings& settings = GeodesicSettings());
+
+    void trace(const GeodesicRay* rays, GeodesicResult* results, std::size_t count) const;
+    void trace(const std::vector<GeodesicRay>& rays, std::vector<GeodesicResult>& results) const;
+    GeodesicResult trace(const GeodesicRay& ray) const;
+
+    double get_gravitational_radius() const { return gravitational_radius_; }
+
+private:
+    GeodesicSettings settings_;
+    Eigen::Vector3d center_;
+    double gravitational_radius_;  // GM/c^2 in world units
+    double disk_inner_radius_;     // Gravitational radii
+    double disk_outer_radius_;
+};
+
+#endif
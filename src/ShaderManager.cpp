@@ -83,6 +83,7 @@ void main() {
     vec3 warpedPos = WorldPos + vec3(0.0, warp, 0.0);
     
     gl_Position = projection * view * vec4(warpedPos, 1.0);
+    gl_PointSize = 1.5;  // Диск рисуется частицами
 }
 )";
 
@@ -94,47 +95,49 @@ in vec3 WorldPos;
 in float DiskRadius;
 
 uniform vec3 blackHolePos;
-uniform float innerRadius;
+uniform vec3 cameraPos;
+uniform float innerRadius;      // Излучающий диск, в гравитационных радиусах
 uniform float outerRadius;
+uniform float spin;
+uniform sampler1D temperatureTable;
+uniform sampler1D colorTable;
+uniform float logRatioMin;
+uniform float logRatioMax;
 uniform float time;
 
+// Линейная интерполяция между отсчётами таблицы, как на CPU
+float table_coord(float u, int size) {
+    return (clamp(u, 0.0, 1.0) * float(size - 1) + 0.5) / float(size);
+}
+
 void main() {
-    float t = (DiskRadius - innerRadius) / (outerRadius - innerRadius);
-    t = clamp(t, 0.0, 1.0);
-    
-    float temperature = 1.0 - t;
-    vec3 viewDir = normalize(-WorldPos);
-    vec3 diskNormal = vec3(0.0, 1.0, 0.0);
-    float doppler = dot(diskNormal, viewDir);
-    
-    vec3 color;
-    if (temperature > 0.8) {
-        float hotness = (temperature - 0.8) * 5.0;
-        color = mix(vec3(0.5, 0.7, 1.0), vec3(1.0, 1.0, 1.2), hotness);
-    } else if (temperature > 0.5) {
-        float midness = (temperature - 0.5) * 3.33;
-        color = mix(vec3(1.0, 0.8, 0.2), vec3(1.0, 1.0, 0.5), midness);
-    } else if (temperature > 0.2) {
-        float coolness = (temperature - 0.2) * 3.33;
-        color = mix(vec3(1.0, 0.3, 0.0), vec3(1.0, 0.8, 0.2), coolness);
-    } else {
-        color = mix(vec3(0.3, 0.0, 0.0), vec3(1.0, 0.3, 0.0), temperature * 5.0);
-    }
-    
-    if (doppler > 0.0) {
-        color = mix(color, vec3(0.3, 0.5, 1.0), doppler * 0.6);
-    } else {
-        color = mix(color, vec3(1.0, 0.2, 0.1), -doppler * 0.6);
-    }
-    
-    float alpha;
-    if (DiskRadius < innerRadius * 1.1) {
-        alpha = smoothstep(innerRadius * 0.9, innerRadius * 1.1, DiskRadius);
-    } else {
-        alpha = 1.0 - smoothstep(outerRadius * 0.7, outerRadius, DiskRadius);
+    if (DiskRadius < innerRadius || DiskRadius > outerRadius) {
+        discard;
     }
     
-    alpha = clamp(alpha, 0.1, 1.0);
+    // Профиль Новикова-Торна: T / T_peak
+    float u = log(DiskRadius / innerRadius) / log(outerRadius / innerRadius);
+    float ratio = texture(temperatureTable, table_coord(u, textureSize(temperatureTable, 0))).r;
+    
+    // Кеплеровская орбита: доплеровский сдвиг в плоском приближении
+    // с замедлением времени круговой орбиты
+    float r32 = DiskRadius * sqrt(DiskRadius);
+    float omega = 1.0 / (r32 + spin);
+    float ut = (r32 + spin) / (pow(DiskRadius, 0.75) *
+               sqrt(max(r32 - 3.0 * sqrt(DiskRadius) + 2.0 * spin, 1e-6)));
+    vec3 offset = WorldPos - blackHolePos;
+    vec3 velocity = omega * cross(vec3(0.0, 1.0, 0.0), offset);
+    vec3 toCamera = normalize(cameraPos - WorldPos);
+    float redshift = 1.0 / (ut * max(1.0 - dot(velocity, toCamera), 1e-3));
+    
+    // Наблюдаемый спектр - чёрное тело при температуре g T
+    float v = (log(max(redshift * ratio, 1e-6)) - logRatioMin) / (logRatioMax - logRatioMin);
+    vec3 color = texture(colorTable, table_coord(v, textureSize(colorTable, 0))).rgb;
+    
+    color = color / (1.0 + color);          // Тональная компрессия
+    color = pow(color, vec3(1.0 / 2.2));    // Гамма-коррекция
+    
+    float alpha = 1.0 - smoothstep(outerRadius * 0.8, outerRadius, DiskRadius);
     FragColor = vec4(color, alpha);
 }
 )";
@@ -0,0 +1,99 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash()
+    : cell_size_(0.0), inv_cell_size_(0.0), count_(0), bucket_mask_(0), bucket_start_(2, 0) {}
+
+std::int64_t SpatialHash::cell_of(double coordinate) const {
+    return static_cast<std::int64_t>(std::floor(coordinate * inv_cell_size_));
+}
+
+std::size_t SpatialHash::bucket_of(std::int64_t cx, std::int64_t cy, std::int64_t cz) const {
+    // Large primes per axis, so neighbouring cells scatter over the table
+    std::uint64_t h = static_cast<std::uint64_t>(cx) * 73856093ull ^
+                      static_cast<std::uint64_t>(cy) * 19349663ull ^
+                      static_cast<std::uint64_t>(cz) * 83492791ull;
+    return static_cast<std::size_t>(h ^ (h >> 29)) & bucket_mask_;
+}
+
+void SpatialHash::build(const double* x, const double* y, const double* z, const double* radius,
+                        std::size_t count) {
+    count_ = count;
+    entries_.clear();
+    double max_radius = 0.0;
+    std::size_t inserted = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (radius[i] > 0.0) {
+            max_radius = std::max(max_radius, radius[i]);
+            ++inserted;
+        }
+    }
+    cell_size_ = 2.0 * max_radius;
+    inv_cell_size_ = cell_size_ > 0.0 ? 1.0 / cell_size_ : 0.0;
+
+    std::size_t buckets = 1;
+    while (buckets < 2 * inserted) {
+        buckets <<= 1;
+    }
+    bucket_mask_ = buckets - 1;
+    bucket_start_.assign(buckets + 1, 0);
+    if (inserted == 0) return;
+
+    // Counting sort by bucket keeps each bucket in increasing body order
+    body_buckets_.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (radius[i] > 0.0) {
+            body_buckets_[i] = static_cast<std::uint32_t>(bucket_of(cell_of(x[i]), cell_of(y[i]), cell_of(z[i])));
+            ++bucket_start_[body_buckets_[i] + 1];
+        }
+    }
+    for (std::size_t b = 0; b < buckets; ++b) {
+        bucket_start_[b + 1] += bucket_start_[b];
+    }
+
+    entries_.resize(inserted);
+    std::vector<std::uint32_t> fill(bucket_start_.begin(), bucket_start_.end() - 1);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (radius[i] > 0.0) {
+            entries_[fill[body_buckets_[i]]++] = static_cast<std::uint32_t>(i);
+        }
+    }
+}
+
+void SpatialHash::find_overlaps(const double* x, const double* y, const double* z, const double* radius,
+                                std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs) const {
+    if (entries_.empty()) return;
+
+    for (std::size_t i = 0; i < count_; ++i) {
+        if (!(radius[i] > 0.0)) continue;
+        const std::int64_t cx = cell_of(x[i]), cy = cell_of(y[i]), cz = cell_of(z[i]);
+
+        // Neighbouring cells can share a bucket; visit each bucket once
+        std::size_t buckets[27];
+        int bucket_count = 0;
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dz = -1; dz <= 1; ++dz) {
+                    std::size_t b = bucket_of(cx + dx, cy + dy, cz + dz);
+                    if (std::find(buckets, buckets + bucket_count, b) == buckets + bucket_count) {
+                        buckets[bucket_count++] = b;
+                    }
+                }
+            }
+        }
+
+        for (int k = 0; k < bucket_count; ++k) {
+            const std::size_t b = buckets[k];
+            for (std::uint32_t e = bucket_start_[b]; e < bucket_start_[b + 1]; ++e) {
+                const std::uint32_t j = entries_[e];
+                if (j <= i) continue;
+                double ex = x[j] - x[i], ey = y[j] - y[i], ez = z[j] - z[i];
+                double reach = radius[i] + radius[j];
+                if (ex * ex + ey * ey + ez * ez < reach * reach) {
+                    pairs.emplace_back(static_cast<std::uint32_t>(i), j);
+                }
+            }
+        }
+    }
+}
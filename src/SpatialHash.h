@@ -0,0 +1,45 @@
+#ifndef SPATIALHASH_H
+#define SPATIALHASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Uniform grid broad phase for sphere overlaps, rebuilt from scratch every step.
+//
+// Cells are twice the largest radius, so two overlapping spheres always sit in
+// the same or neighbouring cells. Cell coordinates are hashed into a
+// power-of-two bucket table about twice the body count, and the bodies are
+// counting-sorted by bucket, so a build and a query are both O(N) with no
+// per-cell allocation. Bodies with zero radius are point masses and are left
+// out.
+class SpatialHash {
+public:
+    SpatialHash();
+
+    void build(const double* x, const double* y, const double* z, const double* radius, std::size_t count);
+
+    // Appends every pair i < j of the built bodies whose spheres overlap, in
+    // increasing i; the arrays must be the ones given to build
+    void find_overlaps(const double* x, const double* y, const double* z, const double* radius,
+                       std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs) const;
+
+    std::size_t size() const { return entries_.size(); }
+    double get_cell_size() const { return cell_size_; }
+    std::size_t get_bucket_count() const { return bucket_mask_ + 1; }
+
+private:
+    double cell_size_;
+    double inv_cell_size_;
+    std::size_t count_;
+    std::size_t bucket_mask_;
+    std::vector<std::uint32_t> bucket_start_;  // Bucket b holds entries [start[b], start[b + 1])
+    std::vector<std::uint32_t> entries_;       // Body indices grouped by bucket, increasing within one
+    std::vector<std::uint32_t> body_buckets_;
+
+    std::int64_t cell_of(double coordinate) const;
+    std::size_t bucket_of(std::int64_t cx, std::int64_t cy, std::int64_t cz) const;
+};
+
+#endif
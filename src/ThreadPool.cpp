@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned thread_count)
+    : generation_(0), stop_(false), remaining_(0), steals_(0) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+
+    // Worker 0 is the thread that calls parallel_for
+    for (unsigned i = 1; i < thread_count; ++i) {
+        threads_.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, const Task& task) {
+    if (count == 0) return;
+
+    const std::size_t workers = queues_.size();
+    if (workers == 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            task(i, 0);
+        }
+        return;
+    }
+
+    // Set before publishing entries: a worker still draining the previous call may pick them up
+    remaining_.store(count, std::memory_order_release);
+
+    // Contiguous blocks keep neighbouring tasks on one worker until stealing kicks in
+    for (std::size_t w = 0; w < workers; ++w) {
+        std::size_t begin = count * w / workers;
+        std::size_t end = count * (w + 1) / workers;
+
+        std::lock_guard<std::mutex> lock(queues_[w]->mutex);
+        for (std::size_t i = begin; i < end; ++i) {
+            queues_[w]->entries.push_back(Entry{&task, i});
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    run_tasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return remaining_.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::worker_loop(unsigned worker) {
+    std::size_t seen_generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen_generation; });
+            if (stop_) return;
+            seen_generation = generation_;
+        }
+
+        run_tasks(worker);
+    }
+}
+
+void ThreadPool::run_tasks(unsigned worker) {
+    Entry entry;
+    while (pop_local(worker, entry) || steal(worker, entry)) {
+        (*entry.task)(entry.index, worker);
+
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_one();
+        }
+    }
+}
+
+bool ThreadPool::pop_local(unsigned worker, Entry& entry) {
+    WorkerQueue& queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.entries.empty()) return false;
+
+    entry = queue.entries.back();
+    queue.entries.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(unsigned worker, Entry& entry) {
+    const std::size_t workers = queues_.size();
+
+    for (std::size_t offset = 1; offset < workers; ++offset) {
+        WorkerQueue& victim = *queues_[(worker + offset) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.entries.empty()) continue;
+
+        entry = victim.entries.front();
+        victim.entries.pop_front();
+        steals_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
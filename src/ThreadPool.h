@@ -0,0 +1,68 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads with per-worker task deques.
+//
+// parallel_for deals task indices into the workers' deques in contiguous blocks.
+// Each worker drains its own deque from the back and, once empty, steals from the
+// front of the other deques, so uneven task costs do not leave threads idle.
+// The calling thread takes part as worker 0; parallel_for is not reentrant.
+class ThreadPool {
+public:
+    using Task = std::function<void(std::size_t index, unsigned worker)>;
+
+    // thread_count = 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs task(i, worker) for every i in [0, count) and blocks until all are done
+    void parallel_for(std::size_t count, const Task& task);
+
+    unsigned get_thread_count() const { return static_cast<unsigned>(queues_.size()); }
+
+    // Number of tasks taken from another worker's deque since construction
+    std::size_t get_steal_count() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        const Task* task;
+        std::size_t index;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Entry> entries;
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::size_t generation_;
+    bool stop_;
+
+    std::atomic<std::size_t> remaining_;
+    std::atomic<std::size_t> steals_;
+
+    void worker_loop(unsigned worker);
+    void run_tasks(unsigned worker);
+    bool pop_local(unsigned worker, Entry& entry);
+    bool steal(unsigned worker, Entry& entry);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "TidalKernel.h"
+#include <immintrin.h>
+
+std::size_t evaluate_tidal_avx2(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                                std::size_t begin, std::size_t end) {
+    const __m256d hx = _mm256_set1_pd(source.x);
+    const __m256d hy = _mm256_set1_pd(source.y);
+    const __m256d hz = _mm256_set1_pd(source.z);
+    const __m256d gm = _mm256_set1_pd(source.gm);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d three = _mm256_set1_pd(3.0);
+
+    std::size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(points.x + i), hx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(points.y + i), hy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(points.z + i), hz);
+        __m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_mul_pd(dz, dz)));
+
+        // GM / r^3 and 3 GM / r^5, zeroed where r2 is 0 and the division gave inf
+        __m256d inv_r2 = _mm256_div_pd(one, r2);
+        inv_r2 = _mm256_and_pd(inv_r2, _mm256_cmp_pd(r2, _mm256_setzero_pd(), _CMP_GT_OQ));
+        __m256d s = _mm256_mul_pd(gm, _mm256_mul_pd(inv_r2, _mm256_sqrt_pd(inv_r2)));
+        __m256d q = _mm256_mul_pd(three, _mm256_mul_pd(s, inv_r2));
+
+        __m256d qx = _mm256_mul_pd(q, dx);
+        __m256d qy = _mm256_mul_pd(q, dy);
+        _mm256_storeu_pd(out.xx + i, _mm256_fmsub_pd(qx, dx, s));
+        _mm256_storeu_pd(out.xy + i, _mm256_mul_pd(qx, dy));
+        _mm256_storeu_pd(out.xz + i, _mm256_mul_pd(qx, dz));
+        _mm256_storeu_pd(out.yy + i, _mm256_fmsub_pd(qy, dy, s));
+        _mm256_storeu_pd(out.yz + i, _mm256_mul_pd(qy, dz));
+        _mm256_storeu_pd(out.zz + i, _mm256_fmsub_pd(_mm256_mul_pd(q, dz), dz, s));
+    }
+    return i;
+}
+
+#endif
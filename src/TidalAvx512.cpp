@@ -0,0 +1,46 @@
+#ifdef BLACKHOLE_SIMD_KERNELS
+
+#include "TidalKernel.h"
+#include <immintrin.h>
+
+std::size_t evaluate_tidal_avx512(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                                  std::size_t begin, std::size_t end) {
+    const __m512d hx = _mm512_set1_pd(source.x);
+    const __m512d hy = _mm512_set1_pd(source.y);
+    const __m512d hz = _mm512_set1_pd(source.z);
+    const __m512d gm = _mm512_set1_pd(source.gm);
+    const __m512d half = _mm512_set1_pd(0.5);
+    const __m512d three_halves = _mm512_set1_pd(1.5);
+    const __m512d three = _mm512_set1_pd(3.0);
+
+    std::size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(points.x + i), hx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(points.y + i), hy);
+        __m512d dz = _mm512_sub_pd(_mm512_loadu_pd(points.z + i), hz);
+        __m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_mul_pd(dz, dz)));
+
+        // 1 / r from the 14-bit estimate and two Newton steps, as in the gravity
+        // kernel; lanes with r2 = 0 store zeros
+        __m512d inv_r = _mm512_rsqrt14_pd(r2);
+        __m512d half_r2 = _mm512_mul_pd(half, r2);
+        inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(half_r2, _mm512_mul_pd(inv_r, inv_r), three_halves));
+        inv_r = _mm512_mul_pd(inv_r, _mm512_fnmadd_pd(half_r2, _mm512_mul_pd(inv_r, inv_r), three_halves));
+        __mmask8 separated = _mm512_cmp_pd_mask(r2, _mm512_setzero_pd(), _CMP_GT_OQ);
+        __m512d inv_r2 = _mm512_maskz_mul_pd(separated, inv_r, inv_r);
+        __m512d s = _mm512_maskz_mul_pd(separated, gm, _mm512_mul_pd(inv_r2, inv_r));
+        __m512d q = _mm512_mul_pd(three, _mm512_mul_pd(s, inv_r2));
+
+        __m512d qx = _mm512_mul_pd(q, dx);
+        __m512d qy = _mm512_mul_pd(q, dy);
+        _mm512_storeu_pd(out.xx + i, _mm512_fmsub_pd(qx, dx, s));
+        _mm512_storeu_pd(out.xy + i, _mm512_mul_pd(qx, dy));
+        _mm512_storeu_pd(out.xz + i, _mm512_mul_pd(qx, dz));
+        _mm512_storeu_pd(out.yy + i, _mm512_fmsub_pd(qy, dy, s));
+        _mm512_storeu_pd(out.yz + i, _mm512_mul_pd(qy, dz));
+        _mm512_storeu_pd(out.zz + i, _mm512_fmsub_pd(_mm512_mul_pd(q, dz), dz, s));
+    }
+    return i;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef TIDALKERNEL_H
+#define TIDALKERNEL_H
+
+#include <cstddef>
+
+// Plain-data interface between PhysicsEngine and the per-ISA tidal tensor
+// kernels, which are compiled with ISA-specific flags.
+
+// Point mass raising the tidal field
+struct TidalSource {
+    double x, y, z;
+    double gm;  // G times the mass
+};
+
+// Structure-of-arrays evaluation points
+struct TidalPoints {
+    const double* x;
+    const double* y;
+    const double* z;
+};
+
+// Six independent components of each symmetric tensor
+struct TidalOutput {
+    double* xx;
+    double* xy;
+    double* xz;
+    double* yy;
+    double* yz;
+    double* zz;
+};
+
+// Stores GM (3 n_i n_j - delta_ij) / r^3, with n the unit vector from the source
+// to the point at distance r, for every point in [begin, end). A point at the
+// source gets zeros.
+void evaluate_tidal_scalar(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                           std::size_t begin, std::size_t end);
+
+// Same with the widest kernel this CPU runs
+void evaluate_tidal(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                    std::size_t begin, std::size_t end);
+
+#ifdef BLACKHOLE_SIMD_KERNELS
+// Points from begin in groups of 4 (AVX2) or 8 (AVX-512); return the first
+// point they did not do
+std::size_t evaluate_tidal_avx2(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                                std::size_t begin, std::size_t end);
+std::size_t evaluate_tidal_avx512(const TidalSource& source, const TidalPoints& points, const TidalOutput& out,
+                                  std::size_t begin, std::size_t end);
+#endif
+
+#endif
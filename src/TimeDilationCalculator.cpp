@@ -1,7 +1,14 @@
 #include "TimeDilationCalculator.h"
+#include <algorithm>
+#include <cmath>
 
-TimeDilationCalculator::TimeDilationCalculator() 
-    : current_dilation_(1.0), proper_time_(0.0), coordinate_time_(0.0) {
+TimeDilationCalculator::TimeDilationCalculator(const TimeDilationHistorySettings& settings) 
+    : current_dilation_(1.0), proper_time_(0.0), coordinate_time_(0.0),
+      history_settings_(settings), history_(settings.capacity), tiers_(settings.tier_count) {
+    for (HistoryTier& tier : tiers_) {
+        tier.summaries.set_capacity(settings.capacity);
+        tier.pending_entries = 0;
+    }
     start_time_ = std::chrono::system_clock::now();
 }
 
@@ -41,9 +48,43 @@ void TimeDilationCalculator::update(const Eigen::Vector3d& observer_position,
     
     history_.push_back(record);
     
-    // Keep only recent history
-    if (history_.size() > 1000) {
-        history_.erase(history_.begin());
+    // Feed the downsampled tiers
+    if (!tiers_.empty()) {
+        TimeDilationSummary summary;
+        summary.timestamp = current_time;
+        summary.min_dilation = current_dilation_;
+        summary.max_dilation = current_dilation_;
+        summary.mean_dilation = current_dilation_;
+        summary.coordinate_time_begin = coordinate_time_ - delta_time;
+        summary.coordinate_time_end = coordinate_time_;
+        summary.proper_time_begin = proper_time_ - delta_time * current_dilation_;
+        summary.proper_time_end = proper_time_;
+        summary.sample_count = 1;
+        record_summary(0, summary);
+    }
+}
+
+void TimeDilationCalculator::record_summary(std::size_t tier_index, const TimeDilationSummary& summary) {
+    HistoryTier& tier = tiers_[tier_index];
+    TimeDilationSummary& pending = tier.pending;
+    if (tier.pending_entries == 0) {
+        pending = summary;
+    } else {
+        const std::size_t samples = pending.sample_count + summary.sample_count;
+        pending.min_dilation = std::min(pending.min_dilation, summary.min_dilation);
+        pending.max_dilation = std::max(pending.max_dilation, summary.max_dilation);
+        pending.mean_dilation += (summary.mean_dilation - pending.mean_dilation) *
+                                 static_cast<double>(summary.sample_count) / static_cast<double>(samples);
+        pending.coordinate_time_end = summary.coordinate_time_end;
+        pending.proper_time_end = summary.proper_time_end;
+        pending.sample_count = samples;
+    }
+    
+    if (++tier.pending_entries < history_settings_.tier_factor) return;
+    tier.summaries.push_back(pending);
+    tier.pending_entries = 0;
+    if (tier_index + 1 < tiers_.size()) {
+        record_summary(tier_index + 1, pending);
     }
 }
 
@@ -52,5 +93,9 @@ void TimeDilationCalculator::reset() {
     proper_time_ = 0.0;
     coordinate_time_ = 0.0;
     history_.clear();
+    for (HistoryTier& tier : tiers_) {
+        tier.summaries.clear();
+        tier.pending_entries = 0;
+    }
     start_time_ = std::chrono::system_clock::now();
 }
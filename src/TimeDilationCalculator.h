@@ -1,6 +1,7 @@
 #ifndef TIMEDILATIONCALCULATOR_H
 #define TIMEDILATIONCALCULATOR_H
 
+#include "RingBuffer.h"
 #include <Eigen/Dense>
 #include <vector>
 #include <chrono>
@@ -13,9 +14,37 @@ struct TimeDilationRecord {
     double coordinate_time;
 };
 
+// Aggregate of consecutive records in a downsampled history tier
+struct TimeDilationSummary {
+    std::chrono::system_clock::time_point timestamp;  // First record
+    double min_dilation;
+    double max_dilation;
+    double mean_dilation;
+    double coordinate_time_begin;
+    double coordinate_time_end;
+    double proper_time_begin;
+    double proper_time_end;
+    std::size_t sample_count;
+};
+
+struct TimeDilationHistorySettings {
+    std::size_t capacity;       // Entries kept per tier, raw records included
+    std::size_t tier_count;     // Downsampled tiers after the raw records
+    std::size_t tier_factor;    // Entries of one tier merged into one of the next
+    
+    // At 60 updates per second: 17 s raw, then 2.8 min, 28 min and 4.6 h
+    TimeDilationHistorySettings() :
+        capacity(1000),
+        tier_count(3),
+        tier_factor(10) {}
+};
+
+// History is kept in fixed-capacity ring buffers: the raw records, then tiers
+// that each summarize tier_factor entries of the one before, so the footprint
+// is bounded and an update costs O(tier_count) at worst.
 class TimeDilationCalculator {
 public:
-    TimeDilationCalculator();
+    explicit TimeDilationCalculator(const TimeDilationHistorySettings& settings = TimeDilationHistorySettings());
     
     void update(const Eigen::Vector3d& observer_position, 
                 const Eigen::Vector3d& black_hole_position,
@@ -25,7 +54,10 @@ public:
     double get_proper_time() const { return proper_time_; }
     double get_coordinate_time() const { return coordinate_time_; }
     
-    const std::vector<TimeDilationRecord>& get_history() const { return history_; }
+    const RingBuffer<TimeDilationRecord>& get_history() const { return history_; }
+    // Tier 0 summarizes tier_factor raw records per entry, each later tier tier_factor more
+    std::size_t get_history_tier_count() const { return tiers_.size(); }
+    const RingBuffer<TimeDilationSummary>& get_history_tier(std::size_t tier) const { return tiers_[tier].summaries; }
     
     void reset();
     
@@ -33,10 +65,21 @@ private:
     double current_dilation_;
     double proper_time_;
     double coordinate_time_;
-    std::vector<TimeDilationRecord> history_;
+    TimeDilationHistorySettings history_settings_;
+    RingBuffer<TimeDilationRecord> history_;
+    
+    // Each tier's window being filled, merged into its ring buffer when full
+    struct HistoryTier {
+        RingBuffer<TimeDilationSummary> summaries;
+        TimeDilationSummary pending;
+        std::size_t pending_entries;
+    };
+    std::vector<HistoryTier> tiers_;
     
     std::chrono::system_clock::time_point start_time_;
     
+    void record_summary(std::size_t tier, const TimeDilationSummary& summary);
+    
     const double G = 6.67430e-11;
     const double c = 299792458.0;
     const double solar_mass = 1.989e30;
@@ -0,0 +1,48 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+// Lock-free hand-off of the newest value from one writer thread to one reader
+// thread.
+//
+// The writer fills its back buffer and publishes it by swapping it with the
+// middle one; the reader swaps its front buffer with the middle one when a newer
+// value is there. Each side only ever touches its own buffer, neither waits for
+// the other, and values the reader never picked up are overwritten. Buffers
+// keep their allocations, so values holding vectors stop allocating once sized.
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle_(1), back_(0), front_(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side
+    T& get_back() { return buffers_[back_]; }
+    void publish() {
+        unsigned previous = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        back_ = previous & kIndex;
+    }
+
+    // Reader side; true when front now holds a value it has not seen
+    bool update() {
+        if (!(middle_.load(std::memory_order_acquire) & kFresh)) return false;
+        unsigned previous = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = previous & kIndex;
+        return true;
+    }
+    const T& get_front() const { return buffers_[front_]; }
+
+private:
+    static const unsigned kIndex = 3;
+    static const unsigned kFresh = 4;
+
+    T buffers_[3];
+    std::atomic<unsigned> middle_;  // Buffer index, with kFresh until the reader takes it
+    unsigned back_;
+    unsigned front_;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "BlackHole.h"
 #include "PhysicsEngine.h"
+#include "PhysicsThread.h"
 #include "Renderer.h"
 #include "Camera.h"
 #include <iostream>
@@ -39,6 +40,7 @@ private:
     std::unique_ptr<Camera> camera_;
     std::shared_ptr<BlackHole> black_hole_;
     std::unique_ptr<PhysicsEngine> physics_engine_;
+    std::unique_ptr<PhysicsThread> physics_thread_;
     
     void setup_scene() {
         // Создание черной дыры Гаргантюа
@@ -55,15 +57,20 @@ private:
         physics_engine_ = std::make_unique<PhysicsEngine>();
         physics_engine_->set_black_hole(black_hole_);
         
+        // Физика в собственном потоке с фиксированным шагом
+        physics_thread_ = std::make_unique<PhysicsThread>(*physics_engine_);
+        physics_thread_->start();
+        
         std::cout << "Scene setup complete" << std::endl;
     }
     
     void main_loop() {
         auto last_time = std::chrono::high_resolution_clock::now();
         int frame_count = 0;
+        bool toggle_was_pressed = false;
         
         std::cout << "Starting main loop..." << std::endl;
-        std::cout << "Controls: WASD - Move, Q/E - Up/Down, Mouse - Look, ESC - Exit" << std::endl;
+        std::cout << "Controls: WASD - Move, Q/E - Up/Down, Mouse - Look, T - Ray tracing, ESC - Exit" << std::endl;
         
         while (!glfwWindowShouldClose(renderer_->get_window())) {
             auto current_time = std::chrono::high_resolution_clock::now();
@@ -78,8 +85,15 @@ private:
             // Обработка ввода
             camera_->handle_input(renderer_->get_window());
             
+            // Переключение CPU трассировки лучей
+            bool toggle_pressed = glfwGetKey(renderer_->get_window(), GLFW_KEY_T) == GLFW_PRESS;
+            if (toggle_pressed && !toggle_was_pressed) {
+                renderer_->set_ray_tracing_enabled(!renderer_->is_ray_tracing_enabled());
+            }
+            toggle_was_pressed = toggle_pressed;
+            
             // Рендеринг сцены
-            renderer_->render(black_hole_, *physics_engine_);
+            renderer_->render(black_hole_, *physics_thread_);
             
             // Обновление счетчика кадров
             frame_count++;
@@ -95,6 +109,9 @@ private:
     
     void cleanup() {
         std::cout << "\nCleaning up..." << std::endl;
+        if (physics_thread_) {
+            physics_thread_->stop();
+        }
         if (renderer_) {
             renderer_->shutdown();
         }